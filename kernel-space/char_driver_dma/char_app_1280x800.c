@@ -9,6 +9,10 @@
 #include <omp.h>
 #include <stdint.h>
 
+#include "../../multi-core/perf-counters.h"
+#include "../../multi-core/usdt-probes.h"
+#include "../../multi-core/bench-results.h"
+
 #define DEVICE_PATH "/dev/my_dma_device"
 #define MAX_ITERATIONS 100
 
@@ -101,6 +105,7 @@ void savePPM(const char* filename, Resolution* res) {
         written += write_size;
     }
 
+    PROBE_FILE_WRITE(filename, (size_t)ftell(file));
     fclose(file);
 }
 
@@ -126,6 +131,7 @@ int main() {
         close(fd);
         return EXIT_FAILURE;
     }
+    PROBE_DEVICE_MMAP(input_buffer, DMA_BUFFER_SIZE, 0);
 
     // Map the second DMA buffer (output buffer)
     off_t aligned_offset = (buffer2_offset + page_size - 1) & ~(page_size - 1);
@@ -136,6 +142,7 @@ int main() {
         close(fd);
         return EXIT_FAILURE;
     }
+    PROBE_DEVICE_MMAP(output_buffer, DMA_BUFFER_SIZE, aligned_offset);
 
     Resolution srcRes = {SRC_WIDTH, SRC_HEIGHT, input_buffer};
     Resolution dstRes = {DST_WIDTH, DST_HEIGHT, output_buffer};
@@ -151,17 +158,30 @@ int main() {
         }
     }
 
+    double samples[MAX_ITERATIONS];
+    PerfCounters perf;
+    perfCountersStart(&perf);
+
     double start_time = omp_get_wtime();
 
-    #pragma omp parallel for
+    // Iterations run back to back; the scaler is parallel inside, so each
+    // sample times one uncontended scale
     for (int i = 0; i < MAX_ITERATIONS; i++) {
+        double iterStart = omp_get_wtime();
+        PROBE_SCALE_START("scaleImage", i, srcRes.width, srcRes.height, dstRes.width, dstRes.height);
         scaleImage(&srcRes, &dstRes);
+        PROBE_SCALE_END("scaleImage", i, dstRes.width, dstRes.height);
+        samples[i] = omp_get_wtime() - iterStart;
     }
 
     double total_time = omp_get_wtime() - start_time;
+    perfCountersStop(&perf);
 
     savePPM("output.ppm", &dstRes);
     printf("[INFO] Completed %d scaling operations in %.6f seconds\n", MAX_ITERATIONS, total_time);
+    perfCountersReport(&perf, "scaleImage", (double)DST_WIDTH * DST_HEIGHT * MAX_ITERATIONS);
+    benchResultsWrite("char_driver_dma", "scaleImage", SRC_WIDTH, SRC_HEIGHT, DST_WIDTH, DST_HEIGHT,
+                      omp_get_max_threads(), samples, MAX_ITERATIONS);
 
     munmap(input_buffer, DMA_BUFFER_SIZE);
     munmap(output_buffer, DMA_BUFFER_SIZE);
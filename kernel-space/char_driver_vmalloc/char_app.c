@@ -8,6 +8,10 @@
 #include <errno.h>
 #include <omp.h>
 
+#include "../../multi-core/perf-counters.h"
+#include "../../multi-core/usdt-probes.h"
+#include "../../multi-core/bench-results.h"
+
 #define MAX_ITERATIONS 100
 
 // Source image dimensions
@@ -54,6 +58,7 @@ void scaleImage(unsigned char* src, unsigned char* dst,
 void writeResolution(Resolution* res, unsigned char* destMemory) {
     size_t dataSize = res->width * res->height * PIXEL_SIZE;
     memcpy(destMemory, res->data, dataSize);
+    PROBE_BUFFER_WRITE(destMemory, dataSize, res->width, res->height);
 }
 
 // Save image as PPM (Portable PixMap)
@@ -72,6 +77,7 @@ void savePPM(const char* filename, Resolution* res) {
         fwrite(&res->data[i], 1, 3, file);  // Write only R, G, B
     }
 
+    PROBE_FILE_WRITE(filename, (size_t)ftell(file));
     fclose(file);
     printf("Saved image: %s\n", filename);
 }
@@ -102,6 +108,7 @@ int main() {
         close(fd);
         return -1;
     }
+    PROBE_DEVICE_MMAP(kernel_buffer, MEM_SIZE, 0);
     printf("kernel_buffer mapped successfully at %p\n", kernel_buffer);
     
     // Map the output_buffer (offset 1)
@@ -115,6 +122,7 @@ int main() {
         close(fd);
         return -1;
     }
+    PROBE_DEVICE_MMAP(output_buffer, MEM_SIZE, getpagesize());
     printf("output_buffer mapped successfully at %p\n", output_buffer);
     
     // Allocate a temporary Resolution struct for saving images
@@ -132,6 +140,10 @@ int main() {
     savePPM("input.ppm", &srcRes);
     
     // Start measuring time
+    double samples[MAX_ITERATIONS];
+    PerfCounters perf;
+    perfCountersStart(&perf);
+
     double start_time = omp_get_wtime();
 
     // Process multiple iterations
@@ -139,16 +151,24 @@ int main() {
         printf("Iteration %d\n", i);
 
         // Scale the image (process the data in user space)
+        double iterStart = omp_get_wtime();
+        PROBE_SCALE_START("scaleImage", i, SRC_WIDTH, SRC_HEIGHT, DST_WIDTH, DST_HEIGHT);
         scaleImage(kernel_buffer, output_buffer, SRC_WIDTH, SRC_HEIGHT, DST_WIDTH, DST_HEIGHT);
+        PROBE_SCALE_END("scaleImage", i, DST_WIDTH, DST_HEIGHT);
+        samples[i] = omp_get_wtime() - iterStart;
     }
 
     // Stop measuring time
     double end_time = omp_get_wtime();
     double total_time = end_time - start_time;
+    perfCountersStop(&perf);
 
     // Save the output image for debugging
     savePPM("output.ppm", &dstRes);
     printf("Completed %d scaling operations in %.6f seconds\n", MAX_ITERATIONS, total_time);
+    perfCountersReport(&perf, "scaleImage", (double)DST_WIDTH * DST_HEIGHT * MAX_ITERATIONS);
+    benchResultsWrite("char_driver_vmalloc", "scaleImage", SRC_WIDTH, SRC_HEIGHT, DST_WIDTH, DST_HEIGHT,
+                      omp_get_max_threads(), samples, MAX_ITERATIONS);
 
 cleanup:
     // Unmap buffers
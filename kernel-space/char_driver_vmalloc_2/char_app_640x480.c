@@ -9,6 +9,10 @@
 #include <omp.h>
 #include <stdint.h>
 
+#include "../../multi-core/perf-counters.h"
+#include "../../multi-core/usdt-probes.h"
+#include "../../multi-core/bench-results.h"
+
 #define MAX_ITERATIONS 100
 
 // Source image dimensions
@@ -91,6 +95,7 @@ void savePPM(const char* filename, Resolution* res) {
         written += write_size;
     }
 
+    PROBE_FILE_WRITE(filename, (size_t)ftell(file));
     fclose(file);
 }
 
@@ -114,6 +119,7 @@ int main() {
         close(fd);
         return -1;
     }
+    PROBE_DEVICE_MMAP(kernel_buffer, MEM_SIZE, 0);
 
     output_buffer = (unsigned char *)mmap(NULL, MEM_SIZE, 
                                           PROT_READ | PROT_WRITE, MAP_SHARED, 
@@ -124,6 +130,7 @@ int main() {
         close(fd);
         return -1;
     }
+    PROBE_DEVICE_MMAP(output_buffer, MEM_SIZE, getpagesize());
 
     Resolution srcRes = {SRC_WIDTH, SRC_HEIGHT, kernel_buffer};
     Resolution dstRes = {DST_WIDTH, DST_HEIGHT, output_buffer};
@@ -135,16 +142,28 @@ int main() {
 
     savePPM("input.ppm", &srcRes);
 
+    double samples[MAX_ITERATIONS];
+    PerfCounters perf;
+    perfCountersStart(&perf);
+
     double start_time = omp_get_wtime();
 
     for (int i = 0; i < MAX_ITERATIONS; i++) {
+        double iterStart = omp_get_wtime();
+        PROBE_SCALE_START("scaleImage", i, SRC_WIDTH, SRC_HEIGHT, DST_WIDTH, DST_HEIGHT);
         scaleImage(kernel_buffer, output_buffer, SRC_WIDTH, SRC_HEIGHT, DST_WIDTH, DST_HEIGHT);
+        PROBE_SCALE_END("scaleImage", i, DST_WIDTH, DST_HEIGHT);
+        samples[i] = omp_get_wtime() - iterStart;
     }
 
     double total_time = omp_get_wtime() - start_time;
+    perfCountersStop(&perf);
 
     savePPM("output.ppm", &dstRes);
     printf("Completed %d scaling operations in %.6f seconds\n", MAX_ITERATIONS, total_time);
+    perfCountersReport(&perf, "scaleImage", (double)DST_WIDTH * DST_HEIGHT * MAX_ITERATIONS);
+    benchResultsWrite("char_driver_vmalloc_2", "scaleImage", SRC_WIDTH, SRC_HEIGHT, DST_WIDTH, DST_HEIGHT,
+                      omp_get_max_threads(), samples, MAX_ITERATIONS);
 
     munmap(kernel_buffer, MEM_SIZE);
     munmap(output_buffer, MEM_SIZE);
@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "bench-results.h"
+
+// Compare two bench-results files (baseline vs candidate). Samples are
+// grouped by suite/kernel/geometry/thread-count; each group is tested with a
+// two-sided Mann-Whitney U test on the per-iteration times and its median
+// change is compared against a noise threshold. A group is a regression only
+// if the difference is both significant and larger than the noise, where the
+// noise is the larger of --threshold and the baseline's own spread
+// (half the interquartile range relative to the median).
+//
+// Usage: bench-compare [--threshold pct] [--alpha p] baseline.csv candidate.csv
+// Exit status is 1 when any group regressed, so it can gate a CI step.
+
+#define DEFAULT_THRESHOLD 2.0  // Percent
+#define DEFAULT_ALPHA 0.01
+#define KEY_SIZE 192
+
+typedef struct {
+    char key[KEY_SIZE];  // suite kernel srcWxsrcH->dstWxdstH tN
+    double* samples;
+    int count;
+    int capacity;
+} SampleGroup;
+
+typedef struct {
+    SampleGroup* groups;
+    int count;
+    int capacity;
+} ResultSet;
+
+typedef enum { VERDICT_REGRESSION, VERDICT_IMPROVEMENT, VERDICT_UNCHANGED, VERDICT_MISSING } Verdict;
+
+typedef struct {
+    const char* key;
+    int baseCount, candCount;
+    double baseMedian, candMedian;
+    double change;  // Relative change of the median, positive is slower
+    double noise;   // Relative noise floor used for this group
+    double pValue;
+    Verdict verdict;
+} Comparison;
+
+static const char* const verdictNames[] = {"REGRESSION", "improvement", "unchanged", "missing"};
+
+SampleGroup* findGroup(ResultSet* set, const char* key, int create) {
+    for (int i = 0; i < set->count; i++) {
+        if (strcmp(set->groups[i].key, key) == 0) return &set->groups[i];
+    }
+    if (!create) return NULL;
+
+    if (set->count == set->capacity) {
+        set->capacity = set->capacity ? set->capacity * 2 : 64;
+        set->groups = (SampleGroup*)realloc(set->groups, set->capacity * sizeof(SampleGroup));
+        if (!set->groups) {
+            printf("Memory allocation failed for result groups\n");
+            exit(2);
+        }
+    }
+    SampleGroup* group = &set->groups[set->count++];
+    memset(group, 0, sizeof(*group));
+    snprintf(group->key, sizeof(group->key), "%s", key);
+    return group;
+}
+
+void addSample(SampleGroup* group, double value) {
+    if (group->count == group->capacity) {
+        group->capacity = group->capacity ? group->capacity * 2 : 128;
+        group->samples = (double*)realloc(group->samples, group->capacity * sizeof(double));
+        if (!group->samples) {
+            printf("Memory allocation failed for samples\n");
+            exit(2);
+        }
+    }
+    group->samples[group->count++] = value;
+}
+
+int loadResults(const char* path, ResultSet* set) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("Failed to open results file: %s\n", path);
+        return -1;
+    }
+
+    char line[512];
+    int lineNumber = 0, skipped = 0;
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        if (line[0] == '#' || line[0] == '\n') continue;
+
+        char suite[64], kernel[64];
+        int srcW, srcH, dstW, dstH, threads, iteration;
+        double seconds;
+        if (sscanf(line, "%63[^,],%63[^,],%d,%d,%d,%d,%d,%d,%lf", suite, kernel, &srcW, &srcH, &dstW, &dstH,
+                   &threads, &iteration, &seconds) != 9) {
+            if (!skipped) printf("%s:%d: skipping malformed line\n", path, lineNumber);
+            skipped++;
+            continue;
+        }
+
+        char key[KEY_SIZE];
+        snprintf(key, sizeof(key), "%s %s %dx%d->%dx%d t%d", suite, kernel, srcW, srcH, dstW, dstH, threads);
+        addSample(findGroup(set, key, 1), seconds);
+    }
+
+    fclose(file);
+    if (skipped > 1) printf("%s: %d malformed lines skipped\n", path, skipped);
+    return 0;
+}
+
+int compareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Quantile of a sorted array, linear interpolation between closest ranks
+double sortedQuantile(const double* sorted, int count, double q) {
+    double position = q * (count - 1);
+    int lower = (int)position;
+    if (lower >= count - 1) return sorted[count - 1];
+    double fraction = position - lower;
+    return sorted[lower] * (1.0 - fraction) + sorted[lower + 1] * fraction;
+}
+
+typedef struct {
+    double value;
+    int fromBaseline;
+} RankedSample;
+
+int compareRanked(const void* a, const void* b) {
+    return compareDoubles(&((const RankedSample*)a)->value, &((const RankedSample*)b)->value);
+}
+
+// Two-sided Mann-Whitney U test (normal approximation with tie and
+// continuity correction); returns the p-value
+double mannWhitneyP(const double* a, int n1, const double* b, int n2) {
+    int n = n1 + n2;
+    RankedSample* all = (RankedSample*)malloc(n * sizeof(RankedSample));
+    if (!all) {
+        printf("Memory allocation failed for ranking\n");
+        exit(2);
+    }
+    for (int i = 0; i < n1; i++) all[i] = (RankedSample){a[i], 1};
+    for (int i = 0; i < n2; i++) all[n1 + i] = (RankedSample){b[i], 0};
+    qsort(all, n, sizeof(RankedSample), compareRanked);
+
+    double rankSumA = 0.0, tieTerm = 0.0;
+    for (int i = 0; i < n;) {
+        int j = i;
+        while (j + 1 < n && all[j + 1].value == all[i].value) j++;
+        double rank = (i + j) / 2.0 + 1.0;  // Average rank of the tie run
+        double ties = j - i + 1;
+        tieTerm += ties * ties * ties - ties;
+        for (int k = i; k <= j; k++) {
+            if (all[k].fromBaseline) rankSumA += rank;
+        }
+        i = j + 1;
+    }
+    free(all);
+
+    double u = rankSumA - n1 * (n1 + 1) / 2.0;
+    double mean = n1 * (double)n2 / 2.0;
+    double variance = n1 * (double)n2 / 12.0 * ((n + 1) - tieTerm / ((double)n * (n - 1)));
+    if (variance <= 0.0) return 1.0;  // Every sample identical
+
+    double diff = fabs(u - mean) - 0.5;
+    if (diff < 0.0) diff = 0.0;
+    double z = diff / sqrt(variance);
+    return erfc(z / sqrt(2.0));
+}
+
+void compareGroup(const SampleGroup* base, const SampleGroup* cand, double threshold, double alpha,
+                  Comparison* out) {
+    qsort(base->samples, base->count, sizeof(double), compareDoubles);
+    qsort(cand->samples, cand->count, sizeof(double), compareDoubles);
+
+    out->baseCount = base->count;
+    out->candCount = cand->count;
+    out->baseMedian = sortedQuantile(base->samples, base->count, 0.5);
+    out->candMedian = sortedQuantile(cand->samples, cand->count, 0.5);
+    out->change = out->baseMedian > 0.0 ? (out->candMedian - out->baseMedian) / out->baseMedian : 0.0;
+
+    double iqr = sortedQuantile(base->samples, base->count, 0.75) - sortedQuantile(base->samples, base->count, 0.25);
+    double spread = out->baseMedian > 0.0 ? 0.5 * iqr / out->baseMedian : 0.0;
+    out->noise = spread > threshold ? spread : threshold;
+
+    out->pValue = mannWhitneyP(base->samples, base->count, cand->samples, cand->count);
+
+    if (out->pValue < alpha && out->change > out->noise)
+        out->verdict = VERDICT_REGRESSION;
+    else if (out->pValue < alpha && out->change < -out->noise)
+        out->verdict = VERDICT_IMPROVEMENT;
+    else
+        out->verdict = VERDICT_UNCHANGED;
+}
+
+// Regressions first (largest slowdown on top), then unchanged, improvements, missing
+int compareRank(const void* a, const void* b) {
+    const Comparison* x = (const Comparison*)a;
+    const Comparison* y = (const Comparison*)b;
+    int order[] = {0, 2, 1, 3};
+    if (order[x->verdict] != order[y->verdict]) return order[x->verdict] - order[y->verdict];
+    return (x->change < y->change) - (x->change > y->change);
+}
+
+int main(int argc, char* argv[]) {
+    double threshold = DEFAULT_THRESHOLD;
+    double alpha = DEFAULT_ALPHA;
+    const char* paths[2];
+    int pathCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--alpha") == 0 && i + 1 < argc) {
+            alpha = atof(argv[++i]);
+        } else if (pathCount < 2 && argv[i][0] != '-') {
+            paths[pathCount++] = argv[i];
+        } else {
+            pathCount = -1;
+            break;
+        }
+    }
+    if (pathCount != 2 || threshold < 0.0 || alpha <= 0.0 || alpha >= 1.0) {
+        printf("Usage: %s [--threshold pct] [--alpha p] <baseline.csv> <candidate.csv>\n", argv[0]);
+        printf("Files are written by the benchmarks when BENCH_RESULTS=<file> is set (%s)\n", BENCH_RESULTS_HEADER);
+        return 2;
+    }
+
+    ResultSet baseline = {0}, candidate = {0};
+    if (loadResults(paths[0], &baseline) < 0 || loadResults(paths[1], &candidate) < 0) return 2;
+
+    int maxComparisons = baseline.count + candidate.count;
+    Comparison* comparisons = (Comparison*)calloc(maxComparisons > 0 ? maxComparisons : 1, sizeof(Comparison));
+    if (!comparisons) {
+        printf("Memory allocation failed for comparisons\n");
+        return 2;
+    }
+
+    int count = 0;
+    for (int i = 0; i < baseline.count; i++) {
+        Comparison* c = &comparisons[count++];
+        c->key = baseline.groups[i].key;
+        SampleGroup* cand = findGroup(&candidate, baseline.groups[i].key, 0);
+        if (cand && baseline.groups[i].count >= 2 && cand->count >= 2) {
+            compareGroup(&baseline.groups[i], cand, threshold / 100.0, alpha, c);
+        } else {
+            c->baseCount = baseline.groups[i].count;
+            c->candCount = cand ? cand->count : 0;
+            c->verdict = VERDICT_MISSING;
+        }
+    }
+    for (int i = 0; i < candidate.count; i++) {
+        if (findGroup(&baseline, candidate.groups[i].key, 0)) continue;
+        Comparison* c = &comparisons[count++];
+        c->key = candidate.groups[i].key;
+        c->candCount = candidate.groups[i].count;
+        c->verdict = VERDICT_MISSING;
+    }
+
+    qsort(comparisons, count, sizeof(Comparison), compareRank);
+
+    printf("Baseline: %s, candidate: %s, threshold %.1f%%, alpha %g\n\n", paths[0], paths[1], threshold, alpha);
+    printf("%-12s %-52s %12s %12s %9s %7s %9s %9s\n", "verdict", "benchmark", "base (ms)", "cand (ms)",
+           "change", "noise", "p-value", "samples");
+
+    int tally[4] = {0};
+    for (int i = 0; i < count; i++) {
+        const Comparison* c = &comparisons[i];
+        tally[c->verdict]++;
+        if (c->verdict == VERDICT_MISSING) {
+            printf("%-12s %-52s %12s %12s %9s %7s %9s %4d/%-4d\n", verdictNames[c->verdict], c->key,
+                   "-", "-", "-", "-", "-", c->baseCount, c->candCount);
+            continue;
+        }
+        printf("%-12s %-52s %12.4f %12.4f %+8.2f%% %6.2f%% %9.2g %4d/%-4d\n", verdictNames[c->verdict], c->key,
+               c->baseMedian * 1000.0, c->candMedian * 1000.0, c->change * 100.0, c->noise * 100.0, c->pValue,
+               c->baseCount, c->candCount);
+    }
+
+    printf("\n%d regressions, %d improvements, %d unchanged, %d missing\n", tally[VERDICT_REGRESSION],
+           tally[VERDICT_IMPROVEMENT], tally[VERDICT_UNCHANGED], tally[VERDICT_MISSING]);
+
+    for (int i = 0; i < baseline.count; i++) free(baseline.groups[i].samples);
+    for (int i = 0; i < candidate.count; i++) free(candidate.groups[i].samples);
+    free(baseline.groups);
+    free(candidate.groups);
+    free(comparisons);
+
+    return tally[VERDICT_REGRESSION] ? 1 : 0;
+}
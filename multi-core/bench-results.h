@@ -0,0 +1,50 @@
+#ifndef BENCH_RESULTS_H
+#define BENCH_RESULTS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Machine-readable benchmark results. When BENCH_RESULTS=<file> is set, each
+// benchmark appends one CSV line per measured iteration:
+//
+//   suite,kernel,src_w,src_h,dst_w,dst_h,threads,iteration,seconds
+//
+// The multi-core scalers, the kernel-space char_app runs and the GL
+// batch_scaling path all write the same format, so one file can hold a whole
+// sweep (e.g. BENCH_RESULTS=base.csv ./auto-run). bench-compare takes a
+// baseline and a candidate file and reports regressions per
+// suite/kernel/geometry/thread-count. Samples are collected in memory and
+// written after the timed region, so no I/O lands inside it.
+
+#define BENCH_RESULTS_HEADER "suite,kernel,src_w,src_h,dst_w,dst_h,threads,iteration,seconds"
+
+// Results file, or NULL when recording is off (unset or empty). Anything that
+// changes behaviour for a recorded run checks this, so it cannot disagree
+// with the writer about whether results are being recorded.
+static inline const char* benchResultsPath(void) {
+    const char* path = getenv("BENCH_RESULTS");
+    return (path && *path) ? path : NULL;
+}
+
+static inline void benchResultsWrite(const char* suite, const char* kernel, int srcW, int srcH, int dstW, int dstH,
+                                     int threads, const double* samples, int count) {
+    const char* path = benchResultsPath();
+    if (!path) return;
+
+    FILE* file = fopen(path, "a");
+    if (!file) {
+        fprintf(stderr, "[bench] Failed to open results file %s\n", path);
+        return;
+    }
+
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0) fprintf(file, "#%s\n", BENCH_RESULTS_HEADER);
+
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%s,%s,%d,%d,%d,%d,%d,%d,%.9f\n", suite, kernel, srcW, srcH, dstW, dstH,
+                threads, i, samples[i]);
+    }
+    fclose(file);
+}
+
+#endif // BENCH_RESULTS_H
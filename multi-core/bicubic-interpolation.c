@@ -4,26 +4,13 @@
 #include <time.h>
 #include <omp.h>
 
+#include "scalers.h"
+#include "perf-counters.h"
+#include "bench-results.h"
+
 #define MAX_ITERATIONS 100
 #define DST_WIDTH 1920
 #define DST_HEIGHT 1080
-#define PIXEL_SIZE 4  // Assuming 4 bytes per pixel (RGBA)
-
-// Bicubic weight function
-float cubicWeight(float x) {
-    x = (x < 0) ? -x : x;
-    if (x <= 1)
-        return (1.5f * x * x * x) - (2.5f * x * x) + 1.0f;
-    else if (x < 2)
-        return (-0.5f * x * x * x) + (2.5f * x * x) - (4.0f * x) + 2.0f;
-    return 0.0f;
-}
-
-typedef struct {
-    int width;
-    int height;
-    unsigned char* data;
-} Resolution;
 
 // Initialize and fill source resolution data
 Resolution initResolution(int srcWidth, int srcHeight) {
@@ -31,7 +18,7 @@ Resolution initResolution(int srcWidth, int srcHeight) {
     res.width = srcWidth;
     res.height = srcHeight;
 
-    size_t dataSize = res.width * res.height * PIXEL_SIZE;
+    size_t dataSize = (size_t)res.width * res.height * PIXEL_SIZE;
     res.data = (unsigned char*)malloc(dataSize);
 
     if (!res.data) {
@@ -49,59 +36,6 @@ Resolution initResolution(int srcWidth, int srcHeight) {
     return res;
 }
 
-// Bicubic interpolation scaler
-void scaleResolutionBicubic(Resolution* src, Resolution* dst) {
-    float x_ratio = (float)src->width / dst->width;
-    float y_ratio = (float)src->height / dst->height;
-
-    #pragma omp parallel for collapse(2)
-    for (int y = 0; y < dst->height; y++) {
-        for (int x = 0; x < dst->width; x++) {
-            float srcX = x * x_ratio;
-            float srcY = y * y_ratio;
-            int xBase = (int)srcX;
-            int yBase = (int)srcY;
-
-            float dx = srcX - xBase;
-            float dy = srcY - yBase;
-
-            int dstIndex = (y * dst->width + x) * PIXEL_SIZE;
-
-            for (int c = 0; c < PIXEL_SIZE; c++) {
-                float value = 0.0f;
-                float weightSum = 0.0f;
-
-                for (int m = -1; m <= 2; m++) {
-                    for (int n = -1; n <= 2; n++) {
-                        int px = xBase + n;
-                        int py = yBase + m;
-
-                        // Clamp to boundary
-                        if (px < 0) px = 0;
-                        if (px >= src->width) px = src->width - 1;
-                        if (py < 0) py = 0;
-                        if (py >= src->height) py = src->height - 1;
-
-                        int srcIndex = (py * src->width + px) * PIXEL_SIZE;
-
-                        float weight = cubicWeight(n - dx) * cubicWeight(m - dy);
-                        value += weight * src->data[srcIndex + c];
-                        weightSum += weight;
-                    }
-                }
-
-                dst->data[dstIndex + c] = (unsigned char)(value / weightSum);
-            }
-        }
-    }
-}
-
-// Copy resolution data to destination buffer
-void writeResolution(Resolution* res, unsigned char* destMemory) {
-    size_t dataSize = res->width * res->height * PIXEL_SIZE;
-    memcpy(destMemory, res->data, dataSize);
-}
-
 int main(int argc, char* argv[]) {
     if (argc != 3) {
         printf("Usage: %s <src_width> <src_height>\n", argv[0]);
@@ -141,19 +75,33 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    double samples[MAX_ITERATIONS];
+    PerfCounters perf;
+    perfCountersStart(&perf);
+
     double start_time = omp_get_wtime();
 
     // Perform repeated scaling and write
-    #pragma omp parallel for
+    // Iterations run back to back; the scaler is parallel inside, so each
+    // sample times one uncontended scale
     for (int i = 0; i < MAX_ITERATIONS; i++) {
+        double iterStart = omp_get_wtime();
+        PROBE_SCALE_START("bicubic", i, srcRes.width, srcRes.height, dstRes.width, dstRes.height);
         scaleResolutionBicubic(&srcRes, &dstRes);
+        PROBE_SCALE_END("bicubic", i, dstRes.width, dstRes.height);
         writeResolution(&dstRes, destMemory);
+        samples[i] = omp_get_wtime() - iterStart;
     }
 
     double end_time = omp_get_wtime();
     double total_time = end_time - start_time;
 
+    perfCountersStop(&perf);
+
     printf("Completed %d iterations of scaling + writing in %.6f seconds\n", MAX_ITERATIONS, total_time);
+    benchResultsWrite("multi-core", "bicubic", srcWidth, srcHeight, DST_WIDTH, DST_HEIGHT,
+                      omp_get_max_threads(), samples, MAX_ITERATIONS);
+    perfCountersReport(&perf, "bicubic", (double)DST_WIDTH * DST_HEIGHT * MAX_ITERATIONS);
 
     // Cleanup
     free(srcRes.data);
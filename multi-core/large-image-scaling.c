@@ -0,0 +1,292 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <omp.h>
+
+#include "scalers.h"
+#include "perf-counters.h"
+
+// Out-of-core bilinear scaler for gigapixel raw RGBA inputs. The source file
+// is mmap'd read-only and never fully resident: the destination is produced in
+// bands of TILE_COLUMNS-wide tiles, top to bottom, so the source is consumed
+// as one sequential stream. Pages behind the current band are dropped and the
+// next band's rows are prefetched, keeping resident memory under the budget.
+#define DEFAULT_MEMORY_BUDGET_MB 256
+#define TILE_COLUMNS 512  // Destination tile width (one OpenMP task per tile)
+
+typedef struct {
+    int64_t width;
+    int64_t height;
+    size_t stride;  // Bytes per row
+} LargeImage;
+
+// Per-column bilinear taps, shared by every band
+typedef struct {
+    int64_t* xL;
+    int64_t* xH;
+    float* xWeight;
+} ColumnTaps;
+
+// Same mapping as scaleResolutionBilinear, but in double precision: a float
+// source coordinate loses whole pixels beyond 16M columns/rows.
+static inline double sourceCoord(int64_t d, double ratio) {
+    return d * ratio;
+}
+
+void freeColumnTaps(ColumnTaps* taps) {
+    free(taps->xL);
+    free(taps->xH);
+    free(taps->xWeight);
+    taps->xL = taps->xH = NULL;
+    taps->xWeight = NULL;
+}
+
+// Returns 0, or -1 with nothing allocated
+int buildColumnTaps(const LargeImage* src, const LargeImage* dst, ColumnTaps* out) {
+    ColumnTaps taps;
+    double x_ratio = (double)(src->width - 1) / dst->width;
+    taps.xL = (int64_t*)malloc(dst->width * sizeof(int64_t));
+    taps.xH = (int64_t*)malloc(dst->width * sizeof(int64_t));
+    taps.xWeight = (float*)malloc(dst->width * sizeof(float));
+
+    if (!taps.xL || !taps.xH || !taps.xWeight) {
+        fprintf(stderr, "[ERROR] Memory allocation failed for column taps\n");
+        freeColumnTaps(&taps);
+        return -1;
+    }
+
+    #pragma omp parallel for
+    for (int64_t x = 0; x < dst->width; x++) {
+        double srcX = sourceCoord(x, x_ratio);
+        taps.xL[x] = (int64_t)srcX;
+        taps.xH[x] = (taps.xL[x] + 1 < src->width) ? taps.xL[x] + 1 : taps.xL[x];
+        taps.xWeight[x] = (float)(srcX - taps.xL[x]);
+    }
+    *out = taps;
+    return 0;
+}
+
+// Source rows [first, last] needed by destination rows [dy0, dy1)
+void bandSourceRows(const LargeImage* src, int64_t dy0, int64_t dy1, double y_ratio,
+                    int64_t* first, int64_t* last) {
+    *first = (int64_t)sourceCoord(dy0, y_ratio);
+    int64_t yT = (int64_t)sourceCoord(dy1 - 1, y_ratio);
+    *last = (yT + 1 < src->height) ? yT + 1 : yT;
+}
+
+// Scale destination rows [dy0, dy1) into `band` (packed rows of dst->stride)
+void scaleBandBilinear(const unsigned char* srcData, const LargeImage* src, const LargeImage* dst,
+                       const ColumnTaps* taps, double y_ratio, int64_t dy0, int64_t dy1,
+                       unsigned char* band) {
+    int64_t tilesX = (dst->width + TILE_COLUMNS - 1) / TILE_COLUMNS;
+
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int64_t y = dy0; y < dy1; y++) {
+        for (int64_t tx = 0; tx < tilesX; tx++) {
+            double srcY = sourceCoord(y, y_ratio);
+            int64_t yT = (int64_t)srcY;
+            int64_t yB = (yT + 1 < src->height) ? yT + 1 : yT;
+            float yWeight = (float)(srcY - yT);
+
+            const unsigned char* rowT = srcData + (size_t)yT * src->stride;
+            const unsigned char* rowB = srcData + (size_t)yB * src->stride;
+            unsigned char* out = band + (size_t)(y - dy0) * dst->stride;
+
+            int64_t x0 = tx * TILE_COLUMNS;
+            int64_t x1 = (x0 + TILE_COLUMNS < dst->width) ? x0 + TILE_COLUMNS : dst->width;
+
+            for (int64_t x = x0; x < x1; x++) {
+                size_t indexL = (size_t)taps->xL[x] * PIXEL_SIZE;
+                size_t indexH = (size_t)taps->xH[x] * PIXEL_SIZE;
+                size_t dstIndex = (size_t)x * PIXEL_SIZE;
+                float xWeight = taps->xWeight[x];
+
+                for (int c = 0; c < PIXEL_SIZE; c++) {
+                    float top = rowT[indexL + c] * (1 - xWeight) + rowT[indexH + c] * xWeight;
+                    float bottom = rowB[indexL + c] * (1 - xWeight) + rowB[indexH + c] * xWeight;
+                    out[dstIndex + c] = (unsigned char)(top * (1 - yWeight) + bottom * yWeight);
+                }
+            }
+        }
+    }
+}
+
+// Page-aligned madvise over the byte range [begin, end) of the mapping
+void adviseRange(unsigned char* base, size_t mapSize, size_t begin, size_t end, int advice) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    begin &= ~(page - 1);
+    if (end > mapSize) end = mapSize;
+    end &= ~(page - 1);
+    if (begin >= end) return;
+    madvise(base + begin, end - begin, advice);
+}
+
+// Write the whole buffer at `offset`, retrying short writes
+int writeFully(int fd, const unsigned char* data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t written = pwrite(fd, data, size, offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 7 && argc != 8) {
+        printf("Usage: %s <input.rgba> <src_width> <src_height> <output.rgba> <dst_width> <dst_height> [memory_budget_mb]\n", argv[0]);
+        return 1;
+    }
+
+    LargeImage src = {strtoll(argv[2], NULL, 10), strtoll(argv[3], NULL, 10), 0};
+    LargeImage dst = {strtoll(argv[5], NULL, 10), strtoll(argv[6], NULL, 10), 0};
+    char* budgetEnd = NULL;
+    long budgetMb = argc == 8 ? strtol(argv[7], &budgetEnd, 10) : DEFAULT_MEMORY_BUDGET_MB;
+    int budgetValid = budgetMb > 0 && (size_t)budgetMb <= SIZE_MAX >> 20 &&
+                      (argc != 8 || (budgetEnd != argv[7] && *budgetEnd == '\0'));
+
+    if (src.width <= 0 || src.height <= 0 || dst.width <= 0 || dst.height <= 0 || !budgetValid) {
+        printf("Invalid resolution or memory budget.\n");
+        return 1;
+    }
+    size_t budget = (size_t)budgetMb << 20;
+    src.stride = (size_t)src.width * PIXEL_SIZE;
+    dst.stride = (size_t)dst.width * PIXEL_SIZE;
+    size_t srcSize = src.stride * src.height;
+    size_t dstSize = dst.stride * dst.height;
+
+    int srcFd = open(argv[1], O_RDONLY);
+    if (srcFd < 0) {
+        fprintf(stderr, "[ERROR] Failed to open %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(srcFd, &st) < 0 || (size_t)st.st_size < srcSize) {
+        fprintf(stderr, "[ERROR] %s is smaller than %lldx%lld RGBA (%zu bytes)\n",
+                argv[1], (long long)src.width, (long long)src.height, srcSize);
+        close(srcFd);
+        return 1;
+    }
+
+    unsigned char* srcData = (unsigned char*)mmap(NULL, srcSize, PROT_READ, MAP_PRIVATE, srcFd, 0);
+    if (srcData == MAP_FAILED) {
+        fprintf(stderr, "[ERROR] mmap failed for %s: %s\n", argv[1], strerror(errno));
+        close(srcFd);
+        return 1;
+    }
+    madvise(srcData, srcSize, MADV_SEQUENTIAL);
+
+    int dstFd = open(argv[4], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (dstFd < 0 || ftruncate(dstFd, dstSize) < 0) {
+        fprintf(stderr, "[ERROR] Failed to create %s: %s\n", argv[4], strerror(errno));
+        if (dstFd >= 0) close(dstFd);
+        munmap(srcData, srcSize);
+        close(srcFd);
+        return 1;
+    }
+
+    // Each destination row costs its own bytes plus ~y_ratio source rows for
+    // the band being scaled and again for the band being prefetched; two extra
+    // source rows cover the bilinear tap and rounding at band edges.
+    double y_ratio = (double)(src.height - 1) / dst.height;
+    double bytesPerRow = dst.stride + 2.0 * y_ratio * src.stride;
+    double available = (double)budget - 2.0 * src.stride;
+    int64_t bandRows = available > bytesPerRow ? (int64_t)(available / bytesPerRow) : 1;
+    if (bandRows > dst.height) bandRows = dst.height;
+    if (available <= bytesPerRow) {
+        fprintf(stderr, "[WARN] Memory budget too small for one band, using single-row bands\n");
+    }
+
+    unsigned char* band = (unsigned char*)malloc(dst.stride * bandRows);
+    ColumnTaps taps;
+    if (!band) {
+        fprintf(stderr, "[ERROR] Memory allocation failed for destination band\n");
+    }
+    if (!band || buildColumnTaps(&src, &dst, &taps) < 0) {
+        free(band);
+        close(dstFd);
+        munmap(srcData, srcSize);
+        close(srcFd);
+        return 1;
+    }
+
+    printf("[INFO] Scaling %lldx%lld (%.2f GB) -> %lldx%lld, %lld rows per band, budget %zu MB\n",
+           (long long)src.width, (long long)src.height, srcSize / 1e9,
+           (long long)dst.width, (long long)dst.height, (long long)bandRows, budget >> 20);
+
+    PerfCounters perf;
+    perfCountersStart(&perf);
+
+    double start_time = omp_get_wtime();
+    int failed = 0;
+
+    for (int64_t dy0 = 0; dy0 < dst.height; dy0 += bandRows) {
+        int64_t dy1 = (dy0 + bandRows < dst.height) ? dy0 + bandRows : dst.height;
+        int64_t first, last;
+        bandSourceRows(&src, dy0, dy1, y_ratio, &first, &last);
+
+        // Read ahead the next band while this one is being scaled
+        int64_t nextFirst = last, nextLast = last;
+        if (dy1 < dst.height) {
+            int64_t ny1 = (dy1 + bandRows < dst.height) ? dy1 + bandRows : dst.height;
+            bandSourceRows(&src, dy1, ny1, y_ratio, &nextFirst, &nextLast);
+            adviseRange(srcData, srcSize, (size_t)(last + 1) * src.stride,
+                        (size_t)(nextLast + 1) * src.stride, MADV_WILLNEED);
+        }
+
+        PROBE_SCALE_START("large-bilinear", dy0 / bandRows, src.width, src.height, dst.width, dy1 - dy0);
+        scaleBandBilinear(srcData, &src, &dst, &taps, y_ratio, dy0, dy1, band);
+        PROBE_SCALE_END("large-bilinear", dy0 / bandRows, dst.width, dy1 - dy0);
+
+        PROBE_FILE_WRITE(argv[4], (size_t)(dy1 - dy0) * dst.stride);
+        if (writeFully(dstFd, band, (size_t)(dy1 - dy0) * dst.stride, (off_t)(dy0 * dst.stride)) < 0) {
+            fprintf(stderr, "[ERROR] Write failed for %s: %s\n", argv[4], strerror(errno));
+            failed = 1;
+            break;
+        }
+
+        // Drop source rows no later band will touch
+        adviseRange(srcData, srcSize, (size_t)first * src.stride, (size_t)nextFirst * src.stride, MADV_DONTNEED);
+    }
+
+    double total_time = omp_get_wtime() - start_time;
+    perfCountersStop(&perf);
+    if (failed) {
+        freeColumnTaps(&taps);
+        free(band);
+        close(dstFd);
+        munmap(srcData, srcSize);
+        close(srcFd);
+        return 1;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("[INFO] Completed out-of-core scaling in %.6f seconds (%.1f Mpixel/s output)\n",
+           total_time, dst.width * dst.height / total_time / 1e6);
+    printf("[INFO] Peak resident memory: %ld MB\n", usage.ru_maxrss >> 10);
+    perfCountersReport(&perf, "large-image-bilinear", (double)dst.width * dst.height);
+
+    freeColumnTaps(&taps);
+    free(band);
+    int closeResult = close(dstFd);
+    if (closeResult != 0)
+        fprintf(stderr, "[ERROR] Failed to close %s: %s\n", argv[4], strerror(errno));
+    munmap(srcData, srcSize);
+    close(srcFd);
+
+    return closeResult != 0 ? 1 : 0;
+}
@@ -4,16 +4,13 @@
 #include <time.h>
 #include <omp.h>
 
+#include "scalers.h"
+#include "perf-counters.h"
+#include "bench-results.h"
+
 #define MAX_ITERATIONS 100
 #define DST_WIDTH 1920
 #define DST_HEIGHT 1080
-#define PIXEL_SIZE 4  // Assuming 4 bytes per pixel (RGBA)
-
-typedef struct {
-    int width;
-    int height;
-    unsigned char* data;
-} Resolution;
 
 // Function to initialize and fill source resolution data once
 Resolution initResolution(int width, int height) {
@@ -21,7 +18,7 @@ Resolution initResolution(int width, int height) {
     res.width = width;
     res.height = height;
 
-    size_t dataSize = res.width * res.height * PIXEL_SIZE;
+    size_t dataSize = (size_t)res.width * res.height * PIXEL_SIZE;
     res.data = (unsigned char*)malloc(dataSize);
 
     if (res.data == NULL) {
@@ -39,30 +36,6 @@ Resolution initResolution(int width, int height) {
     return res;
 }
 
-// Nearest-neighbor scaling function
-void scaleResolution(Resolution* src, Resolution* dst) {
-    float x_ratio = (float)src->width / dst->width;
-    float y_ratio = (float)src->height / dst->height;
-
-    #pragma omp parallel for collapse(2)
-    for (int y = 0; y < dst->height; y++) {
-        for (int x = 0; x < dst->width; x++) {
-            int srcX = (int)(x * x_ratio);
-            int srcY = (int)(y * y_ratio);
-            int srcIndex = (srcY * src->width + srcX) * PIXEL_SIZE;
-            int dstIndex = (y * dst->width + x) * PIXEL_SIZE;
-
-            memcpy(&dst->data[dstIndex], &src->data[srcIndex], PIXEL_SIZE);
-        }
-    }
-}
-
-// Function to write resolution data to memory
-void writeResolution(Resolution* res, unsigned char* destMemory) {
-    size_t dataSize = res->width * res->height * PIXEL_SIZE;
-    memcpy(destMemory, res->data, dataSize);
-}
-
 int main(int argc, char* argv[]) {
     if (argc != 3) {
         printf("Usage: %s <source_width> <source_height>\n", argv[0]);
@@ -105,13 +78,24 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    double samples[MAX_ITERATIONS];
+    PerfCounters perf;
+    perfCountersStart(&perf);
+
     // Perform read, scale, and write operations multiple times
-    #pragma omp parallel for
+    // Iterations run back to back; the scaler is parallel inside, so each
+    // sample times one uncontended scale
     for (int i = 0; i < MAX_ITERATIONS; i++) {
+        double iterStart = omp_get_wtime();
+        PROBE_SCALE_START("nearest", i, srcRes.width, srcRes.height, dstRes.width, dstRes.height);
         scaleResolution(&srcRes, &dstRes);
+        PROBE_SCALE_END("nearest", i, dstRes.width, dstRes.height);
         writeResolution(&dstRes, destMemory);
+        samples[i] = omp_get_wtime() - iterStart;
     }
 
+    perfCountersStop(&perf);
+
     // Free memory
     free(srcRes.data);
     free(dstRes.data);
@@ -122,6 +106,9 @@ int main(int argc, char* argv[]) {
     double total_time = end_time - start_time;
 
     printf("Completed %d read/scale/write operations in %.6f seconds\n", MAX_ITERATIONS, total_time);
+    benchResultsWrite("multi-core", "nearest", src_width, src_height, DST_WIDTH, DST_HEIGHT,
+                      omp_get_max_threads(), samples, MAX_ITERATIONS);
+    perfCountersReport(&perf, "nearest", (double)DST_WIDTH * DST_HEIGHT * MAX_ITERATIONS);
 
     return 0;
 }
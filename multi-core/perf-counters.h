@@ -0,0 +1,191 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <omp.h>
+
+// Hardware performance counters around a measured region. Counters are
+// opened per OpenMP thread (user space only) when the region starts and
+// summed across threads when it ends, so they cover the same team that runs
+// the kernel. If perf_event_open is blocked (perf_event_paranoid, seccomp,
+// no PMU in a VM) the region is still timed and the counters print as n/a.
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_EVENT_COUNT
+} PerfEvent;
+
+static const char* const perfEventNames[PERF_EVENT_COUNT] = {
+    "cycles", "instructions", "L1D-misses", "LLC-misses", "dTLB-misses", "branch-misses"
+};
+
+typedef struct {
+    int threads;
+    int* fds;  // threads x PERF_EVENT_COUNT, -1 where the event could not be opened
+    uint64_t values[PERF_EVENT_COUNT];
+    int valid[PERF_EVENT_COUNT];  // Opened on at least one thread
+    int openErrno;  // errno of the first failed open, 0 if all opened
+} PerfCounters;
+
+static inline uint64_t perfCacheConfig(uint64_t cache, uint64_t op, uint64_t result) {
+    return cache | (op << 8) | (result << 16);
+}
+
+static void perfEventAttr(PerfEvent event, struct perf_event_attr* attr) {
+    memset(attr, 0, sizeof(*attr));
+    attr->size = sizeof(*attr);
+    attr->disabled = 1;
+    attr->exclude_kernel = 1;  // Allowed at perf_event_paranoid <= 2
+    attr->exclude_hv = 1;
+    attr->read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (event) {
+    case PERF_CYCLES:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case PERF_INSTRUCTIONS:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case PERF_L1D_MISSES:
+        attr->type = PERF_TYPE_HW_CACHE;
+        attr->config = perfCacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                                       PERF_COUNT_HW_CACHE_RESULT_MISS);
+        break;
+    case PERF_LLC_MISSES:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+    case PERF_DTLB_MISSES:
+        attr->type = PERF_TYPE_HW_CACHE;
+        attr->config = perfCacheConfig(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                                       PERF_COUNT_HW_CACHE_RESULT_MISS);
+        break;
+    case PERF_BRANCH_MISSES:
+    default:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    }
+}
+
+// Open and enable the counters on every thread of the OpenMP team
+static void perfCountersStart(PerfCounters* pc) {
+    memset(pc, 0, sizeof(*pc));
+    pc->threads = omp_get_max_threads();
+    pc->fds = (int*)malloc((size_t)pc->threads * PERF_EVENT_COUNT * sizeof(int));
+    if (!pc->fds) {
+        pc->threads = 0;
+        pc->openErrno = ENOMEM;
+        return;
+    }
+    for (int i = 0; i < pc->threads * PERF_EVENT_COUNT; i++) pc->fds[i] = -1;
+
+    #pragma omp parallel num_threads(pc->threads)
+    {
+        int* fds = &pc->fds[omp_get_thread_num() * PERF_EVENT_COUNT];
+        for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+            struct perf_event_attr attr;
+            perfEventAttr((PerfEvent)e, &attr);
+            fds[e] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            if (fds[e] < 0) {
+                #pragma omp critical(perf_counters)
+                if (!pc->openErrno) pc->openErrno = errno;
+                continue;
+            }
+            ioctl(fds[e], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[e], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+// Disable, read (scaled for multiplexing), sum across threads and close
+static void perfCountersStop(PerfCounters* pc) {
+    if (!pc->fds) return;
+
+    #pragma omp parallel num_threads(pc->threads)
+    {
+        int* fds = &pc->fds[omp_get_thread_num() * PERF_EVENT_COUNT];
+        for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+            if (fds[e] >= 0) ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    for (int t = 0; t < pc->threads; t++) {
+        for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+            int fd = pc->fds[t * PERF_EVENT_COUNT + e];
+            if (fd < 0) continue;
+
+            uint64_t data[3];  // value, time enabled, time running
+            if (read(fd, data, sizeof(data)) == sizeof(data) && data[2] > 0) {
+                double scale = (double)data[1] / data[2];
+                pc->values[e] += (uint64_t)(data[0] * scale);
+                pc->valid[e] = 1;
+            }
+            close(fd);
+        }
+    }
+
+    free(pc->fds);
+    pc->fds = NULL;
+}
+
+// Print totals, IPC and per-output-pixel rates for one kernel
+static void perfCountersReport(const PerfCounters* pc, const char* kernel, double outputPixels) {
+    static int warned = 0;
+    int any = 0;
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) any |= pc->valid[e];
+
+    if (!any) {
+        if (!warned) {
+            FILE* f = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+            int paranoid = -99;
+            if (f) {
+                if (fscanf(f, "%d", &paranoid) != 1) paranoid = -99;
+                fclose(f);
+            }
+            printf("[perf] hardware counters unavailable (%s, perf_event_paranoid=%d); reporting wall time only\n",
+                   strerror(pc->openErrno ? pc->openErrno : ENOSYS), paranoid);
+            warned = 1;
+        }
+        return;
+    }
+
+    printf("[perf] %s:", kernel);
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        if (pc->valid[e]) printf(" %s=%llu", perfEventNames[e], (unsigned long long)pc->values[e]);
+        else printf(" %s=n/a", perfEventNames[e]);
+    }
+    printf("\n");
+
+    printf("[perf] %s: IPC=", kernel);
+    if (pc->valid[PERF_CYCLES] && pc->valid[PERF_INSTRUCTIONS] && pc->values[PERF_CYCLES])
+        printf("%.2f", (double)pc->values[PERF_INSTRUCTIONS] / pc->values[PERF_CYCLES]);
+    else
+        printf("n/a");
+    for (int e = PERF_L1D_MISSES; e < PERF_EVENT_COUNT; e++) {
+        if (pc->valid[e] && outputPixels > 0)
+            printf(" %s/pixel=%.4f", perfEventNames[e], pc->values[e] / outputPixels);
+        else
+            printf(" %s/pixel=n/a", perfEventNames[e]);
+    }
+    if (pc->valid[PERF_CYCLES] && outputPixels > 0)
+        printf(" cycles/pixel=%.2f", pc->values[PERF_CYCLES] / outputPixels);
+    printf("\n");
+}
+
+#endif // PERF_COUNTERS_H
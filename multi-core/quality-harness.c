@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "scalers.h"
+#include "tiled-layout.h"
+#include "reference-scalers.h"
+
+// Runs every fast scaling path against its double-precision reference and
+// reports PSNR / SSIM / max abs error next to throughput, so speed/quality
+// trade-offs can be read off one table. Each path is also re-run with
+// different thread counts and flagged if its output changes.
+#define MAX_ITERATIONS 3
+#define SSIM_WINDOW 8
+#define SSIM_STEP 4
+
+typedef void (*ScaleFn)(Resolution* src, Resolution* dst);
+typedef void (*ReferenceFn)(const Resolution* src, Resolution* dst);
+
+typedef struct {
+    const char* name;
+    ScaleFn prepare;  // Untimed setup before each run (may be NULL)
+    ScaleFn run;      // Timed kernel
+    ScaleFn finish;   // Untimed step producing linear output (may be NULL)
+    const char* referenceName;
+    ReferenceFn reference;
+    int downscaleOnly;  // Only meaningful when the destination is smaller
+} FastPath;
+
+typedef struct {
+    double psnr;
+    double ssim;
+    int maxAbsError;
+} Quality;
+
+// Tiled bicubic runs on pre-converted tiles; conversion is not timed
+static TiledResolution tiledSrc, tiledDst;
+
+static void prepareTiled(Resolution* src, Resolution* dst) {
+    if (tiledSrc.width != src->width || tiledSrc.height != src->height) {
+        if (tiledSrc.data) freeTiledResolution(&tiledSrc);
+        tiledSrc = allocTiledResolution(src->width, src->height);
+    }
+    if (tiledDst.width != dst->width || tiledDst.height != dst->height) {
+        if (tiledDst.data) freeTiledResolution(&tiledDst);
+        tiledDst = allocTiledResolution(dst->width, dst->height);
+    }
+    linearToTiled(src, &tiledSrc);
+}
+
+static void runTiledBicubic(Resolution* src, Resolution* dst) {
+    (void)src;
+    (void)dst;
+    scaleTiledBicubic(&tiledSrc, &tiledDst);
+}
+
+static void finishTiled(Resolution* src, Resolution* dst) {
+    (void)src;
+    tiledToLinear(&tiledDst, dst);
+}
+
+static const FastPath fastPaths[] = {
+    {"nearest", NULL, scaleResolution, NULL, "nearest", referenceNearest, 0},
+    {"bilinear", NULL, scaleResolutionBilinear, NULL, "bilinear", referenceBilinear, 0},
+    {"bicubic", NULL, scaleResolutionBicubic, NULL, "bicubic", referenceBicubic, 0},
+    {"tiled-bicubic", prepareTiled, runTiledBicubic, finishTiled, "bicubic", referenceBicubic, 0},
+    // How far each fast path is from a proper area downscale (aliasing)
+    {"nearest", NULL, scaleResolution, NULL, "area", referenceArea, 1},
+    {"bilinear", NULL, scaleResolutionBilinear, NULL, "area", referenceArea, 1},
+    {"bicubic", NULL, scaleResolutionBicubic, NULL, "area", referenceArea, 1},
+};
+
+typedef struct {
+    int srcWidth, srcHeight, dstWidth, dstHeight;
+} Geometry;
+
+static const Geometry defaultGeometries[] = {
+    {1920, 1080, 1280, 720},   // Downscale
+    {3840, 2160, 1920, 1080},  // 2:1 downscale
+    {640, 480, 1920, 1080},    // Upscale
+};
+
+// Deterministic test card: smooth gradients, a zone plate, hard edges and
+// mild noise, so both interpolation error and aliasing show up.
+Resolution initTestPattern(int width, int height) {
+    Resolution res;
+    res.width = width;
+    res.height = height;
+
+    size_t dataSize = (size_t)width * height * PIXEL_SIZE;
+    res.data = (unsigned char*)malloc(dataSize);
+
+    if (!res.data) {
+        printf("Memory allocation failed for source data\n");
+        exit(1);
+    }
+
+    double k = M_PI / (2.0 * (width > height ? width : height));
+
+    #pragma omp parallel for
+    for (int y = 0; y < height; y++) {
+        unsigned int seed = 12345u + y;
+        for (int x = 0; x < width; x++) {
+            unsigned char* p = &res.data[((size_t)y * width + x) * PIXEL_SIZE];
+            int edge = (((x >> 6) ^ (y >> 6)) & 1) ? 48 : 0;
+            int noise = (int)(rand_r(&seed) % 16) - 8;
+            double zone = 127.5 + 127.5 * cos(k * ((double)x * x + (double)y * y));
+
+            int r = (int)(128 + 100 * sin(x * 0.05 + y * 0.02)) + edge + noise;
+            int g = (x * 255) / width + noise;
+            int b = (int)zone;
+            p[0] = r < 0 ? 0 : (r > 255 ? 255 : r);
+            p[1] = g < 0 ? 0 : (g > 255 ? 255 : g);
+            p[2] = (unsigned char)b;
+            p[3] = 255;
+        }
+    }
+    return res;
+}
+
+static inline double luma(const unsigned char* p) {
+    return 0.299 * p[0] + 0.587 * p[1] + 0.114 * p[2];
+}
+
+// PSNR and max abs error over RGB, SSIM over luma in 8x8 windows
+Quality measureQuality(const Resolution* test, const Resolution* ref) {
+    Quality q;
+    size_t pixels = (size_t)test->width * test->height;
+    double squaredError = 0.0;
+    int maxAbsError = 0;
+
+    #pragma omp parallel for reduction(+:squaredError) reduction(max:maxAbsError)
+    for (size_t i = 0; i < pixels; i++) {
+        for (int c = 0; c < 3; c++) {
+            int e = abs((int)test->data[i * PIXEL_SIZE + c] - (int)ref->data[i * PIXEL_SIZE + c]);
+            squaredError += (double)e * e;
+            if (e > maxAbsError) maxAbsError = e;
+        }
+    }
+
+    double mse = squaredError / (pixels * 3.0);
+    q.psnr = (mse == 0.0) ? INFINITY : 10.0 * log10(255.0 * 255.0 / mse);
+    q.maxAbsError = maxAbsError;
+
+    const double c1 = (0.01 * 255) * (0.01 * 255);
+    const double c2 = (0.03 * 255) * (0.03 * 255);
+    double ssimSum = 0.0;
+    long windows = 0;
+
+    #pragma omp parallel for reduction(+:ssimSum, windows)
+    for (int wy = 0; wy <= test->height - SSIM_WINDOW; wy += SSIM_STEP) {
+        for (int wx = 0; wx <= test->width - SSIM_WINDOW; wx += SSIM_STEP) {
+            double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+            for (int y = wy; y < wy + SSIM_WINDOW; y++) {
+                for (int x = wx; x < wx + SSIM_WINDOW; x++) {
+                    size_t i = ((size_t)y * test->width + x) * PIXEL_SIZE;
+                    double a = luma(&test->data[i]);
+                    double b = luma(&ref->data[i]);
+                    sa += a; sb += b; saa += a * a; sbb += b * b; sab += a * b;
+                }
+            }
+            double n = SSIM_WINDOW * SSIM_WINDOW;
+            double ma = sa / n, mb = sb / n;
+            double va = saa / n - ma * ma, vb = sbb / n - mb * mb, cov = sab / n - ma * mb;
+            ssimSum += ((2 * ma * mb + c1) * (2 * cov + c2)) / ((ma * ma + mb * mb + c1) * (va + vb + c2));
+            windows++;
+        }
+    }
+    q.ssim = windows ? ssimSum / windows : 1.0;
+    return q;
+}
+
+// Run a fast path once (prepare, kernel, finish) and return the kernel time
+double runFastPath(const FastPath* path, Resolution* src, Resolution* dst) {
+    if (path->prepare) path->prepare(src, dst);
+    double start_time = omp_get_wtime();
+    path->run(src, dst);
+    double elapsed = omp_get_wtime() - start_time;
+    if (path->finish) path->finish(src, dst);
+    return elapsed;
+}
+
+// Re-run with 1, 2, 4 and all threads; any byte change vs 1 thread fails
+int isDeterministic(const FastPath* path, Resolution* src, Resolution* dst, Resolution* scratch) {
+    int maxThreads = omp_get_max_threads();
+    int threadCounts[] = {1, 2, 4, maxThreads};
+    size_t dataSize = (size_t)dst->width * dst->height * PIXEL_SIZE;
+    int deterministic = 1;
+
+    omp_set_num_threads(1);
+    runFastPath(path, src, dst);
+
+    for (int i = 1; i < 4; i++) {
+        omp_set_num_threads(threadCounts[i]);
+        runFastPath(path, src, scratch);
+        if (memcmp(dst->data, scratch->data, dataSize) != 0) deterministic = 0;
+    }
+
+    omp_set_num_threads(maxThreads);
+    return deterministic;
+}
+
+int main(int argc, char* argv[]) {
+    const char* csvPath = NULL;
+    Geometry custom;
+    const Geometry* geometries = defaultGeometries;
+    int geometryCount = sizeof(defaultGeometries) / sizeof(defaultGeometries[0]);
+
+    int arg = 1;
+    if (arg + 1 < argc && strcmp(argv[arg], "--csv") == 0) {
+        csvPath = argv[arg + 1];
+        arg += 2;
+    }
+    if (argc - arg == 4) {
+        custom.srcWidth = atoi(argv[arg]);
+        custom.srcHeight = atoi(argv[arg + 1]);
+        custom.dstWidth = atoi(argv[arg + 2]);
+        custom.dstHeight = atoi(argv[arg + 3]);
+        if (custom.srcWidth <= 0 || custom.srcHeight <= 0 || custom.dstWidth <= 0 || custom.dstHeight <= 0) {
+            printf("Invalid resolution.\n");
+            return 1;
+        }
+        geometries = &custom;
+        geometryCount = 1;
+    } else if (argc != arg) {
+        printf("Usage: %s [--csv <report.csv>] [<src_width> <src_height> <dst_width> <dst_height>]\n", argv[0]);
+        return 1;
+    }
+
+    FILE* csv = NULL;
+    if (csvPath) {
+        csv = fopen(csvPath, "w");
+        if (!csv) {
+            printf("Failed to open %s\n", csvPath);
+            return 1;
+        }
+        fprintf(csv, "kernel,reference,src_width,src_height,dst_width,dst_height,threads,"
+                     "seconds_per_frame,mpixels_per_second,psnr_db,ssim,max_abs_error,deterministic\n");
+    }
+
+    int failures = 0;
+    int threads = omp_get_max_threads();
+
+    printf("%-14s %-9s %-21s %10s %9s %8s %6s %13s\n",
+           "kernel", "reference", "geometry", "Mpixel/s", "PSNR(dB)", "SSIM", "maxerr", "deterministic");
+
+    for (int g = 0; g < geometryCount; g++) {
+        const Geometry* geo = &geometries[g];
+        int downscale = geo->dstWidth < geo->srcWidth && geo->dstHeight < geo->srcHeight;
+
+        Resolution src = initTestPattern(geo->srcWidth, geo->srcHeight);
+        size_t dstSize = (size_t)geo->dstWidth * geo->dstHeight * PIXEL_SIZE;
+        Resolution dst = {geo->dstWidth, geo->dstHeight, (unsigned char*)malloc(dstSize)};
+        Resolution ref = {geo->dstWidth, geo->dstHeight, (unsigned char*)malloc(dstSize)};
+        Resolution scratch = {geo->dstWidth, geo->dstHeight, (unsigned char*)malloc(dstSize)};
+
+        if (!dst.data || !ref.data || !scratch.data) {
+            printf("Memory allocation failed for destination\n");
+            return 1;
+        }
+
+        char geometry[32];
+        snprintf(geometry, sizeof(geometry), "%dx%d->%dx%d",
+                 geo->srcWidth, geo->srcHeight, geo->dstWidth, geo->dstHeight);
+
+        for (size_t p = 0; p < sizeof(fastPaths) / sizeof(fastPaths[0]); p++) {
+            const FastPath* path = &fastPaths[p];
+            if (path->downscaleOnly && !downscale) continue;
+
+            double total_time = 0.0;
+            for (int i = 0; i < MAX_ITERATIONS; i++) {
+                total_time += runFastPath(path, &src, &dst);
+            }
+            double secondsPerFrame = total_time / MAX_ITERATIONS;
+            double mpixels = (double)geo->dstWidth * geo->dstHeight / secondsPerFrame / 1e6;
+
+            path->reference(&src, &ref);
+            Quality q = measureQuality(&dst, &ref);
+            int deterministic = isDeterministic(path, &src, &dst, &scratch);
+            if (!deterministic) failures++;
+
+            printf("%-14s %-9s %-21s %10.1f %9.2f %8.5f %6d %13s\n",
+                   path->name, path->referenceName, geometry, mpixels, q.psnr, q.ssim,
+                   q.maxAbsError, deterministic ? "yes" : "NO");
+            if (csv) {
+                fprintf(csv, "%s,%s,%d,%d,%d,%d,%d,%.9f,%.3f,%.3f,%.6f,%d,%d\n",
+                        path->name, path->referenceName, geo->srcWidth, geo->srcHeight,
+                        geo->dstWidth, geo->dstHeight, threads, secondsPerFrame, mpixels,
+                        q.psnr, q.ssim, q.maxAbsError, deterministic);
+            }
+        }
+
+        free(src.data);
+        free(dst.data);
+        free(ref.data);
+        free(scratch.data);
+    }
+
+    if (tiledSrc.data) freeTiledResolution(&tiledSrc);
+    if (tiledDst.data) freeTiledResolution(&tiledDst);
+    if (csv) fclose(csv);
+
+    if (failures) {
+        printf("%d kernel(s) produced thread-count dependent output\n", failures);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,146 @@
+#ifndef REFERENCE_SCALERS_H
+#define REFERENCE_SCALERS_H
+
+#include <math.h>
+#include <omp.h>
+
+#include "scalers.h"
+
+// Double-precision reference versions of the scalers in scalers.h. They use
+// the same coordinate mapping as the fast paths but compute everything in
+// double and round to nearest, so any difference against them is error
+// introduced by the fast path (float math, truncation, fixed point, SIMD).
+// They are deliberately simple and are not meant to be fast.
+
+static inline unsigned char referenceRound(double value) {
+    if (value <= 0.0) return 0;
+    if (value >= 255.0) return 255;
+    return (unsigned char)(value + 0.5);
+}
+
+static inline const unsigned char* referencePixel(const Resolution* res, long x, long y) {
+    if (x < 0) x = 0;
+    if (x >= res->width) x = res->width - 1;
+    if (y < 0) y = 0;
+    if (y >= res->height) y = res->height - 1;
+    return &res->data[((size_t)y * res->width + x) * PIXEL_SIZE];
+}
+
+// Nearest neighbour: floor(x * src / dst)
+static void referenceNearest(const Resolution* src, Resolution* dst) {
+    double x_ratio = (double)src->width / dst->width;
+    double y_ratio = (double)src->height / dst->height;
+
+    #pragma omp parallel for
+    for (int y = 0; y < dst->height; y++) {
+        for (int x = 0; x < dst->width; x++) {
+            const unsigned char* p = referencePixel(src, (long)floor(x * x_ratio), (long)floor(y * y_ratio));
+            memcpy(&dst->data[((size_t)y * dst->width + x) * PIXEL_SIZE], p, PIXEL_SIZE);
+        }
+    }
+}
+
+// Bilinear with the (src - 1) / dst mapping used by scaleResolutionBilinear
+static void referenceBilinear(const Resolution* src, Resolution* dst) {
+    double x_ratio = (double)(src->width - 1) / dst->width;
+    double y_ratio = (double)(src->height - 1) / dst->height;
+
+    #pragma omp parallel for
+    for (int y = 0; y < dst->height; y++) {
+        for (int x = 0; x < dst->width; x++) {
+            double srcX = x * x_ratio;
+            double srcY = y * y_ratio;
+            long xL = (long)floor(srcX);
+            long yT = (long)floor(srcY);
+            double fx = srcX - xL;
+            double fy = srcY - yT;
+
+            const unsigned char* tl = referencePixel(src, xL, yT);
+            const unsigned char* tr = referencePixel(src, xL + 1, yT);
+            const unsigned char* bl = referencePixel(src, xL, yT + 1);
+            const unsigned char* br = referencePixel(src, xL + 1, yT + 1);
+            unsigned char* out = &dst->data[((size_t)y * dst->width + x) * PIXEL_SIZE];
+
+            for (int c = 0; c < PIXEL_SIZE; c++) {
+                double top = tl[c] * (1.0 - fx) + tr[c] * fx;
+                double bottom = bl[c] * (1.0 - fx) + br[c] * fx;
+                out[c] = referenceRound(top * (1.0 - fy) + bottom * fy);
+            }
+        }
+    }
+}
+
+// Keys cubic kernel, a = -0.5 (same curve as cubicWeight)
+static inline double referenceCubicWeight(double x) {
+    x = fabs(x);
+    if (x <= 1.0)
+        return 1.5 * x * x * x - 2.5 * x * x + 1.0;
+    else if (x < 2.0)
+        return -0.5 * x * x * x + 2.5 * x * x - 4.0 * x + 2.0;
+    return 0.0;
+}
+
+// Bicubic with the src / dst mapping and weight normalisation of scaleResolutionBicubic
+static void referenceBicubic(const Resolution* src, Resolution* dst) {
+    double x_ratio = (double)src->width / dst->width;
+    double y_ratio = (double)src->height / dst->height;
+
+    #pragma omp parallel for
+    for (int y = 0; y < dst->height; y++) {
+        for (int x = 0; x < dst->width; x++) {
+            double srcX = x * x_ratio;
+            double srcY = y * y_ratio;
+            long xBase = (long)floor(srcX);
+            long yBase = (long)floor(srcY);
+            double dx = srcX - xBase;
+            double dy = srcY - yBase;
+            unsigned char* out = &dst->data[((size_t)y * dst->width + x) * PIXEL_SIZE];
+
+            double value[PIXEL_SIZE] = {0};
+            double weightSum = 0.0;
+
+            for (int m = -1; m <= 2; m++) {
+                for (int n = -1; n <= 2; n++) {
+                    double weight = referenceCubicWeight(n - dx) * referenceCubicWeight(m - dy);
+                    const unsigned char* p = referencePixel(src, xBase + n, yBase + m);
+                    for (int c = 0; c < PIXEL_SIZE; c++) value[c] += weight * p[c];
+                    weightSum += weight;
+                }
+            }
+
+            for (int c = 0; c < PIXEL_SIZE; c++) out[c] = referenceRound(value[c] / weightSum);
+        }
+    }
+}
+
+// Area-average (box) downscale: each destination pixel is the exact
+// coverage-weighted mean of the source rectangle it maps onto.
+static void referenceArea(const Resolution* src, Resolution* dst) {
+    double x_ratio = (double)src->width / dst->width;
+    double y_ratio = (double)src->height / dst->height;
+
+    #pragma omp parallel for
+    for (int y = 0; y < dst->height; y++) {
+        double y0 = y * y_ratio, y1 = (y + 1) * y_ratio;
+        for (int x = 0; x < dst->width; x++) {
+            double x0 = x * x_ratio, x1 = (x + 1) * x_ratio;
+            double value[PIXEL_SIZE] = {0};
+            double area = 0.0;
+
+            for (long sy = (long)floor(y0); sy < (long)ceil(y1); sy++) {
+                double wy = fmin(y1, sy + 1.0) - fmax(y0, (double)sy);
+                for (long sx = (long)floor(x0); sx < (long)ceil(x1); sx++) {
+                    double w = wy * (fmin(x1, sx + 1.0) - fmax(x0, (double)sx));
+                    const unsigned char* p = referencePixel(src, sx, sy);
+                    for (int c = 0; c < PIXEL_SIZE; c++) value[c] += w * p[c];
+                    area += w;
+                }
+            }
+
+            unsigned char* out = &dst->data[((size_t)y * dst->width + x) * PIXEL_SIZE];
+            for (int c = 0; c < PIXEL_SIZE; c++) out[c] = referenceRound(value[c] / area);
+        }
+    }
+}
+
+#endif // REFERENCE_SCALERS_H
@@ -0,0 +1,141 @@
+#ifndef SCALERS_H
+#define SCALERS_H
+
+#include <string.h>
+#include <omp.h>
+
+#include "usdt-probes.h"
+
+#define PIXEL_SIZE 4  // Assuming 4 bytes per pixel (RGBA)
+
+typedef struct {
+    int width;
+    int height;
+    unsigned char* data;
+} Resolution;
+
+// Clamp a filtered value to the 0..255 range before narrowing; bicubic
+// overshoots on edges and a plain cast wraps around
+static inline unsigned char clampToByte(float value) {
+    if (value <= 0.0f) return 0;
+    if (value >= 255.0f) return 255;
+    return (unsigned char)value;
+}
+
+// Bicubic weight function
+static inline float cubicWeight(float x) {
+    x = (x < 0) ? -x : x;
+    if (x <= 1)
+        return (1.5f * x * x * x) - (2.5f * x * x) + 1.0f;
+    else if (x < 2)
+        return (-0.5f * x * x * x) + (2.5f * x * x) - (4.0f * x) + 2.0f;
+    return 0.0f;
+}
+
+// Nearest-neighbor scaling function
+static inline void scaleResolution(Resolution* src, Resolution* dst) {
+    float x_ratio = (float)src->width / dst->width;
+    float y_ratio = (float)src->height / dst->height;
+
+    #pragma omp parallel for collapse(2)
+    for (int y = 0; y < dst->height; y++) {
+        for (int x = 0; x < dst->width; x++) {
+            int srcX = (int)(x * x_ratio);
+            int srcY = (int)(y * y_ratio);
+            size_t srcIndex = ((size_t)srcY * src->width + srcX) * PIXEL_SIZE;
+            size_t dstIndex = ((size_t)y * dst->width + x) * PIXEL_SIZE;
+
+            memcpy(&dst->data[dstIndex], &src->data[srcIndex], PIXEL_SIZE);
+        }
+    }
+}
+
+// Bilinear interpolation scaling function
+static inline void scaleResolutionBilinear(Resolution* src, Resolution* dst) {
+    float x_ratio = ((float)src->width - 1) / dst->width;
+    float y_ratio = ((float)src->height - 1) / dst->height;
+
+    #pragma omp parallel for collapse(2)
+    for (int y = 0; y < dst->height; y++) {
+        for (int x = 0; x < dst->width; x++) {
+            float srcX = x * x_ratio;
+            float srcY = y * y_ratio;
+            int xL = (int)srcX;
+            int yT = (int)srcY;
+            int xH = (xL + 1 < src->width) ? xL + 1 : xL;
+            int yB = (yT + 1 < src->height) ? yT + 1 : yT;
+
+            float xWeight = srcX - xL;
+            float yWeight = srcY - yT;
+
+            size_t indexTL = ((size_t)yT * src->width + xL) * PIXEL_SIZE;
+            size_t indexTR = ((size_t)yT * src->width + xH) * PIXEL_SIZE;
+            size_t indexBL = ((size_t)yB * src->width + xL) * PIXEL_SIZE;
+            size_t indexBR = ((size_t)yB * src->width + xH) * PIXEL_SIZE;
+
+            size_t dstIndex = ((size_t)y * dst->width + x) * PIXEL_SIZE;
+
+            for (int c = 0; c < PIXEL_SIZE; c++) {
+                float top = src->data[indexTL + c] * (1 - xWeight) + src->data[indexTR + c] * xWeight;
+                float bottom = src->data[indexBL + c] * (1 - xWeight) + src->data[indexBR + c] * xWeight;
+                dst->data[dstIndex + c] = (unsigned char)(top * (1 - yWeight) + bottom * yWeight);
+            }
+        }
+    }
+}
+
+// Bicubic interpolation scaler
+static inline void scaleResolutionBicubic(Resolution* src, Resolution* dst) {
+    float x_ratio = (float)src->width / dst->width;
+    float y_ratio = (float)src->height / dst->height;
+
+    #pragma omp parallel for collapse(2)
+    for (int y = 0; y < dst->height; y++) {
+        for (int x = 0; x < dst->width; x++) {
+            float srcX = x * x_ratio;
+            float srcY = y * y_ratio;
+            int xBase = (int)srcX;
+            int yBase = (int)srcY;
+
+            float dx = srcX - xBase;
+            float dy = srcY - yBase;
+
+            size_t dstIndex = ((size_t)y * dst->width + x) * PIXEL_SIZE;
+
+            for (int c = 0; c < PIXEL_SIZE; c++) {
+                float value = 0.0f;
+                float weightSum = 0.0f;
+
+                for (int m = -1; m <= 2; m++) {
+                    for (int n = -1; n <= 2; n++) {
+                        int px = xBase + n;
+                        int py = yBase + m;
+
+                        // Clamp to boundary
+                        if (px < 0) px = 0;
+                        if (px >= src->width) px = src->width - 1;
+                        if (py < 0) py = 0;
+                        if (py >= src->height) py = src->height - 1;
+
+                        size_t srcIndex = ((size_t)py * src->width + px) * PIXEL_SIZE;
+
+                        float weight = cubicWeight(n - dx) * cubicWeight(m - dy);
+                        value += weight * src->data[srcIndex + c];
+                        weightSum += weight;
+                    }
+                }
+
+                dst->data[dstIndex + c] = clampToByte(value / weightSum);
+            }
+        }
+    }
+}
+
+// Function to write resolution data to memory
+static inline void writeResolution(Resolution* res, unsigned char* destMemory) {
+    size_t dataSize = (size_t)res->width * res->height * PIXEL_SIZE;
+    memcpy(destMemory, res->data, dataSize);
+    PROBE_BUFFER_WRITE(destMemory, dataSize, res->width, res->height);
+}
+
+#endif // SCALERS_H
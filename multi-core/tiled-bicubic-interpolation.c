@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <omp.h>
+
+#include "scalers.h"
+#include "tiled-layout.h"
+#include "perf-counters.h"
+#include "bench-results.h"
+
+#define MAX_ITERATIONS 100
+#define DST_WIDTH 1920
+#define DST_HEIGHT 1080
+
+// Initialize and fill source resolution data
+Resolution initResolution(int srcWidth, int srcHeight) {
+    Resolution res;
+    res.width = srcWidth;
+    res.height = srcHeight;
+
+    size_t dataSize = (size_t)res.width * res.height * PIXEL_SIZE;
+    res.data = (unsigned char*)malloc(dataSize);
+
+    if (!res.data) {
+        printf("Memory allocation failed for source data\n");
+        exit(1);
+    }
+
+    // Fill with a pattern once
+    #pragma omp parallel for
+    for (size_t i = 0; i < dataSize; i++) {
+        res.data[i] = rand() % 256;
+    }
+
+    printf("Initialized source resolution: %dx%d\n", res.width, res.height);
+    return res;
+}
+
+// Count bytes that differ between two linear buffers of the same geometry
+size_t countMismatches(const Resolution* a, const Resolution* b) {
+    size_t dataSize = (size_t)a->width * a->height * PIXEL_SIZE;
+    size_t mismatches = 0;
+
+    #pragma omp parallel for reduction(+:mismatches)
+    for (size_t i = 0; i < dataSize; i++) {
+        mismatches += (a->data[i] != b->data[i]);
+    }
+    return mismatches;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        printf("Usage: %s <src_width> <src_height>\n", argv[0]);
+        return 1;
+    }
+
+    int srcWidth = atoi(argv[1]);
+    int srcHeight = atoi(argv[2]);
+
+    if (srcWidth <= 0 || srcHeight <= 0) {
+        printf("Invalid source resolution.\n");
+        return 1;
+    }
+
+    // Initialize source in both layouts
+    Resolution srcRes = initResolution(srcWidth, srcHeight);
+    TiledResolution srcTiled = allocTiledResolution(srcWidth, srcHeight);
+
+    // Linear and tiled destinations, plus a linear copy of the tiled result
+    size_t dstSize = DST_WIDTH * DST_HEIGHT * PIXEL_SIZE;
+    Resolution dstRes = {DST_WIDTH, DST_HEIGHT, (unsigned char*)malloc(dstSize)};
+    Resolution dstFromTiled = {DST_WIDTH, DST_HEIGHT, (unsigned char*)malloc(dstSize)};
+    TiledResolution dstTiled = allocTiledResolution(DST_WIDTH, DST_HEIGHT);
+
+    // Rotation targets (height x width of the source)
+    size_t srcSize = (size_t)srcWidth * srcHeight * PIXEL_SIZE;
+    Resolution rotRes = {srcHeight, srcWidth, (unsigned char*)malloc(srcSize)};
+    Resolution rotFromTiled = {srcHeight, srcWidth, (unsigned char*)malloc(srcSize)};
+    TiledResolution rotTiled = allocTiledResolution(srcHeight, srcWidth);
+
+    if (!dstRes.data || !dstFromTiled.data || !rotRes.data || !rotFromTiled.data) {
+        printf("Memory allocation failed for destination\n");
+        return 1;
+    }
+
+    printf("Tile size: %dx%d (%d bytes), source tiles: %dx%d\n",
+           TILE_SIZE, TILE_SIZE, TILE_BYTES, srcTiled.tilesX, srcTiled.tilesY);
+
+    // Layout conversion cost
+    double start_time = omp_get_wtime();
+    for (int i = 0; i < MAX_ITERATIONS; i++) {
+        linearToTiled(&srcRes, &srcTiled);
+    }
+    double to_tiled_time = omp_get_wtime() - start_time;
+
+    start_time = omp_get_wtime();
+    for (int i = 0; i < MAX_ITERATIONS; i++) {
+        tiledToLinear(&srcTiled, &srcRes);
+    }
+    double to_linear_time = omp_get_wtime() - start_time;
+
+    // Per-iteration samples for bench-results
+    double linear_bicubic_samples[MAX_ITERATIONS], tiled_bicubic_samples[MAX_ITERATIONS];
+    double linear_rotate_samples[MAX_ITERATIONS], tiled_rotate_samples[MAX_ITERATIONS];
+
+    // Bicubic: linear vs tiled
+    PerfCounters linear_bicubic_perf;
+    perfCountersStart(&linear_bicubic_perf);
+    start_time = omp_get_wtime();
+    for (int i = 0; i < MAX_ITERATIONS; i++) {
+        double iterStart = omp_get_wtime();
+        PROBE_SCALE_START("linear-bicubic", i, srcRes.width, srcRes.height, dstRes.width, dstRes.height);
+        scaleResolutionBicubic(&srcRes, &dstRes);
+        PROBE_SCALE_END("linear-bicubic", i, dstRes.width, dstRes.height);
+        linear_bicubic_samples[i] = omp_get_wtime() - iterStart;
+    }
+    double linear_bicubic_time = omp_get_wtime() - start_time;
+    perfCountersStop(&linear_bicubic_perf);
+
+    PerfCounters tiled_bicubic_perf;
+    perfCountersStart(&tiled_bicubic_perf);
+    start_time = omp_get_wtime();
+    for (int i = 0; i < MAX_ITERATIONS; i++) {
+        double iterStart = omp_get_wtime();
+        PROBE_SCALE_START("tiled-bicubic", i, srcTiled.width, srcTiled.height, dstTiled.width, dstTiled.height);
+        scaleTiledBicubic(&srcTiled, &dstTiled);
+        PROBE_SCALE_END("tiled-bicubic", i, dstTiled.width, dstTiled.height);
+        tiled_bicubic_samples[i] = omp_get_wtime() - iterStart;
+    }
+    double tiled_bicubic_time = omp_get_wtime() - start_time;
+    perfCountersStop(&tiled_bicubic_perf);
+
+    // Rotation: linear vs tiled
+    PerfCounters linear_rotate_perf;
+    perfCountersStart(&linear_rotate_perf);
+    start_time = omp_get_wtime();
+    for (int i = 0; i < MAX_ITERATIONS; i++) {
+        double iterStart = omp_get_wtime();
+        PROBE_SCALE_START("linear-rotate", i, srcRes.width, srcRes.height, rotRes.width, rotRes.height);
+        rotateResolution90(&srcRes, &rotRes);
+        PROBE_SCALE_END("linear-rotate", i, rotRes.width, rotRes.height);
+        linear_rotate_samples[i] = omp_get_wtime() - iterStart;
+    }
+    double linear_rotate_time = omp_get_wtime() - start_time;
+    perfCountersStop(&linear_rotate_perf);
+
+    PerfCounters tiled_rotate_perf;
+    perfCountersStart(&tiled_rotate_perf);
+    start_time = omp_get_wtime();
+    for (int i = 0; i < MAX_ITERATIONS; i++) {
+        double iterStart = omp_get_wtime();
+        PROBE_SCALE_START("tiled-rotate", i, srcTiled.width, srcTiled.height, rotTiled.width, rotTiled.height);
+        rotateTiled90(&srcTiled, &rotTiled);
+        PROBE_SCALE_END("tiled-rotate", i, rotTiled.width, rotTiled.height);
+        tiled_rotate_samples[i] = omp_get_wtime() - iterStart;
+    }
+    double tiled_rotate_time = omp_get_wtime() - start_time;
+    perfCountersStop(&tiled_rotate_perf);
+
+    // Tiled kernels must reproduce the linear results exactly
+    tiledToLinear(&dstTiled, &dstFromTiled);
+    tiledToLinear(&rotTiled, &rotFromTiled);
+    size_t bicubic_mismatches = countMismatches(&dstRes, &dstFromTiled);
+    size_t rotate_mismatches = countMismatches(&rotRes, &rotFromTiled);
+
+    printf("Completed %d linear->tiled conversions in %.6f seconds\n", MAX_ITERATIONS, to_tiled_time);
+    printf("Completed %d tiled->linear conversions in %.6f seconds\n", MAX_ITERATIONS, to_linear_time);
+    printf("Completed %d linear bicubic scalings in %.6f seconds\n", MAX_ITERATIONS, linear_bicubic_time);
+    printf("Completed %d tiled bicubic scalings in %.6f seconds (%.2fx)\n", MAX_ITERATIONS,
+           tiled_bicubic_time, linear_bicubic_time / tiled_bicubic_time);
+    printf("Completed %d linear rotations in %.6f seconds\n", MAX_ITERATIONS, linear_rotate_time);
+    printf("Completed %d tiled rotations in %.6f seconds (%.2fx)\n", MAX_ITERATIONS,
+           tiled_rotate_time, linear_rotate_time / tiled_rotate_time);
+    printf("Mismatched bytes vs linear: bicubic %zu, rotation %zu\n", bicubic_mismatches, rotate_mismatches);
+
+    double dstPixels = (double)DST_WIDTH * DST_HEIGHT * MAX_ITERATIONS;
+    double rotPixels = (double)srcWidth * srcHeight * MAX_ITERATIONS;
+    perfCountersReport(&linear_bicubic_perf, "linear-bicubic", dstPixels);
+    perfCountersReport(&tiled_bicubic_perf, "tiled-bicubic", dstPixels);
+    perfCountersReport(&linear_rotate_perf, "linear-rotate", rotPixels);
+    perfCountersReport(&tiled_rotate_perf, "tiled-rotate", rotPixels);
+
+    int threads = omp_get_max_threads();
+    benchResultsWrite("multi-core", "linear-bicubic", srcWidth, srcHeight, DST_WIDTH, DST_HEIGHT,
+                      threads, linear_bicubic_samples, MAX_ITERATIONS);
+    benchResultsWrite("multi-core", "tiled-bicubic", srcWidth, srcHeight, DST_WIDTH, DST_HEIGHT,
+                      threads, tiled_bicubic_samples, MAX_ITERATIONS);
+    benchResultsWrite("multi-core", "linear-rotate", srcWidth, srcHeight, srcHeight, srcWidth,
+                      threads, linear_rotate_samples, MAX_ITERATIONS);
+    benchResultsWrite("multi-core", "tiled-rotate", srcWidth, srcHeight, srcHeight, srcWidth,
+                      threads, tiled_rotate_samples, MAX_ITERATIONS);
+
+    // Cleanup
+    free(srcRes.data);
+    free(dstRes.data);
+    free(dstFromTiled.data);
+    free(rotRes.data);
+    free(rotFromTiled.data);
+    freeTiledResolution(&srcTiled);
+    freeTiledResolution(&dstTiled);
+    freeTiledResolution(&rotTiled);
+
+    return (bicubic_mismatches || rotate_mismatches) ? 1 : 0;
+}
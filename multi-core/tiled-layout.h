@@ -0,0 +1,251 @@
+#ifndef TILED_LAYOUT_H
+#define TILED_LAYOUT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "scalers.h"
+
+// Block-linear layout: the image is split into TILE_SIZE x TILE_SIZE pixel
+// tiles, each stored contiguously (row-major inside the tile, tiles row-major
+// across the image). A 64x64 RGBA tile is 16 KB, so a 4x4 bicubic footprint
+// touches at most 4 tiles instead of 4 rows that are a full stride apart.
+#define TILE_SHIFT 6
+#define TILE_SIZE (1 << TILE_SHIFT)  // 64x64 pixels per tile
+#define TILE_MASK (TILE_SIZE - 1)
+#define TILE_BYTES (TILE_SIZE * TILE_SIZE * PIXEL_SIZE)
+#define TILE_ALIGNMENT 64  // Cache line
+
+typedef struct {
+    int width;
+    int height;
+    int tilesX;  // Tiles per tile row (edge tiles are padded to TILE_SIZE)
+    int tilesY;
+    unsigned char* data;
+} TiledResolution;
+
+// Allocate a tiled image; edge tiles are padded and their padding is never read
+static inline TiledResolution allocTiledResolution(int width, int height) {
+    TiledResolution res;
+    res.width = width;
+    res.height = height;
+    res.tilesX = (width + TILE_SIZE - 1) >> TILE_SHIFT;
+    res.tilesY = (height + TILE_SIZE - 1) >> TILE_SHIFT;
+
+    size_t dataSize = (size_t)res.tilesX * res.tilesY * TILE_BYTES;
+    res.data = (unsigned char*)aligned_alloc(TILE_ALIGNMENT, dataSize);
+
+    if (!res.data) {
+        printf("Memory allocation failed for tiled data\n");
+        exit(1);
+    }
+    return res;
+}
+
+static inline void freeTiledResolution(TiledResolution* res) {
+    free(res->data);
+    res->data = NULL;
+}
+
+// Address of pixel (x, y) inside a tiled image
+static inline unsigned char* tiledPixel(const TiledResolution* res, int x, int y) {
+    size_t tile = (size_t)(y >> TILE_SHIFT) * res->tilesX + (x >> TILE_SHIFT);
+    size_t inTile = ((size_t)(y & TILE_MASK) << TILE_SHIFT) + (x & TILE_MASK);
+    return res->data + tile * TILE_BYTES + inTile * PIXEL_SIZE;
+}
+
+// Start of row `row` inside tile (tx, ty)
+static inline unsigned char* tileRow(const TiledResolution* res, int tx, int ty, int row) {
+    size_t tile = (size_t)ty * res->tilesX + tx;
+    return res->data + tile * TILE_BYTES + (size_t)row * TILE_SIZE * PIXEL_SIZE;
+}
+
+// Convert linear (row-major) data to tiled layout, one tile per task
+static inline void linearToTiled(const Resolution* src, TiledResolution* dst) {
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int ty = 0; ty < dst->tilesY; ty++) {
+        for (int tx = 0; tx < dst->tilesX; tx++) {
+            int x0 = tx << TILE_SHIFT;
+            int y0 = ty << TILE_SHIFT;
+            int w = (x0 + TILE_SIZE <= src->width) ? TILE_SIZE : src->width - x0;
+            int h = (y0 + TILE_SIZE <= src->height) ? TILE_SIZE : src->height - y0;
+
+            for (int row = 0; row < h; row++) {
+                size_t srcIndex = ((size_t)(y0 + row) * src->width + x0) * PIXEL_SIZE;
+                memcpy(tileRow(dst, tx, ty, row), &src->data[srcIndex], (size_t)w * PIXEL_SIZE);
+            }
+        }
+    }
+}
+
+// Convert tiled data back to linear (row-major) layout
+static inline void tiledToLinear(const TiledResolution* src, Resolution* dst) {
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int ty = 0; ty < src->tilesY; ty++) {
+        for (int tx = 0; tx < src->tilesX; tx++) {
+            int x0 = tx << TILE_SHIFT;
+            int y0 = ty << TILE_SHIFT;
+            int w = (x0 + TILE_SIZE <= dst->width) ? TILE_SIZE : dst->width - x0;
+            int h = (y0 + TILE_SIZE <= dst->height) ? TILE_SIZE : dst->height - y0;
+
+            for (int row = 0; row < h; row++) {
+                size_t dstIndex = ((size_t)(y0 + row) * dst->width + x0) * PIXEL_SIZE;
+                memcpy(&dst->data[dstIndex], tileRow(src, tx, ty, row), (size_t)w * PIXEL_SIZE);
+            }
+        }
+    }
+}
+
+// Copy the clamped source window [x0, x1] x [y0, y1] out of the tiles into a
+// small linear scratch buffer; each source tile row is a contiguous read.
+static inline void gatherTiledWindow(const TiledResolution* src, int x0, int y0, int x1, int y1,
+                              unsigned char* window) {
+    int winWidth = x1 - x0 + 1;
+    for (int y = y0; y <= y1; y++) {
+        unsigned char* out = window + (size_t)(y - y0) * winWidth * PIXEL_SIZE;
+        int x = x0;
+        while (x <= x1) {
+            int run = TILE_SIZE - (x & TILE_MASK);
+            if (run > x1 - x + 1) run = x1 - x + 1;
+            memcpy(out, tiledPixel(src, x, y), (size_t)run * PIXEL_SIZE);
+            out += (size_t)run * PIXEL_SIZE;
+            x += run;
+        }
+    }
+}
+
+// Bicubic scaler operating natively on tiles: each task produces one
+// destination tile from a gathered source window. Taps, weights and the
+// accumulation order match scaleResolutionBicubic, so results are identical.
+static inline void scaleTiledBicubic(const TiledResolution* src, TiledResolution* dst) {
+    float x_ratio = (float)src->width / dst->width;
+    float y_ratio = (float)src->height / dst->height;
+
+    // Largest window a destination tile can need (+1 rounding, +3 filter taps)
+    int maxWinWidth = (int)(TILE_SIZE * x_ratio) + 5;
+    int maxWinHeight = (int)(TILE_SIZE * y_ratio) + 5;
+    if (maxWinWidth > src->width) maxWinWidth = src->width;
+    if (maxWinHeight > src->height) maxWinHeight = src->height;
+
+    int allocFailed = 0;
+
+    #pragma omp parallel
+    {
+        unsigned char* window = (unsigned char*)malloc((size_t)maxWinWidth * maxWinHeight * PIXEL_SIZE);
+        float wx[TILE_SIZE][4], wy[TILE_SIZE][4];
+        int xBase[TILE_SIZE], yBase[TILE_SIZE];
+
+        if (!window) {
+            #pragma omp atomic write
+            allocFailed = 1;
+        }
+        // Every thread must see the same flag before deciding on the worksharing loop
+        #pragma omp barrier
+
+        if (!allocFailed) {
+            #pragma omp for collapse(2) schedule(dynamic, 4)
+            for (int ty = 0; ty < dst->tilesY; ty++) {
+                for (int tx = 0; tx < dst->tilesX; tx++) {
+                    int dx0 = tx << TILE_SHIFT;
+                    int dy0 = ty << TILE_SHIFT;
+                    int w = (dx0 + TILE_SIZE <= dst->width) ? TILE_SIZE : dst->width - dx0;
+                    int h = (dy0 + TILE_SIZE <= dst->height) ? TILE_SIZE : dst->height - dy0;
+
+                    // Per-column and per-row taps for this tile
+                    for (int i = 0; i < w; i++) {
+                        float srcX = (dx0 + i) * x_ratio;
+                        xBase[i] = (int)srcX;
+                        float d = srcX - xBase[i];
+                        for (int n = -1; n <= 2; n++) wx[i][n + 1] = cubicWeight(n - d);
+                    }
+                    for (int j = 0; j < h; j++) {
+                        float srcY = (dy0 + j) * y_ratio;
+                        yBase[j] = (int)srcY;
+                        float d = srcY - yBase[j];
+                        for (int m = -1; m <= 2; m++) wy[j][m + 1] = cubicWeight(m - d);
+                    }
+
+                    int x0 = xBase[0] - 1 < 0 ? 0 : xBase[0] - 1;
+                    int y0 = yBase[0] - 1 < 0 ? 0 : yBase[0] - 1;
+                    int x1 = xBase[w - 1] + 2 >= src->width ? src->width - 1 : xBase[w - 1] + 2;
+                    int y1 = yBase[h - 1] + 2 >= src->height ? src->height - 1 : yBase[h - 1] + 2;
+                    int winWidth = x1 - x0 + 1;
+                    gatherTiledWindow(src, x0, y0, x1, y1, window);
+
+                    for (int j = 0; j < h; j++) {
+                        unsigned char* out = tileRow(dst, tx, ty, j);
+                        for (int i = 0; i < w; i++) {
+                            for (int c = 0; c < PIXEL_SIZE; c++) {
+                                float value = 0.0f;
+                                float weightSum = 0.0f;
+
+                                for (int m = -1; m <= 2; m++) {
+                                    int py = yBase[j] + m;
+                                    if (py < 0) py = 0;
+                                    if (py >= src->height) py = src->height - 1;
+                                    const unsigned char* row = window + (size_t)(py - y0) * winWidth * PIXEL_SIZE;
+
+                                    for (int n = -1; n <= 2; n++) {
+                                        int px = xBase[i] + n;
+                                        if (px < 0) px = 0;
+                                        if (px >= src->width) px = src->width - 1;
+
+                                        float weight = wx[i][n + 1] * wy[j][m + 1];
+                                        value += weight * row[(px - x0) * PIXEL_SIZE + c];
+                                        weightSum += weight;
+                                    }
+                                }
+
+                                out[i * PIXEL_SIZE + c] = clampToByte(value / weightSum);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        free(window);
+    }
+
+    if (allocFailed) {
+        printf("Memory allocation failed for tile window\n");
+        exit(1);
+    }
+}
+
+// Rotate 90 degrees clockwise on linear data (dst is height x width of src)
+static inline void rotateResolution90(const Resolution* src, Resolution* dst) {
+    #pragma omp parallel for collapse(2)
+    for (int y = 0; y < dst->height; y++) {
+        for (int x = 0; x < dst->width; x++) {
+            size_t srcIndex = ((size_t)(src->height - 1 - x) * src->width + y) * PIXEL_SIZE;
+            size_t dstIndex = ((size_t)y * dst->width + x) * PIXEL_SIZE;
+            memcpy(&dst->data[dstIndex], &src->data[srcIndex], PIXEL_SIZE);
+        }
+    }
+}
+
+// Rotate 90 degrees clockwise tile by tile: every destination tile reads from
+// at most four source tiles, which stay cache resident for the whole tile.
+static inline void rotateTiled90(const TiledResolution* src, TiledResolution* dst) {
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int ty = 0; ty < dst->tilesY; ty++) {
+        for (int tx = 0; tx < dst->tilesX; tx++) {
+            int dx0 = tx << TILE_SHIFT;
+            int dy0 = ty << TILE_SHIFT;
+            int w = (dx0 + TILE_SIZE <= dst->width) ? TILE_SIZE : dst->width - dx0;
+            int h = (dy0 + TILE_SIZE <= dst->height) ? TILE_SIZE : dst->height - dy0;
+
+            for (int j = 0; j < h; j++) {
+                unsigned char* out = tileRow(dst, tx, ty, j);
+                for (int i = 0; i < w; i++) {
+                    memcpy(out + i * PIXEL_SIZE, tiledPixel(src, dy0 + j, src->height - 1 - (dx0 + i)), PIXEL_SIZE);
+                }
+            }
+        }
+    }
+}
+
+#endif // TILED_LAYOUT_H
@@ -0,0 +1,49 @@
+#ifndef USDT_PROBES_H
+#define USDT_PROBES_H
+
+// USDT (user-level statically defined tracing) probe points for the scaler
+// binaries, provider "scaling". With <sys/sdt.h> (systemtap-sdt-dev) each
+// probe compiles to a single nop plus an ELF note, so it costs nothing until
+// bpftrace or perf attaches to it; without the header the probes compile out.
+//
+//   bpftrace -e 'usdt:./bicubic-interpolation:scaling:scale_start { @t[arg1] = nsecs; }
+//                usdt:./bicubic-interpolation:scaling:scale_end /@t[arg1]/ {
+//                    @us[str(arg0)] = hist((nsecs - @t[arg1]) / 1000); delete(@t[arg1]); }'
+//
+// Probes and arguments:
+//   scale_start(kernel, iteration, src_w, src_h, dst_w, dst_h)
+//   scale_end(kernel, iteration, dst_w, dst_h)
+//   device_mmap(addr, length, offset)    after each successful mmap of the device
+//   buffer_write(addr, bytes, width, height)   scaled image copied to its destination
+//   file_write(path, bytes)              output image written to disk
+//
+// open-gl/src/frame-trace.h defines the player's "player" probes on top of this header.
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define USDT_PROBES_ENABLED 1
+#endif
+#endif
+
+#ifndef USDT_PROBES_ENABLED
+#define DTRACE_PROBE1(provider, name, a1) do { } while (0)
+#define DTRACE_PROBE2(provider, name, a1, a2) do { } while (0)
+#define DTRACE_PROBE3(provider, name, a1, a2, a3) do { } while (0)
+#define DTRACE_PROBE4(provider, name, a1, a2, a3, a4) do { } while (0)
+#define DTRACE_PROBE5(provider, name, a1, a2, a3, a4, a5) do { } while (0)
+#define DTRACE_PROBE6(provider, name, a1, a2, a3, a4, a5, a6) do { } while (0)
+#endif
+
+#define PROBE_SCALE_START(kernel, iteration, srcW, srcH, dstW, dstH) \
+    DTRACE_PROBE6(scaling, scale_start, kernel, iteration, srcW, srcH, dstW, dstH)
+#define PROBE_SCALE_END(kernel, iteration, dstW, dstH) \
+    DTRACE_PROBE4(scaling, scale_end, kernel, iteration, dstW, dstH)
+#define PROBE_DEVICE_MMAP(addr, length, offset) \
+    DTRACE_PROBE3(scaling, device_mmap, addr, length, offset)
+#define PROBE_BUFFER_WRITE(addr, bytes, width, height) \
+    DTRACE_PROBE4(scaling, buffer_write, addr, bytes, width, height)
+#define PROBE_FILE_WRITE(path, bytes) \
+    DTRACE_PROBE2(scaling, file_write, path, bytes)
+
+#endif // USDT_PROBES_H
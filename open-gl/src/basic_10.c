@@ -8,6 +8,11 @@
 #include <math.h>
 #include <time.h>  // For timing the scaling operations
 
+#include "../../multi-core/bench-results.h"
+#include "headless-egl.h"
+#include "texture-stream.h"
+#include "scale-readback.h"
+
 // X11 includes - add these for X11 support
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -21,6 +26,7 @@
 typedef enum {
     DISPLAY_WAYLAND,
     DISPLAY_X11,
+    DISPLAY_HEADLESS,  // No window: surfaceless/pbuffer EGL, see headless-egl.h
     DISPLAY_UNKNOWN
 } DisplayServerType;
 
@@ -53,6 +59,7 @@ GLuint program;
 GLuint vbo;
 GLuint framebuffer;  // For offscreen rendering
 GLuint output_texture;  // Texture to store the scaled result
+unsigned char* source_rgba;  // Source image, uploaded again for every batch frame
 
 // Shader sources
 const char *vertex_shader_source =
@@ -100,6 +107,11 @@ typedef struct {
 
 // Function to detect available display server
 DisplayServerType detect_display_server() {
+    if (headless_requested()) {
+        printf("Headless mode requested\n");
+        return DISPLAY_HEADLESS;
+    }
+
     // Try to connect to Wayland first
     struct wl_display *test_display = wl_display_connect(NULL);
     if (test_display) {
@@ -116,7 +128,7 @@ DisplayServerType detect_display_server() {
         return DISPLAY_X11;
     }
     
-    printf("No supported display server detected\n");
+    printf("No supported display server detected (HEADLESS=1 runs offscreen)\n");
     return DISPLAY_UNKNOWN;
 }
 
@@ -322,8 +334,9 @@ void init_texture() {
     // Load the image data
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img->width, img->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba_data);
     
-    // Free the image data
-    free(rgba_data);
+    // Keep the RGBA copy for the batch uploads
+    free(source_rgba);
+    source_rgba = rgba_data;
     free_image(img);
 }
 
@@ -478,6 +491,14 @@ void init_display() {
             init_egl_x11();
             break;
             
+        case DISPLAY_HEADLESS:
+            if (headless_egl_init(&egl_display, &egl_config, &egl_context, &egl_surface, WINDOW_WIDTH,
+                                  WINDOW_HEIGHT) < 0) {
+                fprintf(stderr, "Failed to initialize headless EGL\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+            
         default:
             fprintf(stderr, "No supported display server available\n");
             exit(EXIT_FAILURE);
@@ -505,12 +526,12 @@ void init_gl() {
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
 }
 
-// Function to perform a single scaling operation
-void perform_scaling() {
+// Function to perform a single scaling operation of source into target
+void perform_scaling(GLuint source, GLuint target) {
     // Generate a new random image for each iteration
 
     // Bind to framebuffer for offscreen rendering
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
     
     // Set viewport to target dimensions
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
@@ -537,7 +558,7 @@ void perform_scaling() {
     
     // Bind texture
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glBindTexture(GL_TEXTURE_2D, source);
     GLint tex_uniform = glGetUniformLocation(program, "texture");
     glUniform1i(tex_uniform, 0);
     
@@ -552,51 +573,59 @@ void perform_scaling() {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-// Function to perform 100 scaling operations and track performance
+// Scale SCALING_ITERATIONS frames as an offline job: upload, draw into an
+// FBO and read back asynchronously with several frames in flight
 void batch_scaling(const char* output_path) {
     printf("Starting batch scaling: %d iterations\n", SCALING_ITERATIONS);
-    
-    // Timing variables
-    clock_t start, end;
-    double cpu_time_used;
-    
-    // Start timing
-    start = clock();
-    
-    // Perform scaling multiple times
+
+    TextureStream source_stream;
+    ScaleReadback readback;
+    texture_stream_init(&source_stream, WINDOW_WIDTH, WINDOW_HEIGHT);
+    if (scale_readback_init(&readback, WINDOW_WIDTH, WINDOW_HEIGHT, SCALING_ITERATIONS) < 0) {
+        fprintf(stderr, "Failed to set up the readback ring\n");
+        scale_readback_free(&readback);
+        texture_stream_free(&source_stream);
+        return;
+    }
+
+    // Per-iteration wall time for bench-results: with frames in flight it is
+    // the steady-state cost of one frame, not the latency of any single one
+    double samples[SCALING_ITERATIONS];
+    struct timespec start, end, iteration_start, iteration_end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
     for (int i = 0; i < SCALING_ITERATIONS; i++) {
-        perform_scaling();
+        clock_gettime(CLOCK_MONOTONIC, &iteration_start);
+        GLuint target = scale_readback_begin(&readback);
+        GLuint source = texture_stream_upload(&source_stream, source_rgba);
+        perform_scaling(source, target);
+        texture_stream_fence(&source_stream);
+        scale_readback_end(&readback);
+        clock_gettime(CLOCK_MONOTONIC, &iteration_end);
+        samples[i] = (iteration_end.tv_sec - iteration_start.tv_sec) +
+                     (iteration_end.tv_nsec - iteration_start.tv_nsec) / 1e9;
     }
-    
-    // End timing
-    end = clock();
-    cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
-    printf("Batch scaling completed in %f seconds\n", cpu_time_used);
-    printf("Average time per operation: %f seconds\n", cpu_time_used / SCALING_ITERATIONS);
-    
-    // Read back the final scaled image
-    unsigned char* scaled_data = (unsigned char*)malloc(WINDOW_WIDTH * WINDOW_HEIGHT * 4);
-    if (!scaled_data) {
-        fprintf(stderr, "Failed to allocate memory for scaled image data\n");
-        return;
+    scale_readback_drain(&readback);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double wall_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    scale_readback_report(&readback, wall_time);
+    benchResultsWrite("gl-basic_10", "batch_scaling", WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_WIDTH, WINDOW_HEIGHT, 1,
+                      samples, SCALING_ITERATIONS);
+    if (readback.gen_queries) {
+        benchResultsWrite("gl-basic_10", "batch_scaling_gpu", WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_WIDTH, WINDOW_HEIGHT,
+                          1, readback.gpu_seconds + 1, SCALING_ITERATIONS - 1);
     }
-    
-    // Bind framebuffer to read from it
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    
-    // Read pixels
-    glReadPixels(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, scaled_data);
-    
-    // Unbind framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    
-    // Save the final scaled image
+
+    // Save the last scaled frame
     if (output_path) {
-        save_ppm(output_path, scaled_data, WINDOW_WIDTH, WINDOW_HEIGHT);
+        save_ppm(output_path, readback.output, WINDOW_WIDTH, WINDOW_HEIGHT);
     }
-    
-    // Free memory
-    free(scaled_data);
+    scale_readback_free(&readback);
+    texture_stream_free(&source_stream);
+
+    // Leave the result in output_texture for draw_frame
+    perform_scaling(texture_id, framebuffer);
 }
 
 void draw_frame() {
@@ -672,13 +701,16 @@ void run_event_loop() {
 void cleanup() {
     // Delete OpenGL resources
     glDeleteTextures(1, &texture_id);
+    free(source_rgba);
     glDeleteTextures(1, &output_texture);
     glDeleteFramebuffers(1, &framebuffer);
     glDeleteBuffers(1, &vbo);
     glDeleteProgram(program);
+    if (display_server_type == DISPLAY_HEADLESS) headless_egl_destroy();
     
     // Destroy EGL resources
-    eglDestroySurface(egl_display, egl_surface);
+    eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (egl_surface != EGL_NO_SURFACE) eglDestroySurface(egl_display, egl_surface);
     eglDestroyContext(egl_display, egl_context);
     eglTerminate(egl_display);
     
@@ -23,10 +23,10 @@
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
+#include "v4l2-capture.h"
 
 #define WINDOW_WIDTH  1920
 #define WINDOW_HEIGHT 1080
-#define BUFFER_COUNT 4  // Number of buffers for video processing
 
 // Enum to track which display server we're using
 typedef enum {
@@ -49,10 +49,9 @@ VideoSourceType video_source_type = VIDEO_SOURCE_NONE;
 
 // Video capture globals
 int video_fd = -1;
-struct v4l2_buffer v4l2_buffers[BUFFER_COUNT];
-void* buffer_start[BUFFER_COUNT];
-size_t buffer_length[BUFFER_COUNT];
-int current_buffer = 0;
+Capture capture;  // Camera buffers and the thread dequeuing them (CAPTURE_MEMORY, CAPTURE_BUFFERS)
+int current_buffer = -1;  // Buffer the render loop holds
+uint64_t frame_capture_ns = 0;  // Driver timestamp of the frame being drawn
 int frame_width = 0;
 int frame_height = 0;
 int video_format = 0;  // Will store V4L2 pixel format
@@ -226,7 +225,6 @@ unsigned char* convert_yuv_to_rgba(unsigned char* yuv_data, int width, int heigh
 int init_camera(const char* device) {
     struct v4l2_capability cap;
     struct v4l2_format fmt;
-    struct v4l2_requestbuffers req;
     
     // Open the video device
     video_fd = open(device, O_RDWR);
@@ -278,55 +276,9 @@ int init_camera(const char* device) {
            ((video_format >> 16) & 0xff),
            ((video_format >> 24) & 0xff));
     
-    // Request buffers
-    memset(&req, 0, sizeof(req));
-    req.count = BUFFER_COUNT;
-    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    req.memory = V4L2_MEMORY_MMAP;
-    
-    if (ioctl(video_fd, VIDIOC_REQBUFS, &req) < 0) {
-        perror("Failed to request buffers");
-        close(video_fd);
-        return -1;
-    }
-    
-    // Map buffers
-    for (int i = 0; i < BUFFER_COUNT; i++) {
-        struct v4l2_buffer buf;
-        memset(&buf, 0, sizeof(buf));
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-        buf.index = i;
-        
-        if (ioctl(video_fd, VIDIOC_QUERYBUF, &buf) < 0) {
-            perror("Failed to query buffer");
-            close(video_fd);
-            return -1;
-        }
-        
-        buffer_start[i] = mmap(NULL, buf.length, PROT_READ | PROT_WRITE,
-                              MAP_SHARED, video_fd, buf.m.offset);
-        buffer_length[i] = buf.length;
-        
-        if (buffer_start[i] == MAP_FAILED) {
-            perror("Failed to map buffer");
-            close(video_fd);
-            return -1;
-        }
-        
-        // Enqueue the buffer
-        if (ioctl(video_fd, VIDIOC_QBUF, &buf) < 0) {
-            perror("Failed to queue buffer");
-            close(video_fd);
-            return -1;
-        }
-    }
-    
-    // Start streaming
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    if (ioctl(video_fd, VIDIOC_STREAMON, &type) < 0) {
-        perror("Failed to start streaming");
+    if (capture_init(&capture, video_fd, &fmt) < 0) {
         close(video_fd);
+        video_fd = -1;
         return -1;
     }
     
@@ -502,38 +454,23 @@ int open_video_file(const char* filename) {
 
 // Function to get the next frame from camera
 int get_next_camera_frame(unsigned char** frame_ptr) {
-    struct v4l2_buffer buf;
-    memset(&buf, 0, sizeof(buf));
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf.memory = V4L2_MEMORY_MMAP;
-    
-    // Dequeue a buffer
-    if (ioctl(video_fd, VIDIOC_DQBUF, &buf) < 0) {
-        perror("Failed to dequeue buffer");
+    // Newest frame from the capture thread, held until release_camera_frame
+    current_buffer = capture_acquire(&capture);
+    if (current_buffer < 0) {
+        fprintf(stderr, "Camera capture stopped\n");
         return -1;
     }
     
-    // Store the buffer index
-    current_buffer = buf.index;
-    
-    // Set the frame pointer to the buffer data
-    *frame_ptr = buffer_start[current_buffer];
-    
-    return buffer_length[current_buffer];
+    frame_capture_ns = capture.buffers[current_buffer].capture_ns;
+    *frame_ptr = capture.buffers[current_buffer].start;
+    return capture.buffers[current_buffer].bytesused;
 }
 
 // Function to release the current camera frame
 void release_camera_frame() {
-    struct v4l2_buffer buf;
-    memset(&buf, 0, sizeof(buf));
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf.memory = V4L2_MEMORY_MMAP;
-    buf.index = current_buffer;
-    
-    // Enqueue the buffer back
-    if (ioctl(video_fd, VIDIOC_QBUF, &buf) < 0) {
-        perror("Failed to requeue buffer");
-    }
+    // Requeue right away so the driver can fill it again
+    capture_release(&capture, current_buffer);
+    current_buffer = -1;
 }
 
 // Function to get the next frame from an MP4 file
@@ -966,17 +903,7 @@ void cleanup_video_source() {
     switch (video_source_type) {
         case VIDEO_SOURCE_CAMERA:
             if (video_fd >= 0) {
-                enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-                // Stop streaming
-                ioctl(video_fd, VIDIOC_STREAMOFF, &type);
-
-                // Unmap buffers
-                for (int i = 0; i < BUFFER_COUNT; i++) {
-                    if (buffer_start[i]) {
-                        munmap(buffer_start[i], buffer_length[i]);
-                    }
-                }
-
+                capture_free(&capture);
                 close(video_fd);
                 video_fd = -1;
             }
@@ -1186,6 +1113,7 @@ void render_loop() {
                 // MJPEG decoding would need an additional library like libjpeg
                 // For simplicity, we'll skip this in this code
                 fprintf(stderr, "MJPEG format not supported in this example\n");
+                release_camera_frame();
                 continue;
             }
 
@@ -1247,14 +1175,19 @@ void render_loop() {
 
         // Swap buffers
         eglSwapBuffers(egl_display, egl_surface);
+        if (video_source_type == VIDEO_SOURCE_CAMERA) {
+            capture_record_latency(frame_capture_ns);
+        }
+        stats_count(COUNTER_FRAMES_RENDERED);
+        stats_poll(stats_now_ns() / 1e9);
 
         // Calculate frame time and potentially sleep to maintain a target FPS
         clock_gettime(CLOCK_MONOTONIC, &end_time);
         elapsed = (end_time.tv_sec - start_time.tv_sec) + 
             (end_time.tv_nsec - start_time.tv_nsec) / 1000000000.0;
 
-        // Target ~30 FPS
-        if (elapsed < 0.033) {
+        // Target ~30 FPS; a camera paces the loop itself, capture_acquire waits for the next frame
+        if (video_source_type != VIDEO_SOURCE_CAMERA && elapsed < 0.033) {
             usleep((0.033 - elapsed) * 1000000);
         }
     }
@@ -1266,6 +1199,7 @@ void render_loop() {
 }
 
 int main(int argc, char *argv[]) {
+    stats_init();
     // Parse command line arguments
     if (argc < 2) {
         fprintf(stderr, "Usage: %s <video_file.ppm|video_file.mp4|/dev/videoX>\n", argv[0]);
@@ -1353,6 +1287,9 @@ int main(int argc, char *argv[]) {
 
     // Main render loop
     render_loop();
+    if (video_source_type == VIDEO_SOURCE_CAMERA) {
+        stats_print_summary();
+    }
 
     // Cleanup
     cleanup_gl();
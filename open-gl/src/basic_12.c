@@ -19,10 +19,10 @@
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
+#include "v4l2-capture.h"
 
 #define WINDOW_WIDTH  1920
 #define WINDOW_HEIGHT 1080
-#define BUFFER_COUNT 4
 #define STRINGIFY(x) #x
 
 typedef enum {
@@ -42,10 +42,9 @@ DisplayServerType display_server_type = DISPLAY_UNKNOWN;
 VideoSourceType video_source_type = VIDEO_SOURCE_NONE;
 
 int video_fd = -1;
-struct v4l2_buffer v4l2_buffers[BUFFER_COUNT];
-void* buffer_start[BUFFER_COUNT];
-size_t buffer_length[BUFFER_COUNT];
-int current_buffer = 0;
+Capture capture;  // Camera buffers and the thread dequeuing them (CAPTURE_MEMORY, CAPTURE_BUFFERS)
+int current_buffer = -1;  // Buffer the render loop holds
+uint64_t frame_capture_ns = 0;  // Driver timestamp of the frame being drawn
 int frame_width = 0;
 int frame_height = 0;
 int video_format = 0;
@@ -183,7 +182,6 @@ unsigned char* convert_rgb_to_rgba(unsigned char* rgb_data, int width, int heigh
 int init_camera(const char* device) {
     struct v4l2_capability cap;
     struct v4l2_format fmt;
-    struct v4l2_requestbuffers req;
     
     video_fd = open(device, O_RDWR);
     if (video_fd < 0) {
@@ -230,51 +228,9 @@ int init_camera(const char* device) {
            ((video_format >> 16) & 0xff),
            ((video_format >> 24) & 0xff));
     
-    memset(&req, 0, sizeof(req));
-    req.count = BUFFER_COUNT;
-    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    req.memory = V4L2_MEMORY_MMAP;
-    
-    if (ioctl(video_fd, VIDIOC_REQBUFS, &req) < 0) {
-        perror("Failed to request buffers");
-        close(video_fd);
-        return -1;
-    }
-    
-    for (int i = 0; i < BUFFER_COUNT; i++) {
-        struct v4l2_buffer buf;
-        memset(&buf, 0, sizeof(buf));
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-        buf.index = i;
-        
-        if (ioctl(video_fd, VIDIOC_QUERYBUF, &buf) < 0) {
-            perror("Failed to query buffer");
-            close(video_fd);
-            return -1;
-        }
-        
-        buffer_start[i] = mmap(NULL, buf.length, PROT_READ | PROT_WRITE,
-                              MAP_SHARED, video_fd, buf.m.offset);
-        buffer_length[i] = buf.length;
-        
-        if (buffer_start[i] == MAP_FAILED) {
-            perror("Failed to map buffer");
-            close(video_fd);
-            return -1;
-        }
-        
-        if (ioctl(video_fd, VIDIOC_QBUF, &buf) < 0) {
-            perror("Failed to queue buffer");
-            close(video_fd);
-            return -1;
-        }
-    }
-    
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    if (ioctl(video_fd, VIDIOC_STREAMON, &type) < 0) {
-        perror("Failed to start streaming");
+    if (capture_init(&capture, video_fd, &fmt) < 0) {
         close(video_fd);
+        video_fd = -1;
         return -1;
     }
     
@@ -426,31 +382,20 @@ int open_video_file(const char* filename) {
 }
 
 int get_next_camera_frame(unsigned char** frame_ptr) {
-    struct v4l2_buffer buf;
-    memset(&buf, 0, sizeof(buf));
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf.memory = V4L2_MEMORY_MMAP;
-    
-    if (ioctl(video_fd, VIDIOC_DQBUF, &buf) < 0) {
-        perror("Failed to dequeue buffer");
+    current_buffer = capture_acquire(&capture);
+    if (current_buffer < 0) {
+        fprintf(stderr, "Camera capture stopped\n");
         return -1;
     }
     
-    current_buffer = buf.index;
-    *frame_ptr = buffer_start[current_buffer];
-    return buffer_length[current_buffer];
+    frame_capture_ns = capture.buffers[current_buffer].capture_ns;
+    *frame_ptr = capture.buffers[current_buffer].start;
+    return capture.buffers[current_buffer].bytesused;
 }
 
 void release_camera_frame() {
-    struct v4l2_buffer buf;
-    memset(&buf, 0, sizeof(buf));
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf.memory = V4L2_MEMORY_MMAP;
-    buf.index = current_buffer;
-    
-    if (ioctl(video_fd, VIDIOC_QBUF, &buf) < 0) {
-        perror("Failed to requeue buffer");
-    }
+    capture_release(&capture, current_buffer);
+    current_buffer = -1;
 }
 
 int get_next_mp4_frame(unsigned char** frame_ptr) {
@@ -818,13 +763,7 @@ void cleanup_video_source() {
     switch (video_source_type) {
         case VIDEO_SOURCE_CAMERA:
             if (video_fd >= 0) {
-                enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-                ioctl(video_fd, VIDIOC_STREAMOFF, &type);
-                for (int i = 0; i < BUFFER_COUNT; i++) {
-                    if (buffer_start[i]) {
-                        munmap(buffer_start[i], buffer_length[i]);
-                    }
-                }
+                capture_free(&capture);
                 close(video_fd);
                 video_fd = -1;
             }
@@ -1010,17 +949,24 @@ void render_loop() {
         glDisableVertexAttribArray(tex_attrib);
 
         eglSwapBuffers(egl_display, egl_surface);
+        if (video_source_type == VIDEO_SOURCE_CAMERA) {
+            capture_record_latency(frame_capture_ns);
+        }
+        stats_count(COUNTER_FRAMES_RENDERED);
+        stats_poll(stats_now_ns() / 1e9);
 
         clock_gettime(CLOCK_MONOTONIC, &end_time);
         elapsed = (end_time.tv_sec - start_time.tv_sec) + 
                   (end_time.tv_nsec - start_time.tv_nsec) / 1000000000.0;
-        if (elapsed < 0.033) {
+        // A camera paces the loop itself: capture_acquire waits for the next frame
+        if (video_source_type != VIDEO_SOURCE_CAMERA && elapsed < 0.033) {
             usleep((0.033 - elapsed) * 1000000);
         }
     }
 }
 
 int main(int argc, char *argv[]) {
+    stats_init();
     if (argc < 2) {
         fprintf(stderr, "Usage: %s <video_file.ppm|video_file.mp4|/dev/videoX>\n", argv[0]);
         return EXIT_FAILURE;
@@ -1090,6 +1036,9 @@ int main(int argc, char *argv[]) {
     init_video_texture();
 
     render_loop();
+    if (video_source_type == VIDEO_SOURCE_CAMERA) {
+        stats_print_summary();
+    }
 
     cleanup_gl();
     cleanup_video_source();
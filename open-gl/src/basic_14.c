@@ -15,17 +15,21 @@
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <EGL/eglplatform.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2ext.h>
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
 #include "xdg-shell-client-protocol.h"
+#include "texture-stream.h"
+#include "v4l2-capture.h"
 
 #define WINDOW_WIDTH  1920
 #define WINDOW_HEIGHT 1080
-#define BUFFER_COUNT  4
 #define FRAME_BUFFER_SIZE 10
 #define STRINGIFY(x) #x
+#define DRM_FORMAT_ABGR8888 0x34324241  // fourcc AB24 from drm_fourcc.h: R, G, B, A bytes in memory
 
 typedef enum {
     DISPLAY_WAYLAND,
@@ -44,10 +48,9 @@ DisplayServerType display_server_type = DISPLAY_UNKNOWN;
 VideoSourceType video_source_type = VIDEO_SOURCE_NONE;
 
 int video_fd = -1;
-struct v4l2_buffer v4l2_buffers[BUFFER_COUNT];
-void* buffer_start[BUFFER_COUNT];
-size_t buffer_length[BUFFER_COUNT];
-int current_buffer = 0;
+Capture capture;  // Camera buffers and the thread dequeuing them (CAPTURE_MEMORY, CAPTURE_BUFFERS)
+int current_buffer = -1;  // Buffer the render loop holds
+uint64_t frame_capture_ns = 0;  // Driver timestamp of the frame being drawn
 int frame_width = 0;
 int frame_height = 0;
 int video_format = 0;
@@ -84,13 +87,27 @@ EGLContext egl_context;
 EGLSurface egl_surface;
 EGLConfig egl_config;
 
-GLuint texture_id;
+TextureStream video_stream;
 GLuint program;
 GLuint vbo;
 GLuint framebuffer;
 GLuint output_texture;
 int running = 1;
 
+// CAPTURE_MEMORY=dmabuf: each camera buffer is imported once as an EGLImage
+// and sampled where the driver wrote it, so frames are never uploaded
+int dmabuf_import = 0;
+GLuint dmabuf_textures[CAPTURE_MAX_BUFFERS];
+EGLImageKHR dmabuf_images[CAPTURE_MAX_BUFFERS];
+int held_buffer = -1;  // Drawn last frame, requeued once its fence has passed
+EGLSyncKHR held_fence = EGL_NO_SYNC_KHR;
+PFNEGLCREATEIMAGEKHRPROC create_image;
+PFNEGLDESTROYIMAGEKHRPROC destroy_image;
+PFNGLEGLIMAGETARGETTEXTURE2DOESPROC image_target_texture;
+PFNEGLCREATESYNCKHRPROC create_sync;
+PFNEGLCLIENTWAITSYNCKHRPROC client_wait_sync;
+PFNEGLDESTROYSYNCKHRPROC destroy_sync;
+
 const char *vertex_shader_source =
     "attribute vec3 position;\n"
     "attribute vec2 texcoord;\n"
@@ -163,6 +180,9 @@ GLuint compile_shader(GLenum type, const char *source);
 GLuint init_shaders();
 void init_framebuffer();
 void init_video_texture();
+void init_dmabuf_textures();
+void release_dmabuf_frame();
+void cleanup_dmabuf_textures();
 void init_geometry();
 int init_wayland();
 int init_x11();
@@ -227,7 +247,6 @@ unsigned char* convert_rgb_to_rgba(unsigned char* rgb_data, int width, int heigh
 int init_camera(const char* device) {
     struct v4l2_capability cap;
     struct v4l2_format fmt;
-    struct v4l2_requestbuffers req;
     
     video_fd = open(device, O_RDWR);
     if (video_fd < 0) {
@@ -274,51 +293,9 @@ int init_camera(const char* device) {
            ((video_format >> 16) & 0xff),
            ((video_format >> 24) & 0xff));
     
-    memset(&req, 0, sizeof(req));
-    req.count = BUFFER_COUNT;
-    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    req.memory = V4L2_MEMORY_MMAP;
-    
-    if (ioctl(video_fd, VIDIOC_REQBUFS, &req) < 0) {
-        perror("Failed to request buffers");
-        close(video_fd);
-        return -1;
-    }
-    
-    for (int i = 0; i < BUFFER_COUNT; i++) {
-        struct v4l2_buffer buf;
-        memset(&buf, 0, sizeof(buf));
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-        buf.index = i;
-        
-        if (ioctl(video_fd, VIDIOC_QUERYBUF, &buf) < 0) {
-            perror("Failed to query buffer");
-            close(video_fd);
-            return -1;
-        }
-        
-        buffer_start[i] = mmap(NULL, buf.length, PROT_READ | PROT_WRITE,
-                              MAP_SHARED, video_fd, buf.m.offset);
-        buffer_length[i] = buf.length;
-        
-        if (buffer_start[i] == MAP_FAILED) {
-            perror("Failed to map buffer");
-            close(video_fd);
-            return -1;
-        }
-        
-        if (ioctl(video_fd, VIDIOC_QBUF, &buf) < 0) {
-            perror("Failed to queue buffer");
-            close(video_fd);
-            return -1;
-        }
-    }
-    
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    if (ioctl(video_fd, VIDIOC_STREAMON, &type) < 0) {
-        perror("Failed to start streaming");
+    if (capture_init(&capture, video_fd, &fmt) < 0) {
         close(video_fd);
+        video_fd = -1;
         return -1;
     }
     
@@ -482,31 +459,20 @@ int open_video_file(const char* filename) {
 
 // Camera frame handling (unchanged)
 int get_next_camera_frame(unsigned char** frame_ptr) {
-    struct v4l2_buffer buf;
-    memset(&buf, 0, sizeof(buf));
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf.memory = V4L2_MEMORY_MMAP;
-    
-    if (ioctl(video_fd, VIDIOC_DQBUF, &buf) < 0) {
-        perror("Failed to dequeue buffer");
+    current_buffer = capture_acquire(&capture);
+    if (current_buffer < 0) {
+        fprintf(stderr, "Camera capture stopped\n");
         return -1;
     }
     
-    current_buffer = buf.index;
-    *frame_ptr = buffer_start[current_buffer];
-    return buffer_length[current_buffer];
+    frame_capture_ns = capture.buffers[current_buffer].capture_ns;
+    *frame_ptr = capture.buffers[current_buffer].start;
+    return capture.buffers[current_buffer].bytesused;
 }
 
 void release_camera_frame() {
-    struct v4l2_buffer buf;
-    memset(&buf, 0, sizeof(buf));
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf.memory = V4L2_MEMORY_MMAP;
-    buf.index = current_buffer;
-    
-    if (ioctl(video_fd, VIDIOC_QBUF, &buf) < 0) {
-        perror("Failed to requeue buffer");
-    }
+    capture_release(&capture, current_buffer);
+    current_buffer = -1;
 }
 
 // MP4 frame handling (unchanged)
@@ -709,18 +675,106 @@ void init_framebuffer() {
 
 // Video texture initialization (unchanged)
 void init_video_texture() {
-    glGenTextures(1, &texture_id);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    
+    // YUYV camera frames go up as RGBA texels holding two pixels each
     if (video_source_type == VIDEO_SOURCE_CAMERA && video_format == V4L2_PIX_FMT_YUYV) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frame_width / 2, frame_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        texture_stream_init(&video_stream, frame_width / 2, frame_height);
     } else {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frame_width, frame_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        texture_stream_init(&video_stream, frame_width, frame_height);
+    }
+}
+
+// Import the exported camera buffers (CAPTURE_MEMORY=dmabuf); YUYV is viewed
+// as RGBA texels holding two pixels each, the same layout the upload path uses
+void init_dmabuf_textures() {
+    if (video_source_type != VIDEO_SOURCE_CAMERA || capture.memory != CAPTURE_DMABUF ||
+        video_format != V4L2_PIX_FMT_YUYV) {
+        return;
+    }
+
+    const char* extensions = eglQueryString(egl_display, EGL_EXTENSIONS);
+    if (!extensions || !strstr(extensions, "EGL_EXT_image_dma_buf_import") ||
+        !strstr(extensions, "EGL_KHR_fence_sync")) {
+        printf("EGL cannot import DMABUF, uploading camera frames instead\n");
+        return;
+    }
+    create_image = (PFNEGLCREATEIMAGEKHRPROC)eglGetProcAddress("eglCreateImageKHR");
+    destroy_image = (PFNEGLDESTROYIMAGEKHRPROC)eglGetProcAddress("eglDestroyImageKHR");
+    image_target_texture = (PFNGLEGLIMAGETARGETTEXTURE2DOESPROC)eglGetProcAddress("glEGLImageTargetTexture2DOES");
+    create_sync = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+    client_wait_sync = (PFNEGLCLIENTWAITSYNCKHRPROC)eglGetProcAddress("eglClientWaitSyncKHR");
+    destroy_sync = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+    if (!create_image || !destroy_image || !image_target_texture || !create_sync || !client_wait_sync ||
+        !destroy_sync) {
+        printf("EGL cannot import DMABUF, uploading camera frames instead\n");
+        return;
+    }
+
+    glGenTextures(capture.count, dmabuf_textures);
+    for (int i = 0; i < capture.count; i++) {
+        EGLint attribs[] = {
+            EGL_WIDTH, frame_width / 2,
+            EGL_HEIGHT, frame_height,
+            EGL_LINUX_DRM_FOURCC_EXT, DRM_FORMAT_ABGR8888,
+            EGL_DMA_BUF_PLANE0_FD_EXT, capture.buffers[i].dmabuf_fd,
+            EGL_DMA_BUF_PLANE0_OFFSET_EXT, 0,
+            EGL_DMA_BUF_PLANE0_PITCH_EXT, capture.stride,
+            EGL_NONE
+        };
+        dmabuf_images[i] = create_image(egl_display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, NULL, attribs);
+        if (dmabuf_images[i] == EGL_NO_IMAGE_KHR) {
+            fprintf(stderr, "Failed to import camera buffer %d, uploading camera frames instead\n", i);
+            cleanup_dmabuf_textures();
+            return;
+        }
+        glBindTexture(GL_TEXTURE_2D, dmabuf_textures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        image_target_texture(GL_TEXTURE_2D, (GLeglImageOES)dmabuf_images[i]);
+    }
+    dmabuf_import = 1;
+    printf("Camera buffers imported as %d DMABUF textures\n", capture.count);
+}
+
+// Call after the draw: requeue last frame's buffer once the GPU is done with
+// it and hold on to this one, so the driver never overwrites a frame in flight
+void release_dmabuf_frame() {
+    if (held_buffer >= 0) {
+        if (held_fence != EGL_NO_SYNC_KHR) {
+            client_wait_sync(egl_display, held_fence, EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, EGL_FOREVER_KHR);
+            destroy_sync(egl_display, held_fence);
+        } else {
+            glFinish();
+        }
+        capture_release(&capture, held_buffer);
+    }
+    held_fence = create_sync(egl_display, EGL_SYNC_FENCE_KHR, NULL);
+    held_buffer = current_buffer;
+    current_buffer = -1;
+}
+
+void cleanup_dmabuf_textures() {
+    if (held_fence != EGL_NO_SYNC_KHR) {
+        destroy_sync(egl_display, held_fence);
+        held_fence = EGL_NO_SYNC_KHR;
+    }
+    if (held_buffer >= 0) {
+        glFinish();
+        capture_release(&capture, held_buffer);
+        held_buffer = -1;
+    }
+    for (int i = 0; i < capture.count; i++) {
+        if (dmabuf_images[i] != EGL_NO_IMAGE_KHR) {
+            destroy_image(egl_display, dmabuf_images[i]);
+            dmabuf_images[i] = EGL_NO_IMAGE_KHR;
+        }
     }
+    if (dmabuf_textures[0]) {
+        glDeleteTextures(capture.count, dmabuf_textures);
+        memset(dmabuf_textures, 0, sizeof(dmabuf_textures));
+    }
+    dmabuf_import = 0;
 }
 
 // Geometry initialization (unchanged)
@@ -925,13 +979,7 @@ void cleanup_video_source() {
     switch (video_source_type) {
         case VIDEO_SOURCE_CAMERA:
             if (video_fd >= 0) {
-                enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-                ioctl(video_fd, VIDIOC_STREAMOFF, &type);
-                for (int i = 0; i < BUFFER_COUNT; i++) {
-                    if (buffer_start[i]) {
-                        munmap(buffer_start[i], buffer_length[i]);
-                    }
-                }
+                capture_free(&capture);
                 close(video_fd);
                 video_fd = -1;
             }
@@ -1037,9 +1085,8 @@ void cleanup_display() {
 
 // GL cleanup (unchanged)
 void cleanup_gl() {
-    if (texture_id) {
-        glDeleteTextures(1, &texture_id);
-    }
+    cleanup_dmabuf_textures();
+    texture_stream_free(&video_stream);
     if (output_texture) {
         glDeleteTextures(1, &output_texture);
     }
@@ -1090,23 +1137,27 @@ void render_loop() {
         }
 
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture_id);
 
         if (video_source_type == VIDEO_SOURCE_CAMERA) {
-            if (video_format == V4L2_PIX_FMT_YUYV) {
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frame_width / 2, frame_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, frame);
+            if (dmabuf_import) {
+                // Requeued after the draw, by release_dmabuf_frame
+                glBindTexture(GL_TEXTURE_2D, dmabuf_textures[current_buffer]);
+            } else if (video_format == V4L2_PIX_FMT_YUYV) {
+                texture_stream_upload(&video_stream, frame);
             } else if (video_format == V4L2_PIX_FMT_MJPEG) {
                 fprintf(stderr, "MJPEG format not supported in this example\n");
                 release_camera_frame();
                 continue;
             }
-            release_camera_frame();
+            if (!dmabuf_import) {
+                release_camera_frame();
+            }
         } else if (video_source_type == VIDEO_SOURCE_FILE) {
             unsigned char* rgba_data = convert_rgb_to_rgba(frame, frame_width, frame_height);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frame_width, frame_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba_data);
+            texture_stream_upload(&video_stream, rgba_data);
             free(rgba_data);
         } else if (video_source_type == VIDEO_SOURCE_MP4) {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frame_width, frame_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, frame);
+            texture_stream_upload(&video_stream, frame);
             if (frame_buffer_count < FRAME_BUFFER_SIZE) {
                 unsigned char* next_frame;
                 int next_size = get_next_mp4_frame(&next_frame);
@@ -1141,13 +1192,23 @@ void render_loop() {
 
         glDisableVertexAttribArray(pos_attrib);
         glDisableVertexAttribArray(tex_attrib);
+        texture_stream_fence(&video_stream);
+        if (dmabuf_import) {
+            release_dmabuf_frame();
+        }
 
         eglSwapBuffers(egl_display, egl_surface);
+        if (video_source_type == VIDEO_SOURCE_CAMERA) {
+            capture_record_latency(frame_capture_ns);
+        }
+        stats_count(COUNTER_FRAMES_RENDERED);
+        stats_poll(stats_now_ns() / 1e9);
 
         clock_gettime(CLOCK_MONOTONIC, &end_time);
         elapsed = (end_time.tv_sec - start_time.tv_sec) + 
                   (end_time.tv_nsec - start_time.tv_nsec) / 1000000000.0;
-        if (elapsed < frame_duration) {
+        // A camera paces the loop itself: capture_acquire waits for the next frame
+        if (video_source_type != VIDEO_SOURCE_CAMERA && elapsed < frame_duration) {
             usleep((frame_duration - elapsed) * 1000000);
         }
     }
@@ -1155,6 +1216,7 @@ void render_loop() {
 
 // Main function (unchanged)
 int main(int argc, char *argv[]) {
+    stats_init();
     if (argc < 2) {
         fprintf(stderr, "Usage: %s <video_file.ppm|video_file.mp4|/dev/videoX>\n", argv[0]);
         return EXIT_FAILURE;
@@ -1222,8 +1284,12 @@ int main(int argc, char *argv[]) {
     init_geometry();
     init_framebuffer();
     init_video_texture();
+    init_dmabuf_textures();
 
     render_loop();
+    if (video_source_type == VIDEO_SOURCE_CAMERA) {
+        stats_print_summary();
+    }
 
     cleanup_gl();
     cleanup_video_source();
@@ -8,6 +8,11 @@
 #include <math.h>
 #include <time.h>  // For timing the scaling operations
 
+#include "../../multi-core/bench-results.h"
+#include "headless-egl.h"
+#include "texture-stream.h"
+#include "scale-readback.h"
+
 #define WINDOW_WIDTH  1920  // Set your desired width
 #define WINDOW_HEIGHT 1080  // Set your desired height
 #define SCALING_ITERATIONS 100  // Number of times to perform scaling
@@ -29,6 +34,8 @@ GLuint program;
 GLuint vbo;
 GLuint framebuffer;  // For offscreen rendering
 GLuint output_texture;  // Texture to store the scaled result
+unsigned char* source_rgba;  // Source image, uploaded again for every batch frame
+int source_width = 0, source_height = 0;  // Loaded image size
 
 // Shader sources
 const char *vertex_shader_source =
@@ -300,6 +307,8 @@ void init_texture(const char* image_path) {
     }
     
     printf("Loaded image: %dx%d with %d channels\n", img->width, img->height, img->channels);
+    source_width = img->width;
+    source_height = img->height;
     
     // Convert to RGBA if needed
     unsigned char* rgba_data = convert_rgb_to_rgba(img);
@@ -322,8 +331,9 @@ void init_texture(const char* image_path) {
     // Load the image data
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img->width, img->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba_data);
     
-    // Free the image data
-    free(rgba_data);
+    // Keep the RGBA copy for the batch uploads
+    free(source_rgba);
+    source_rgba = rgba_data;
     free_image(img);
 }
 
@@ -406,10 +416,10 @@ void init_gl(const char* image_path) {
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
 }
 
-// Function to perform a single scaling operation
-void perform_scaling() {
+// Function to perform a single scaling operation of source into target
+void perform_scaling(GLuint source, GLuint target) {
     // Bind to framebuffer for offscreen rendering
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
     
     // Set viewport to target dimensions
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
@@ -436,7 +446,7 @@ void perform_scaling() {
     
     // Bind texture
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glBindTexture(GL_TEXTURE_2D, source);
     GLint tex_uniform = glGetUniformLocation(program, "texture");
     glUniform1i(tex_uniform, 0);
     
@@ -451,56 +461,62 @@ void perform_scaling() {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-// Function to perform 100 scaling operations and track performance
+// Scale SCALING_ITERATIONS frames as an offline job: upload, draw into an
+// FBO and read back asynchronously with several frames in flight
 void batch_scaling(const char* output_path) {
     printf("Starting batch scaling: %d iterations\n", SCALING_ITERATIONS);
-    
-    // Timing variables
-    clock_t start, end;
-    double cpu_time_used;
-    
-    // Start timing
-    start = clock();
-    
-    // Perform scaling multiple times
+
+    TextureStream source_stream;
+    ScaleReadback readback;
+    texture_stream_init(&source_stream, source_width, source_height);
+    if (scale_readback_init(&readback, WINDOW_WIDTH, WINDOW_HEIGHT, SCALING_ITERATIONS) < 0) {
+        fprintf(stderr, "Failed to set up the readback ring\n");
+        scale_readback_free(&readback);
+        texture_stream_free(&source_stream);
+        return;
+    }
+
+    // Per-iteration wall time for bench-results: with frames in flight it is
+    // the steady-state cost of one frame, not the latency of any single one
+    double samples[SCALING_ITERATIONS];
+    struct timespec start, end, iteration_start, iteration_end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
     for (int i = 0; i < SCALING_ITERATIONS; i++) {
-        perform_scaling();
-        
-        // Print progress every 10 iterations
+        clock_gettime(CLOCK_MONOTONIC, &iteration_start);
+        GLuint target = scale_readback_begin(&readback);
+        GLuint source = texture_stream_upload(&source_stream, source_rgba);
+        perform_scaling(source, target);
+        texture_stream_fence(&source_stream);
+        scale_readback_end(&readback);
+        clock_gettime(CLOCK_MONOTONIC, &iteration_end);
+        samples[i] = (iteration_end.tv_sec - iteration_start.tv_sec) +
+                     (iteration_end.tv_nsec - iteration_start.tv_nsec) / 1e9;
         if (i % 10 == 0) {
             printf("Completed scaling iteration %d/%d\n", i, SCALING_ITERATIONS);
         }
     }
-    
-    // End timing
-    end = clock();
-    cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
-    printf("Batch scaling completed in %f seconds\n", cpu_time_used);
-    printf("Average time per operation: %f seconds\n", cpu_time_used / SCALING_ITERATIONS);
-    
-    // Read back the final scaled image
-    unsigned char* scaled_data = (unsigned char*)malloc(WINDOW_WIDTH * WINDOW_HEIGHT * 4);
-    if (!scaled_data) {
-        fprintf(stderr, "Failed to allocate memory for scaled image data\n");
-        return;
+    scale_readback_drain(&readback);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double wall_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    scale_readback_report(&readback, wall_time);
+    benchResultsWrite("gl-basic_8", "batch_scaling", source_width, source_height, WINDOW_WIDTH, WINDOW_HEIGHT, 1,
+                      samples, SCALING_ITERATIONS);
+    if (readback.gen_queries) {
+        benchResultsWrite("gl-basic_8", "batch_scaling_gpu", source_width, source_height, WINDOW_WIDTH, WINDOW_HEIGHT,
+                          1, readback.gpu_seconds + 1, SCALING_ITERATIONS - 1);
     }
-    
-    // Bind framebuffer to read from it
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    
-    // Read pixels
-    glReadPixels(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, scaled_data);
-    
-    // Unbind framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    
-    // Save the final scaled image
+
+    // Save the last scaled frame
     if (output_path) {
-        save_ppm(output_path, scaled_data, WINDOW_WIDTH, WINDOW_HEIGHT);
+        save_ppm(output_path, readback.output, WINDOW_WIDTH, WINDOW_HEIGHT);
     }
-    
-    // Free memory
-    free(scaled_data);
+    scale_readback_free(&readback);
+    texture_stream_free(&source_stream);
+
+    // Leave the result in output_texture for draw_frame
+    perform_scaling(texture_id, framebuffer);
 }
 
 void draw_frame() {
@@ -544,15 +560,19 @@ void draw_frame() {
 void cleanup() {
     // Delete OpenGL resources
     glDeleteTextures(1, &texture_id);
+    free(source_rgba);
     glDeleteTextures(1, &output_texture);
     glDeleteFramebuffers(1, &framebuffer);
     glDeleteBuffers(1, &vbo);
     glDeleteProgram(program);
+    headless_egl_destroy();
     
     // Destroy EGL resources
-    eglDestroySurface(egl_display, egl_surface);
+    eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (egl_surface != EGL_NO_SURFACE) eglDestroySurface(egl_display, egl_surface);
     eglDestroyContext(egl_display, egl_context);
     eglTerminate(egl_display);
+    if (!display) return;  // Headless run
     
     // Destroy Wayland resources
     wl_egl_window_destroy(egl_window);
@@ -572,12 +592,26 @@ int main(int argc, char** argv) {
     const char* image_path = argv[1];
     const char* output_path = (argc > 2) ? argv[2] : "scaled_output.ppm";
     
-    init_wayland();
-    init_egl();
+    // HEADLESS=1 scales offscreen and exits, for hosts without a compositor
+    int headless_run = headless_requested();
+    if (headless_run) {
+        EGLConfig config;
+        if (headless_egl_init(&egl_display, &config, &egl_context, &egl_surface, WINDOW_WIDTH, WINDOW_HEIGHT) < 0) {
+            fprintf(stderr, "Failed to initialize headless EGL\n");
+            return EXIT_FAILURE;
+        }
+    } else {
+        init_wayland();
+        init_egl();
+    }
     init_gl(image_path);
     
     // Perform batch scaling
     batch_scaling(output_path);
+    if (headless_run) {
+        cleanup();
+        return 0;
+    }
     
     // Display the result and handle events
     printf("Scaling completed. Displaying result. Press Ctrl+C to exit.\n");
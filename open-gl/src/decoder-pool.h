@@ -0,0 +1,80 @@
+#ifndef DECODER_POOL_H
+#define DECODER_POOL_H
+
+// Pooled picture allocator for libavcodec decoders (AVCodecContext.get_buffer2).
+//
+// Every picture the decoder outputs lives in one buffer taken from an
+// AVBufferPool, with each plane and each row aligned to DECODER_POOL_ALIGN.
+// A buffer goes back to the pool when its last reference drops, so the
+// players can queue av_frame_ref'd decoder frames and read them in place:
+// once the pool has grown to cover the decoder's reference frames plus the
+// queue, decoding allocates nothing. A resolution change simply starts a new
+// pool; buffers of the old one are freed as their frames are released.
+//
+// get_buffer2 may be called from the decoder's frame threads, so replacing
+// the pool is done under a lock (taking a buffer from it is thread-safe).
+
+#include <stdint.h>
+#include <pthread.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+
+#define DECODER_POOL_ALIGN 64  // Plane and row alignment, enough for AVX-512 loads
+#define DECODER_POOL_PADDING 64  // Slack past the last plane for SIMD over-reads
+
+static AVBufferPool* decoder_pool = NULL;
+static int decoder_pool_size = 0;
+static pthread_mutex_t decoder_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int decoder_pool_get_buffer2(AVCodecContext* ctx, AVFrame* frame, int flags) {
+    if (!(ctx->codec->capabilities & AV_CODEC_CAP_DR1))
+        return avcodec_default_get_buffer2(ctx, frame, flags);
+
+    // Decoders write past the visible picture up to their macroblock padding
+    int width = frame->width, height = frame->height;
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(ctx, &width, &height, linesize_align);
+
+    int linesize[4];
+    if (av_image_fill_linesizes(linesize, frame->format, width) < 0)
+        return avcodec_default_get_buffer2(ctx, frame, flags);
+    for (int i = 0; i < 4; i++)
+        linesize[i] = (linesize[i] + DECODER_POOL_ALIGN - 1) & ~(DECODER_POOL_ALIGN - 1);
+
+    uint8_t* planes[4];
+    int size = av_image_fill_pointers(planes, frame->format, height, NULL, linesize);
+    if (size < 0) return size;
+    size += DECODER_POOL_ALIGN + DECODER_POOL_PADDING;  // Room to align the base pointer
+
+    pthread_mutex_lock(&decoder_pool_lock);
+    if (decoder_pool_size != size) {
+        av_buffer_pool_uninit(&decoder_pool);
+        decoder_pool = av_buffer_pool_init(size, NULL);
+        decoder_pool_size = decoder_pool ? size : 0;
+    }
+    frame->buf[0] = decoder_pool ? av_buffer_pool_get(decoder_pool) : NULL;
+    pthread_mutex_unlock(&decoder_pool_lock);
+    if (!frame->buf[0]) return AVERROR(ENOMEM);
+
+    uintptr_t base = ((uintptr_t)frame->buf[0]->data + DECODER_POOL_ALIGN - 1) & ~(uintptr_t)(DECODER_POOL_ALIGN - 1);
+    av_image_fill_pointers(frame->data, frame->format, height, (uint8_t*)base, linesize);
+    for (int i = 0; i < 4; i++) frame->linesize[i] = linesize[i];
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+// Install the allocator; call before avcodec_open2
+static void decoder_pool_attach(AVCodecContext* ctx) {
+    ctx->get_buffer2 = decoder_pool_get_buffer2;
+}
+
+// Drop the pool once the decoder is closed; buffers still referenced by
+// queued frames stay valid and are freed when those frames are unreferenced
+static void decoder_pool_release(void) {
+    pthread_mutex_lock(&decoder_pool_lock);
+    av_buffer_pool_uninit(&decoder_pool);
+    decoder_pool_size = 0;
+    pthread_mutex_unlock(&decoder_pool_lock);
+}
+
+#endif // DECODER_POOL_H
@@ -0,0 +1,174 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+// Lock-free single-producer / single-consumer ring of slot indices for the
+// decoded-frame queue. The players keep their own frame_buffer[] array; this
+// only decides which slot each side may touch.
+//
+// head is written only by the consumer, tail only by the producer, each on
+// its own cache line and published with release/acquire ordering, so the fast
+// path on either side is a couple of loads and one store, with no lock and
+// no syscall. A side blocks (futex) only when the ring is empty or full; it
+// first announces itself in a waiting flag, and the other side issues a wake
+// only when it sees that flag, so a non-blocked queue never enters the kernel.
+
+#include <stdint.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define FRAME_RING_CACHE_LINE 64
+#define FRAME_RING_SPIN 64  // Polls before falling back to a futex wait
+
+typedef struct {
+    _Alignas(FRAME_RING_CACHE_LINE) atomic_uint head;  // Next slot to read, consumer-owned
+    _Alignas(FRAME_RING_CACHE_LINE) atomic_uint tail;  // Next slot to write, producer-owned
+    _Alignas(FRAME_RING_CACHE_LINE) atomic_uint items_event;  // Futex: bumped to wake the consumer
+    atomic_int consumer_waiting;
+    _Alignas(FRAME_RING_CACHE_LINE) atomic_uint space_event;  // Futex: bumped to wake the producer
+    atomic_int producer_waiting;
+    _Alignas(FRAME_RING_CACHE_LINE) atomic_int closed;  // Producer finished, drain then stop
+    atomic_int stopped;  // Shut down, both sides return immediately
+    unsigned int capacity;  // Power of two
+} FrameRing;
+
+static inline void frame_ring_futex_wait(atomic_uint* word, unsigned int expected) {
+    syscall(SYS_futex, (unsigned int*)word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static inline void frame_ring_futex_wake(atomic_uint* word) {
+    syscall(SYS_futex, (unsigned int*)word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+static inline void frame_ring_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static void frame_ring_init(FrameRing* ring, unsigned int capacity) {
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->items_event, 0);
+    atomic_init(&ring->consumer_waiting, 0);
+    atomic_init(&ring->space_event, 0);
+    atomic_init(&ring->producer_waiting, 0);
+    atomic_init(&ring->closed, 0);
+    atomic_init(&ring->stopped, 0);
+    ring->capacity = capacity;
+}
+
+// Wake the other side if (and only if) it announced it is about to sleep
+static inline void frame_ring_signal(atomic_uint* event, atomic_int* waiting) {
+    atomic_thread_fence(memory_order_seq_cst);  // Order our index store before reading the flag
+    if (atomic_load_explicit(waiting, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(event, 1, memory_order_release);
+        frame_ring_futex_wake(event);
+    }
+}
+
+// Frames currently queued (exact on either owning thread, approximate elsewhere)
+static inline unsigned int frame_ring_count(FrameRing* ring) {
+    return atomic_load_explicit(&ring->tail, memory_order_acquire) -
+           atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+// Producer: wait for a free slot and return its index (not yet published),
+// or -1 once the ring is stopped
+static int frame_ring_reserve(FrameRing* ring) {
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    for (int spin = 0;; spin++) {
+        if (atomic_load_explicit(&ring->stopped, memory_order_acquire)) return -1;
+        if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) < ring->capacity)
+            return (int)(tail & (ring->capacity - 1));
+        if (spin < FRAME_RING_SPIN) {
+            frame_ring_cpu_relax();
+            continue;
+        }
+
+        atomic_store_explicit(&ring->producer_waiting, 1, memory_order_seq_cst);
+        unsigned int event = atomic_load_explicit(&ring->space_event, memory_order_acquire);
+        if (!atomic_load_explicit(&ring->stopped, memory_order_seq_cst) &&
+            tail - atomic_load_explicit(&ring->head, memory_order_seq_cst) >= ring->capacity) {
+            frame_ring_futex_wait(&ring->space_event, event);
+        }
+        atomic_store_explicit(&ring->producer_waiting, 0, memory_order_relaxed);
+        spin = 0;
+    }
+}
+
+// Producer: publish the slot returned by frame_ring_reserve
+static inline void frame_ring_push(FrameRing* ring) {
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    frame_ring_signal(&ring->items_event, &ring->consumer_waiting);
+}
+
+// Consumer: index of the oldest queued slot without blocking, or -1 if empty
+static inline int frame_ring_try_peek(FrameRing* ring) {
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (atomic_load_explicit(&ring->tail, memory_order_acquire) == head) return -1;
+    return (int)(head & (ring->capacity - 1));
+}
+
+// Consumer: wait for the oldest queued slot; -1 once the ring is stopped, or
+// closed and drained
+static int frame_ring_peek(FrameRing* ring) {
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    for (int spin = 0;; spin++) {
+        if (atomic_load_explicit(&ring->stopped, memory_order_acquire)) return -1;
+        if (atomic_load_explicit(&ring->tail, memory_order_acquire) != head)
+            return (int)(head & (ring->capacity - 1));
+        if (atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+            // Re-check: the last push may have landed just before close
+            if (atomic_load_explicit(&ring->tail, memory_order_acquire) != head) continue;
+            return -1;
+        }
+        if (spin < FRAME_RING_SPIN) {
+            frame_ring_cpu_relax();
+            continue;
+        }
+
+        atomic_store_explicit(&ring->consumer_waiting, 1, memory_order_seq_cst);
+        unsigned int event = atomic_load_explicit(&ring->items_event, memory_order_acquire);
+        if (!atomic_load_explicit(&ring->stopped, memory_order_seq_cst) &&
+            !atomic_load_explicit(&ring->closed, memory_order_seq_cst) &&
+            atomic_load_explicit(&ring->tail, memory_order_seq_cst) == head) {
+            frame_ring_futex_wait(&ring->items_event, event);
+        }
+        atomic_store_explicit(&ring->consumer_waiting, 0, memory_order_relaxed);
+        spin = 0;
+    }
+}
+
+// Consumer: release the slot returned by frame_ring_peek back to the producer
+static inline void frame_ring_pop(FrameRing* ring) {
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    frame_ring_signal(&ring->space_event, &ring->producer_waiting);
+}
+
+static void frame_ring_wake_all(FrameRing* ring) {
+    atomic_fetch_add_explicit(&ring->items_event, 1, memory_order_seq_cst);
+    atomic_fetch_add_explicit(&ring->space_event, 1, memory_order_seq_cst);
+    frame_ring_futex_wake(&ring->items_event);
+    frame_ring_futex_wake(&ring->space_event);
+}
+
+// Producer: no more frames; the consumer drains what is queued, then gets -1
+static void frame_ring_close(FrameRing* ring) {
+    atomic_store_explicit(&ring->closed, 1, memory_order_seq_cst);
+    frame_ring_wake_all(ring);
+}
+
+// Either side: stop now; blocked calls on both sides return -1
+static void frame_ring_stop(FrameRing* ring) {
+    atomic_store_explicit(&ring->stopped, 1, memory_order_seq_cst);
+    frame_ring_wake_all(ring);
+}
+
+#endif // FRAME_RING_H
@@ -0,0 +1,335 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+// Always-on per-stage histograms for the player pipeline.
+//
+// Each histogram is log-linear (HDR style): values below 16 get their own
+// bucket, above that every power of two is split into 16 sub-buckets, so any
+// value from 1 ns to minutes is kept with ~6% relative precision in a fixed
+// array and recording is a clz plus two increments. Every histogram has a
+// single writer thread; the render thread reads them when publishing, so
+// counters are updated with relaxed atomic stores rather than locked adds.
+//
+// Set FRAME_STATS=<path.prom> to publish every FRAME_STATS_INTERVAL seconds
+// (default 10) in Prometheus text format. The file is replaced atomically,
+// so it can be picked up by node_exporter's textfile collector.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/resource.h>
+
+// Per-frame debug output is compiled out unless built with -DFRAME_DEBUG
+#ifdef FRAME_DEBUG
+#define DEBUG_FRAME(...) printf(__VA_ARGS__)
+#else
+#define DEBUG_FRAME(...) do { } while (0)
+#endif
+
+#define HIST_SUB_BITS 4
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+typedef enum {
+    STAT_DECODE,
+    STAT_CONVERT,
+    STAT_QUEUE_DEPTH,
+    STAT_QUEUE_WAIT,
+    STAT_UPLOAD,
+    STAT_SWAP,
+    STAT_FRAME_INTERVAL,
+    STAT_PACKET_QUEUE_DEPTH,
+    STAT_DECODED_QUEUE_DEPTH,
+    STAT_PRESENT_LATENESS,
+    STAT_SCALE_GPU,
+    STAT_CAPTURE_LATENCY,
+    STAT_COUNT
+} StatId;
+
+typedef enum {
+    COUNTER_FRAMES_DECODED,
+    COUNTER_FRAMES_RENDERED,
+    COUNTER_FRAMES_DROPPED,
+    COUNTER_COUNT
+} CounterId;
+
+// Pipeline stages whose busy time is accumulated for utilization
+typedef enum {
+    STAGE_DEMUX,
+    STAGE_DECODE,
+    STAGE_CONVERT,
+    STAGE_RENDER,
+    STAGE_COUNT
+} StageId;
+
+static const char* const stage_names[STAGE_COUNT] = {"demux", "decode", "convert", "render"};
+
+typedef struct {
+    const char* name;
+    const char* help;
+    int is_time;  // Recorded in ns, exported in seconds
+} StatInfo;
+
+static const StatInfo stat_info[STAT_COUNT] = {
+    {"player_decode_seconds", "Time to decode (or read) one frame", 1},
+    {"player_convert_seconds", "Time to convert one frame to RGBA (sws_scale)", 1},
+    {"player_queue_depth", "Frames queued when the render thread asks for the next one", 0},
+    {"player_queue_wait_seconds", "Time the render thread waits for a decoded frame", 1},
+    {"player_upload_seconds", "Time spent in glTexSubImage2D", 1},
+    {"player_swap_seconds", "Time spent in eglSwapBuffers", 1},
+    {"player_frame_interval_seconds", "Time between consecutive buffer swaps", 1},
+    {"player_packet_queue_depth", "Packets queued when the decode thread asks for the next one", 0},
+    {"player_decoded_queue_depth", "Decoded frames queued when the convert thread asks for the next one", 0},
+    {"player_present_lateness_seconds", "How long after its presentation time a frame was swapped", 1},
+    {"player_scale_gpu_seconds", "GPU time of the bicubic/Lanczos scaling passes (timer query)", 1},
+    {"player_capture_latency_seconds", "Time from the camera's capture timestamp to the swap showing the frame", 1},
+};
+
+static const StatInfo counter_info[COUNTER_COUNT] = {
+    {"player_frames_decoded_total", "Frames produced by the decode thread", 0},
+    {"player_frames_rendered_total", "Frames presented by the render loop", 0},
+    {"player_frames_dropped_total", "Frames dropped for missing their presentation time", 0},
+};
+
+// Fixed Prometheus bucket boundaries, so le labels stay stable across scrapes
+static const double stat_time_bounds[] = {
+    0.0001, 0.00025, 0.0005, 0.001, 0.002, 0.004, 0.008, 0.0167, 0.0333, 0.05, 0.1, 0.25, 1.0
+};
+static const double stat_depth_bounds[] = {0, 1, 2, 3, 4, 6, 8, 16, 32, 64};
+
+static const double stat_quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+typedef struct {
+    uint64_t buckets[HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+} Histogram;
+
+static Histogram stats_histograms[STAT_COUNT];
+static uint64_t stats_counters[COUNTER_COUNT];
+static uint64_t stats_busy_ns[STAGE_COUNT];
+static uint64_t stats_cpu_ns[STAGE_COUNT];
+static uint64_t stats_start_ns = 0;
+static const char* stats_path = NULL;
+static double stats_interval = 10.0;
+static double stats_next_publish = 0.0;
+
+static inline uint64_t stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline int hist_bucket_index(uint64_t value) {
+    if (value < HIST_SUB_COUNT) return (int)value;
+    int exponent = 63 - __builtin_clzll(value);
+    int sub = (int)(value >> (exponent - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1);
+    return (exponent - HIST_SUB_BITS + 1) * HIST_SUB_COUNT + sub;
+}
+
+// Largest value that falls into the bucket
+static inline uint64_t hist_bucket_max(int index) {
+    if (index < HIST_SUB_COUNT) return (uint64_t)index;
+    int exponent = index / HIST_SUB_COUNT + HIST_SUB_BITS - 1;
+    int sub = index % HIST_SUB_COUNT;
+    int shift = exponent - HIST_SUB_BITS;
+    uint64_t lower = (uint64_t)(HIST_SUB_COUNT + sub) << shift;
+    return lower + ((1ull << shift) - 1);
+}
+
+// Single writer per variable: a relaxed load/store pair, no locked instruction
+static inline void stats_add(uint64_t* target, uint64_t amount) {
+    __atomic_store_n(target, __atomic_load_n(target, __ATOMIC_RELAXED) + amount, __ATOMIC_RELAXED);
+}
+
+static inline void stats_record(StatId id, uint64_t value) {
+    Histogram* h = &stats_histograms[id];
+    stats_add(&h->buckets[hist_bucket_index(value)], 1);
+    stats_add(&h->sum, value);
+    if (value > __atomic_load_n(&h->max, __ATOMIC_RELAXED)) __atomic_store_n(&h->max, value, __ATOMIC_RELAXED);
+    stats_add(&h->count, 1);
+}
+
+static inline void stats_count(CounterId id) {
+    stats_add(&stats_counters[id], 1);
+}
+
+// Time a stage spent working (not waiting on a queue); one thread per stage
+static inline void stats_busy(StageId stage, uint64_t ns) {
+    stats_add(&stats_busy_ns[stage], ns);
+}
+
+// CPU time the calling thread has used so far (user + system)
+static inline uint64_t stats_thread_cpu_ns(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// CPU time of a stage, reported once by its thread as it exits
+static inline void stats_cpu(StageId stage, uint64_t ns) {
+    stats_add(&stats_cpu_ns[stage], ns);
+}
+
+// Consistent-enough copy of a histogram that another thread may be writing
+static void stats_snapshot(StatId id, Histogram* out) {
+    const Histogram* h = &stats_histograms[id];
+    out->count = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        out->buckets[i] = __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+        out->count += out->buckets[i];
+    }
+    out->sum = __atomic_load_n(&h->sum, __ATOMIC_RELAXED);
+    out->max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+}
+
+static uint64_t hist_quantile(const Histogram* h, double q) {
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(q * h->count + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t value = hist_bucket_max(i);
+            return value < h->max ? value : h->max;
+        }
+    }
+    return h->max;
+}
+
+// Values at or below the bound (to bucket resolution)
+static uint64_t hist_count_at_most(const Histogram* h, uint64_t bound) {
+    uint64_t total = 0;
+    for (int i = 0; i < HIST_BUCKETS && hist_bucket_max(i) <= bound; i++) total += h->buckets[i];
+    return total;
+}
+
+static void stats_write_histogram(FILE* file, StatId id) {
+    const StatInfo* info = &stat_info[id];
+    double scale = info->is_time ? 1e-9 : 1.0;
+    const double* bounds = info->is_time ? stat_time_bounds : stat_depth_bounds;
+    int bound_count = info->is_time ? (int)(sizeof(stat_time_bounds) / sizeof(double))
+                                    : (int)(sizeof(stat_depth_bounds) / sizeof(double));
+    Histogram h;
+    stats_snapshot(id, &h);
+
+    fprintf(file, "# HELP %s %s\n# TYPE %s histogram\n", info->name, info->help, info->name);
+    for (int b = 0; b < bound_count; b++) {
+        uint64_t bound = (uint64_t)(bounds[b] / scale + 0.5);
+        fprintf(file, "%s_bucket{le=\"%g\"} %llu\n", info->name, bounds[b],
+                (unsigned long long)hist_count_at_most(&h, bound));
+    }
+    fprintf(file, "%s_bucket{le=\"+Inf\"} %llu\n", info->name, (unsigned long long)h.count);
+    fprintf(file, "%s_sum %.9g\n", info->name, h.sum * scale);
+    fprintf(file, "%s_count %llu\n", info->name, (unsigned long long)h.count);
+
+    fprintf(file, "# HELP %s_quantile %s (full-resolution quantiles)\n# TYPE %s_quantile gauge\n",
+            info->name, info->help, info->name);
+    for (size_t q = 0; q < sizeof(stat_quantiles) / sizeof(double); q++) {
+        fprintf(file, "%s_quantile{quantile=\"%g\"} %.9g\n", info->name, stat_quantiles[q],
+                hist_quantile(&h, stat_quantiles[q]) * scale);
+    }
+    fprintf(file, "%s_quantile{quantile=\"1\"} %.9g\n", info->name, h.max * scale);
+}
+
+static void stats_publish(void) {
+    if (!stats_path) return;
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", stats_path);
+    FILE* file = fopen(tmp_path, "w");
+    if (!file) {
+        fprintf(stderr, "DEBUG: Failed to open stats file %s\n", tmp_path);
+        return;
+    }
+
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        fprintf(file, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", counter_info[c].name, counter_info[c].help,
+                counter_info[c].name, counter_info[c].name,
+                (unsigned long long)__atomic_load_n(&stats_counters[c], __ATOMIC_RELAXED));
+    }
+    fprintf(file, "# HELP player_stage_busy_seconds_total Time each pipeline stage spent working\n"
+                  "# TYPE player_stage_busy_seconds_total counter\n");
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        fprintf(file, "player_stage_busy_seconds_total{stage=\"%s\"} %.9g\n", stage_names[s],
+                __atomic_load_n(&stats_busy_ns[s], __ATOMIC_RELAXED) * 1e-9);
+    }
+    fprintf(file, "# HELP player_stage_cpu_seconds_total CPU time of each pipeline stage's threads\n"
+                  "# TYPE player_stage_cpu_seconds_total counter\n");
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        fprintf(file, "player_stage_cpu_seconds_total{stage=\"%s\"} %.9g\n", stage_names[s],
+                __atomic_load_n(&stats_cpu_ns[s], __ATOMIC_RELAXED) * 1e-9);
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(file, "# HELP player_peak_rss_bytes Peak resident set size of the process\n"
+                  "# TYPE player_peak_rss_bytes gauge\nplayer_peak_rss_bytes %llu\n",
+            (unsigned long long)usage.ru_maxrss * 1024);
+    for (int s = 0; s < STAT_COUNT; s++) stats_write_histogram(file, (StatId)s);
+
+    fclose(file);
+    if (rename(tmp_path, stats_path) != 0) fprintf(stderr, "DEBUG: Failed to publish stats to %s\n", stats_path);
+}
+
+// Read FRAME_STATS / FRAME_STATS_INTERVAL; recording is on regardless
+static void stats_init(void) {
+    stats_path = getenv("FRAME_STATS");
+    if (stats_path && !*stats_path) stats_path = NULL;
+    const char* interval = getenv("FRAME_STATS_INTERVAL");
+    if (interval && atof(interval) > 0) stats_interval = atof(interval);
+    stats_start_ns = stats_now_ns();
+    stats_next_publish = stats_start_ns / 1e9 + stats_interval;
+    if (stats_path) printf("DEBUG: Publishing stats to %s every %.1f s\n", stats_path, stats_interval);
+}
+
+// Call once per rendered frame; publishes when the interval has elapsed
+static inline void stats_poll(double now) {
+    if (stats_path && now >= stats_next_publish) {
+        stats_publish();
+        stats_next_publish = now + stats_interval;
+    }
+}
+
+// One line per stage with p50 / p99 / max, printed when the render loop ends
+static void stats_print_summary(void) {
+    printf("DEBUG: Frames decoded: %llu, rendered: %llu, dropped: %llu\n",
+           (unsigned long long)stats_counters[COUNTER_FRAMES_DECODED],
+           (unsigned long long)stats_counters[COUNTER_FRAMES_RENDERED],
+           (unsigned long long)stats_counters[COUNTER_FRAMES_DROPPED]);
+    double elapsed_ns = (double)(stats_now_ns() - stats_start_ns);
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        uint64_t busy = __atomic_load_n(&stats_busy_ns[s], __ATOMIC_RELAXED);
+        uint64_t cpu = __atomic_load_n(&stats_cpu_ns[s], __ATOMIC_RELAXED);
+        if ((busy == 0 && cpu == 0) || elapsed_ns <= 0) continue;
+        if (busy == 0) {
+            printf("DEBUG: Stage %s: cpu %.2f s\n", stage_names[s], cpu / 1e9);
+            continue;
+        }
+        printf("DEBUG: Stage %s: busy %.2f s, utilization %.1f%%, cpu %.2f s\n", stage_names[s], busy / 1e9,
+               100.0 * busy / elapsed_ns, cpu / 1e9);
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("DEBUG: Process cpu: user %.2f s, system %.2f s, peak RSS %.1f MB\n",
+           usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6, usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6,
+           usage.ru_maxrss / 1024.0);
+    for (int s = 0; s < STAT_COUNT; s++) {
+        Histogram h;
+        stats_snapshot((StatId)s, &h);
+        if (h.count == 0) continue;
+        if (stat_info[s].is_time) {
+            printf("DEBUG: %s: p50 %.3f ms, p99 %.3f ms, max %.3f ms (%llu samples)\n", stat_info[s].name,
+                   hist_quantile(&h, 0.5) / 1e6, hist_quantile(&h, 0.99) / 1e6, h.max / 1e6,
+                   (unsigned long long)h.count);
+        } else {
+            printf("DEBUG: %s: p50 %llu, p99 %llu, max %llu (%llu samples)\n", stat_info[s].name,
+                   (unsigned long long)hist_quantile(&h, 0.5), (unsigned long long)hist_quantile(&h, 0.99),
+                   (unsigned long long)h.max, (unsigned long long)h.count);
+        }
+    }
+    stats_publish();
+}
+
+#endif // FRAME_STATS_H
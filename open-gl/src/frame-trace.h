@@ -0,0 +1,174 @@
+#ifndef FRAME_TRACE_H
+#define FRAME_TRACE_H
+
+// Per-thread ring-buffer tracer for the player pipeline stages.
+//
+// Enable by setting FRAME_TRACE=<path.json>. Each thread records begin/end
+// events (with the frame id) into its own fixed-size ring, so recording is
+// a timestamp plus a few stores and never takes a lock. The rings are written
+// out as Chrome trace / Perfetto JSON on exit, or whenever SIGUSR1 arrives
+// (the handler only sets a flag; the render loop calls trace_poll()).
+// With FRAME_TRACE unset every call is a single predicted branch.
+//
+// The same boundaries are also USDT probes (provider "player") for bpftrace /
+// perf when <sys/sdt.h> is available; an unattached probe is a single nop:
+//   stage_begin(name, frame_id) / stage_end(name, frame_id)   every traced stage
+//   frame_enqueue(frame_id, width, height, queued)             decode thread
+//   frame_dequeue(frame_id, queued)                             release_frame, slot handed back to the producer
+//   texture_upload(frame_id, width, height)                     before glTexSubImage2D
+//   swap(frame_id, frames_presented)                            after eglSwapBuffers
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "../../multi-core/usdt-probes.h"  // <sys/sdt.h>, or DTRACE_PROBE* that compile out
+
+#define PROBE_FRAME_ENQUEUE(frame_id, width, height, queued) \
+    DTRACE_PROBE4(player, frame_enqueue, frame_id, width, height, queued)
+#define PROBE_FRAME_DEQUEUE(frame_id, queued) DTRACE_PROBE2(player, frame_dequeue, frame_id, queued)
+#define PROBE_TEXTURE_UPLOAD(frame_id, width, height) \
+    DTRACE_PROBE3(player, texture_upload, frame_id, width, height)
+#define PROBE_SWAP(frame_id, presented) DTRACE_PROBE2(player, swap, frame_id, presented)
+
+#define TRACE_RING_EVENTS 65536  // Per thread, must be a power of two
+#define TRACE_MAX_THREADS 16
+
+typedef struct {
+    uint64_t timestamp_ns;
+    const char* name;  // Static string
+    int frame_id;
+    char phase;  // 'B' begin, 'E' end, 'i' instant
+} TraceEvent;
+
+typedef struct {
+    char thread_name[32];
+    int tid;
+    atomic_uint_fast64_t head;  // Total events written
+    TraceEvent events[TRACE_RING_EVENTS];
+} TraceRing;
+
+static int trace_enabled = 0;
+static const char* trace_path = NULL;
+static TraceRing* trace_rings[TRACE_MAX_THREADS];
+static atomic_int trace_ring_count = 0;
+static volatile sig_atomic_t trace_dump_requested = 0;
+static __thread TraceRing* trace_ring = NULL;
+
+static inline uint64_t trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Give the calling thread a ring; call once at the start of every traced thread
+static void trace_register_thread(const char* name) {
+    if (!trace_enabled || trace_ring) return;
+    int index = atomic_fetch_add(&trace_ring_count, 1);
+    if (index >= TRACE_MAX_THREADS) return;
+
+    TraceRing* ring = calloc(1, sizeof(TraceRing));
+    if (!ring) return;
+    snprintf(ring->thread_name, sizeof(ring->thread_name), "%s", name);
+    ring->tid = index + 1;
+    trace_ring = ring;
+    trace_rings[index] = ring;
+}
+
+static inline void trace_event(const char* name, int frame_id, char phase) {
+    if (__builtin_expect(!trace_enabled, 1) || !trace_ring) return;
+    uint64_t head = atomic_load_explicit(&trace_ring->head, memory_order_relaxed);
+    TraceEvent* event = &trace_ring->events[head & (TRACE_RING_EVENTS - 1)];
+    event->timestamp_ns = trace_now_ns();
+    event->name = name;
+    event->frame_id = frame_id;
+    event->phase = phase;
+    atomic_store_explicit(&trace_ring->head, head + 1, memory_order_release);
+}
+
+static inline void trace_begin(const char* name, int frame_id) {
+    DTRACE_PROBE2(player, stage_begin, name, frame_id);
+    trace_event(name, frame_id, 'B');
+}
+
+static inline void trace_end(const char* name, int frame_id) {
+    DTRACE_PROBE2(player, stage_end, name, frame_id);
+    trace_event(name, frame_id, 'E');
+}
+
+static inline void trace_instant(const char* name, int frame_id) { trace_event(name, frame_id, 'i'); }
+
+// Write every ring as Chrome trace JSON (load in chrome://tracing or ui.perfetto.dev)
+static void trace_dump(void) {
+    if (!trace_enabled) return;
+    FILE* file = fopen(trace_path, "w");
+    if (!file) {
+        fprintf(stderr, "DEBUG: Failed to open trace file %s\n", trace_path);
+        return;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    int first = 1;
+    int count = atomic_load(&trace_ring_count);
+    if (count > TRACE_MAX_THREADS) count = TRACE_MAX_THREADS;
+
+    for (int r = 0; r < count; r++) {
+        TraceRing* ring = trace_rings[r];
+        if (!ring) continue;
+
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", ring->tid, ring->thread_name);
+        first = 0;
+
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t start = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+        for (uint64_t i = start; i < head; i++) {
+            const TraceEvent* event = &ring->events[i & (TRACE_RING_EVENTS - 1)];
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d%s,\"args\":{\"frame\":%d}}",
+                    event->name, event->phase, event->timestamp_ns / 1000.0, ring->tid,
+                    event->phase == 'i' ? ",\"s\":\"t\"" : "", event->frame_id);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    printf("DEBUG: Trace written to %s\n", trace_path);
+}
+
+static void trace_signal_handler(int signum) {
+    (void)signum;
+    trace_dump_requested = 1;
+}
+
+// Dump if SIGUSR1 was received; call from a regular (non-signal) context
+static inline void trace_poll(void) {
+    if (trace_dump_requested) {
+        trace_dump_requested = 0;
+        trace_dump();
+    }
+}
+
+// Read FRAME_TRACE, register the calling thread and hook SIGUSR1 / exit
+static void trace_init(const char* main_thread_name) {
+    trace_path = getenv("FRAME_TRACE");
+    if (!trace_path || !*trace_path) return;
+    trace_enabled = 1;
+    trace_register_thread(main_thread_name);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = trace_signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, NULL);
+    atexit(trace_dump);
+
+    printf("DEBUG: Tracing to %s (SIGUSR1 dumps on demand)\n", trace_path);
+}
+
+#endif // FRAME_TRACE_H
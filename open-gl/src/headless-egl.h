@@ -0,0 +1,123 @@
+#ifndef HEADLESS_EGL_H
+#define HEADLESS_EGL_H
+
+// Headless EGL for benchmarking without a Wayland or X11 session.
+//
+// HEADLESS=1 selects it. The context comes from the Mesa surfaceless
+// platform (EGL_MESA_platform_surfaceless), or from the default display
+// with a 1x1 pbuffer where that platform or EGL_KHR_surfaceless_context is
+// missing. Either way drawing goes to an RGBA framebuffer object of the
+// window size that stays bound, so the players run their whole pipeline
+// unchanged. llvmpipe is enough on a machine without a GPU:
+//   HEADLESS=1 LIBGL_ALWAYS_SOFTWARE=1 FRAME_STATS=out.prom ./player video.mp4
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+typedef struct {
+    GLuint framebuffer;
+    GLuint color;  // Renderbuffer behind the framebuffer
+    int surfaceless;  // 0 when running on the pbuffer fallback
+} HeadlessTarget;
+
+static HeadlessTarget headless;
+
+static int headless_requested(void) {
+    const char* env = getenv("HEADLESS");
+    return env && *env && strcmp(env, "0") != 0;
+}
+
+static int headless_has_extension(const char* extensions, const char* name) {
+    size_t length = strlen(name);
+    for (const char* p = extensions; p && (p = strstr(p, name)); p += length) {
+        if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')) return 1;
+    }
+    return 0;
+}
+
+static EGLDisplay headless_get_display(void) {
+    // Client extensions are queried without a display
+    const char* client = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (headless_has_extension(client, "EGL_MESA_platform_surfaceless")) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (get_platform_display) {
+            EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (display != EGL_NO_DISPLAY) return display;
+        }
+    }
+    printf("DEBUG: Surfaceless platform unavailable, using the default EGL display\n");
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+// Create a GLES2 context with a width x height offscreen target bound as the
+// draw framebuffer; the out parameters are the players' EGL globals
+static int headless_egl_init(EGLDisplay* display, EGLConfig* config, EGLContext* context, EGLSurface* surface,
+                             int width, int height) {
+    printf("DEBUG: Initializing headless EGL\n");
+    EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT, EGL_NONE
+    };
+    EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+    EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+
+    memset(&headless, 0, sizeof(headless));
+    *surface = EGL_NO_SURFACE;
+    *context = EGL_NO_CONTEXT;
+    *display = headless_get_display();
+    if (*display == EGL_NO_DISPLAY) return -1;
+
+    EGLint major, minor, count = 0;
+    if (!eglInitialize(*display, &major, &minor)) return -1;
+    eglBindAPI(EGL_OPENGL_ES_API);
+    if (!eglChooseConfig(*display, config_attribs, config, 1, &count) || count < 1) {
+        fprintf(stderr, "DEBUG: No pbuffer-capable GLES2 config\n");
+        return -1;
+    }
+
+    *context = eglCreateContext(*display, *config, EGL_NO_CONTEXT, context_attribs);
+    if (*context == EGL_NO_CONTEXT) return -1;
+
+    headless.surfaceless = headless_has_extension(eglQueryString(*display, EGL_EXTENSIONS),
+                                                  "EGL_KHR_surfaceless_context");
+    if (!headless.surfaceless) {
+        *surface = eglCreatePbufferSurface(*display, *config, pbuffer_attribs);
+        if (*surface == EGL_NO_SURFACE) return -1;
+    }
+    if (!eglMakeCurrent(*display, *surface, *surface, *context)) return -1;
+
+    glGenRenderbuffers(1, &headless.color);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless.color);
+    // RGBA8 needs GL_OES_rgb8_rgba8, RGBA4 is all GLES2 guarantees for a renderbuffer
+    int rgba8 = headless_has_extension((const char*)glGetString(GL_EXTENSIONS), "GL_OES_rgb8_rgba8");
+    glRenderbufferStorage(GL_RENDERBUFFER, rgba8 ? GL_RGBA8_OES : GL_RGBA4, width, height);
+    glGenFramebuffers(1, &headless.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, headless.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless.color);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "DEBUG: Headless framebuffer incomplete\n");
+        return -1;
+    }
+    // Without a window surface nothing sets the initial viewport
+    glViewport(0, 0, width, height);
+
+    printf("DEBUG: Headless EGL %d.%d on %s, %s, %dx%d target\n", major, minor, glGetString(GL_RENDERER),
+           headless.surfaceless ? "surfaceless" : "pbuffer", width, height);
+    return 0;
+}
+
+// Call while the context is still current
+static void headless_egl_destroy(void) {
+    if (headless.framebuffer) glDeleteFramebuffers(1, &headless.framebuffer);
+    if (headless.color) glDeleteRenderbuffers(1, &headless.color);
+    headless.framebuffer = headless.color = 0;
+}
+
+#endif // HEADLESS_EGL_H
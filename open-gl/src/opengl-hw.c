@@ -9,6 +9,16 @@
 #include <unistd.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include "frame-trace.h"
+#include "frame-stats.h"
+#include "frame-ring.h"
+#include "present-sync.h"
+#include "headless-egl.h"
+#include "texture-stream.h"
+#include "scale-filter.h"
+#include "program-cache.h"
+#include "startup-timing.h"
+#include "software-present.h"
 
 #define TARGET_FPS 60
 #define FRAME_DURATION (1.0 / TARGET_FPS) // 16.67ms
@@ -18,7 +28,7 @@
 #define FRAME_WIDTH   640  // Hardcoded from your example
 #define FRAME_HEIGHT  480  // Hardcoded from your example
 
-typedef enum { DISPLAY_WAYLAND, DISPLAY_X11, DISPLAY_UNKNOWN } DisplayServerType;
+typedef enum { DISPLAY_WAYLAND, DISPLAY_X11, DISPLAY_HEADLESS, DISPLAY_UNKNOWN } DisplayServerType;
 
 DisplayServerType display_server_type = DISPLAY_UNKNOWN;
 
@@ -47,19 +57,23 @@ EGLSurface egl_surface;
 EGLConfig egl_config;
 
 // OpenGL globals
-GLuint texture_id, program, vbo;
+GLuint program, vbo;
+TextureStream video_stream;
+ScaleFilter scale_filter;
+int quad_width = WINDOW_WIDTH, quad_height = WINDOW_HEIGHT;  // Video quad in window pixels
+SoftwarePresent software;
+int use_software = 0;  // CPU scaling into shared memory instead of GL
 int running = 1, decoding_done = 0;
 
 // Frame buffer
 typedef struct {
     uint8_t* data;
     int size;
+    int frame_id;
 } FrameBuffer;
 
-FrameBuffer frame_buffer[FRAME_BUFFER_SIZE];
-int frame_buffer_head = 0, frame_buffer_tail = 0, frame_buffer_count = 0;
-pthread_mutex_t buffer_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t buffer_cond = PTHREAD_COND_INITIALIZER;
+FrameBuffer frame_buffer[FRAME_BUFFER_SIZE];  // Slots handed from producer to renderer through frame_ring
+FrameRing frame_ring;
 pthread_t decode_thread;
 
 // FPS tracking
@@ -106,22 +120,43 @@ static const struct wl_registry_listener registry_listener = {
 
 // Detect display server
 DisplayServerType detect_display_server() {
-    struct wl_display *test_display = wl_display_connect(NULL);
-    if (test_display) {
+    if (headless_requested()) {
+        printf("DEBUG: Headless mode requested\n");
+        return DISPLAY_HEADLESS;
+    }
+    // The connection that answers is kept for init_wayland / init_x11
+    wl_display = wl_display_connect(NULL);
+    if (wl_display) {
         printf("DEBUG: Detected Wayland display server\n");
-        wl_display_disconnect(test_display);
+        startup_mark(STARTUP_DISPLAY);
         return DISPLAY_WAYLAND;
     }
-    Display *test_x_display = XOpenDisplay(NULL);
-    if (test_x_display) {
+    x_display = XOpenDisplay(NULL);
+    if (x_display) {
         printf("DEBUG: Detected X11 display server\n");
-        XCloseDisplay(test_x_display);
+        startup_mark(STARTUP_DISPLAY);
         return DISPLAY_X11;
     }
-    printf("DEBUG: No supported display server detected\n");
+    printf("DEBUG: No supported display server detected (HEADLESS=1 runs offscreen)\n");
     return DISPLAY_UNKNOWN;
 }
 
+// Allocate every frame slot once up front. The producer writes straight into
+// the slot it reserved and the renderer hands the slot back only after
+// uploading it, so no frame is allocated, copied or freed while playing.
+int init_frame_pool() {
+    for (int i = 0; i < FRAME_BUFFER_SIZE; i++) {
+        frame_buffer[i].data = malloc(frame_size);
+        if (!frame_buffer[i].data) {
+            fprintf(stderr, "DEBUG: Failed to allocate frame slot %d\n", i);
+            return -1;
+        }
+        frame_buffer[i].size = frame_size;
+    }
+    printf("DEBUG: Frame pool allocated - %d slots of %d bytes\n", FRAME_BUFFER_SIZE, frame_size);
+    return 0;
+}
+
 // Initialize raw RGBA file
 int init_raw_file(const char* filename) {
     printf("DEBUG: Initializing raw RGBA file: %s\n", filename);
@@ -130,6 +165,7 @@ int init_raw_file(const char* filename) {
         fprintf(stderr, "DEBUG: Failed to open raw RGBA file\n");
         return -1;
     }
+    if (init_frame_pool() < 0) return -1;
     printf("DEBUG: Raw RGBA file initialized - %dx%d\n", frame_width, frame_height);
     return 0;
 }
@@ -137,23 +173,19 @@ int init_raw_file(const char* filename) {
 // Decoding thread
 void* decode_thread_func(void* arg) {
     printf("DEBUG: Starting decode thread\n");
-    uint8_t* frame_data = malloc(frame_size);
-    if (!frame_data) {
-        fprintf(stderr, "DEBUG: Failed to allocate frame buffer\n");
-        return NULL;
-    }
-
+    trace_register_thread("read");
+    int frame_id = 0;
     while (running && !decoding_done) {
-        pthread_mutex_lock(&buffer_mutex);
-        while (frame_buffer_count >= FRAME_BUFFER_SIZE && running) {
-            printf("DEBUG: Buffer full, waiting\n");
-            pthread_cond_wait(&buffer_cond, &buffer_mutex);
-        }
-        pthread_mutex_unlock(&buffer_mutex);
+        trace_begin("queue_wait", frame_id);
+        int slot = frame_ring_reserve(&frame_ring);
+        trace_end("queue_wait", frame_id);
 
-        if (!running) break;
+        if (slot < 0 || !running) break;
 
-        size_t bytes_read = fread(frame_data, 1, frame_size, raw_file);
+        uint64_t read_start = stats_now_ns();
+        trace_begin("read", frame_id);
+        size_t bytes_read = fread(frame_buffer[slot].data, 1, frame_size, raw_file);
+        trace_end("read", frame_id);
         if (bytes_read < frame_size) {
             if (feof(raw_file)) {
                 printf("DEBUG: End of raw file reached\n");
@@ -164,43 +196,44 @@ void* decode_thread_func(void* arg) {
             break;
         }
 
-        pthread_mutex_lock(&buffer_mutex);
-        frame_buffer[frame_buffer_tail].data = malloc(frame_size);
-        memcpy(frame_buffer[frame_buffer_tail].data, frame_data, frame_size);
-        frame_buffer[frame_buffer_tail].size = frame_size;
-        frame_buffer_tail = (frame_buffer_tail + 1) % FRAME_BUFFER_SIZE;
-        frame_buffer_count++;
-        printf("DEBUG: Frame read and buffered - count: %d\n", frame_buffer_count);
-        pthread_cond_signal(&buffer_cond);
-        pthread_mutex_unlock(&buffer_mutex);
+        stats_record(STAT_DECODE, stats_now_ns() - read_start);
+
+        trace_begin("enqueue", frame_id);
+        frame_buffer[slot].frame_id = frame_id++;
+        frame_ring_push(&frame_ring);
+        startup_mark(STARTUP_FIRST_DECODE);
+        PROBE_FRAME_ENQUEUE(frame_id - 1, frame_width, frame_height, frame_ring_count(&frame_ring));
+        DEBUG_FRAME("DEBUG: Frame read and buffered - count: %d\n", frame_ring_count(&frame_ring));
+        trace_end("enqueue", frame_id - 1);
+        stats_count(COUNTER_FRAMES_DECODED);
     }
 
-    free(frame_data);
+    stats_cpu(STAGE_DECODE, stats_thread_cpu_ns());
+    frame_ring_close(&frame_ring);
     printf("DEBUG: Decode thread exiting\n");
     return NULL;
 }
 
-// Get next frame
-int get_next_frame(uint8_t** frame_ptr) {
-    pthread_mutex_lock(&buffer_mutex);
-    while (frame_buffer_count == 0 && !decoding_done) {
-        printf("DEBUG: Buffer empty, waiting\n");
-        pthread_cond_wait(&buffer_cond, &buffer_mutex);
-    }
-    if (frame_buffer_count == 0 && decoding_done) {
-        pthread_mutex_unlock(&buffer_mutex);
+// Get next frame; the slot stays owned by the renderer until release_frame
+int get_next_frame(uint8_t** frame_ptr, int* frame_id) {
+    stats_record(STAT_QUEUE_DEPTH, frame_ring_count(&frame_ring));
+    int slot = frame_ring_peek(&frame_ring);
+    if (slot < 0) {
         printf("DEBUG: No more frames available\n");
         return -1;
     }
 
-    *frame_ptr = frame_buffer[frame_buffer_head].data;
-    int size = frame_buffer[frame_buffer_head].size;
-    frame_buffer_head = (frame_buffer_head + 1) % FRAME_BUFFER_SIZE;
-    frame_buffer_count--;
-    printf("DEBUG: Frame retrieved - count: %d\n", frame_buffer_count);
-    pthread_cond_signal(&buffer_cond);
-    pthread_mutex_unlock(&buffer_mutex);
-    return size;
+    *frame_ptr = frame_buffer[slot].data;
+    *frame_id = frame_buffer[slot].frame_id;
+    DEBUG_FRAME("DEBUG: Frame retrieved - count: %d\n", frame_ring_count(&frame_ring));
+    return frame_buffer[slot].size;
+}
+
+// Return the slot from get_next_frame to the producer once it is uploaded
+void release_frame(int frame_id) {
+    frame_ring_pop(&frame_ring);
+    PROBE_FRAME_DEQUEUE(frame_id, frame_ring_count(&frame_ring));
+    DEBUG_FRAME("DEBUG: Frame released - count: %d\n", frame_ring_count(&frame_ring));
 }
 
 // Compile shader
@@ -222,6 +255,9 @@ GLuint compile_shader(GLenum type, const char *source) {
 // Initialize shaders
 GLuint init_shaders() {
     printf("DEBUG: Initializing shaders\n");
+    ProgramCacheEntry cache_entry;
+    program = program_cache_load(&cache_entry, "video", vertex_shader_source, fragment_shader_source_rgba);
+    if (program) return program;
     GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
     GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source_rgba);
     program = glCreateProgram();
@@ -237,6 +273,7 @@ GLuint init_shaders() {
     }
     glDeleteShader(vertex_shader);
     glDeleteShader(fragment_shader);
+    program_cache_store(&cache_entry, program);
     printf("DEBUG: Shaders initialized\n");
     return program;
 }
@@ -266,24 +303,24 @@ void init_geometry() {
     glGenBuffers(1, &vbo);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    // Only the video quad changes between frames, the letterbox stays black
+    quad_width = (int)(scaled_width * WINDOW_WIDTH + 0.5f);
+    quad_height = (int)(scaled_height * WINDOW_HEIGHT + 0.5f);
+    present_set_damage((WINDOW_WIDTH - quad_width) / 2, (WINDOW_HEIGHT - quad_height) / 2, quad_width, quad_height);
 }
 
 // Initialize video texture
 void init_video_texture() {
     printf("DEBUG: Initializing video texture\n");
-    glGenTextures(1, &texture_id);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frame_width, frame_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    texture_stream_init(&video_stream, frame_width, frame_height);
+    if (scale_filter_init(&scale_filter, scale_filter_requested(), NULL) == 0)
+        scale_filter_resize(&scale_filter, frame_width, frame_height, quad_width, quad_height);
 }
 
 // Initialize Wayland
 int init_wayland() {
     printf("DEBUG: Initializing Wayland\n");
-    wl_display = wl_display_connect(NULL);
+    if (!wl_display) wl_display = wl_display_connect(NULL);
     if (!wl_display) return -1;
 
     struct wl_registry *registry = wl_display_get_registry(wl_display);
@@ -310,7 +347,7 @@ int init_wayland() {
 // Initialize X11
 int init_x11() {
     printf("DEBUG: Initializing X11\n");
-    x_display = XOpenDisplay(NULL);
+    if (!x_display) x_display = XOpenDisplay(NULL);
     if (!x_display) return -1;
 
     int screen = DefaultScreen(x_display);
@@ -331,10 +368,11 @@ int init_x11() {
     XMapWindow(x_display, x_window);
     XFlush(x_display);
 
-    XWindowAttributes window_attributes;
+    // Sleep until the server reports the window mapped (StructureNotifyMask is selected)
+    XEvent event;
     do {
-        XGetWindowAttributes(x_display, x_window, &window_attributes);
-    } while (window_attributes.map_state != IsViewable);
+        XWindowEvent(x_display, x_window, StructureNotifyMask, &event);
+    } while (event.type != MapNotify);
 
     printf("DEBUG: X11 initialized\n");
     return 0;
@@ -342,6 +380,8 @@ int init_x11() {
 
 // Initialize EGL
 int init_egl() {
+    if (display_server_type == DISPLAY_HEADLESS)
+        return headless_egl_init(&egl_display, &egl_config, &egl_context, &egl_surface, WINDOW_WIDTH, WINDOW_HEIGHT);
     printf("DEBUG: Initializing EGL\n");
     EGLint config_attribs[] = {
         EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
@@ -378,31 +418,56 @@ int init_egl() {
     return 0;
 }
 
+// Software presentation, for PRESENT_BACKEND=software or when EGL fails
+int init_software() {
+    software_present_layout(&software, frame_width, frame_height, WINDOW_WIDTH, WINDOW_HEIGHT, 1);
+    int result;
+    if (display_server_type == DISPLAY_WAYLAND) result = software_present_init_wayland(&software, wl_display, wl_surface);
+    else if (display_server_type == DISPLAY_X11) result = software_present_init_x11(&software, x_display, x_window);
+    else result = software_present_init_headless(&software);
+    if (result < 0) {
+        fprintf(stderr, "DEBUG: Software presentation failed\n");
+        software_present_free(&software);
+        return -1;
+    }
+    present_init_software(display_server_type == DISPLAY_WAYLAND ? wl_display : NULL,
+                          display_server_type == DISPLAY_WAYLAND ? wl_surface : NULL,
+                          display_server_type == DISPLAY_HEADLESS);
+    return 0;
+}
+
 // Render loop
 void render_loop() {
     printf("DEBUG: Starting render loop\n");
     struct timespec start_time, end_time, loop_start_time, loop_end_time;
     double elapsed, frame_time = FRAME_DURATION;
     uint8_t* frame;
+    int frame_id = -1;
+    uint64_t stage_start, last_swap_ns = 0;
 
+    uint64_t render_cpu_start = stats_thread_cpu_ns();
     clock_gettime(CLOCK_MONOTONIC, &loop_start_time);
     last_fps_time = loop_start_time.tv_sec + loop_start_time.tv_nsec / 1e9;
 
-    glUseProgram(program);
-    GLint pos_attrib = glGetAttribLocation(program, "position");
-    GLint tex_attrib = glGetAttribLocation(program, "texcoord");
-    GLint tex_uniform = glGetUniformLocation(program, "texture");
-    glUniform1i(tex_uniform, 0);
-
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    GLint pos_attrib = -1, tex_attrib = -1;
+    if (!use_software) {
+        glUseProgram(program);
+        pos_attrib = glGetAttribLocation(program, "position");
+        tex_attrib = glGetAttribLocation(program, "texcoord");
+        GLint tex_uniform = glGetUniformLocation(program, "texture");
+        glUniform1i(tex_uniform, 0);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    }
 
     while (running) {
         clock_gettime(CLOCK_MONOTONIC, &start_time);
+        trace_poll();
 
         if (display_server_type == DISPLAY_X11) {
             while (XPending(x_display)) {
                 XEvent xev;
                 XNextEvent(x_display, &xev);
+                if (software_present_handle_event(&software, &xev)) continue;
                 if (xev.type == KeyPress) {
                     printf("DEBUG: Keypress detected, stopping\n");
                     running = 0;
@@ -410,33 +475,69 @@ void render_loop() {
             }
         } else if (display_server_type == DISPLAY_WAYLAND) {
             wl_display_dispatch_pending(wl_display);
-            printf("DEBUG: Wayland events dispatched\n");
+            DEBUG_FRAME("DEBUG: Wayland events dispatched\n");
         }
 
-        int frame_size = get_next_frame(&frame);
+        trace_begin("vsync_wait", frame_id + 1);
+        present_wait();
+        trace_end("vsync_wait", frame_id + 1);
+
+        stage_start = stats_now_ns();
+        trace_begin("queue_wait", frame_id + 1);
+        int frame_size = get_next_frame(&frame, &frame_id);
+        trace_end("queue_wait", frame_id);
+        stats_record(STAT_QUEUE_WAIT, stats_now_ns() - stage_start);
         if (frame_size < 0) {
             running = 0;
             break;
         }
 
-        glBindTexture(GL_TEXTURE_2D, texture_id);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame_width, frame_height, GL_RGBA, GL_UNSIGNED_BYTE, frame);
-        free(frame);
-        printf("DEBUG: Texture updated\n");
-
-        glClear(GL_COLOR_BUFFER_BIT);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glEnableVertexAttribArray(pos_attrib);
-        glVertexAttribPointer(pos_attrib, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
-        glEnableVertexAttribArray(tex_attrib);
-        glVertexAttribPointer(tex_attrib, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-        glDisableVertexAttribArray(pos_attrib);
-        glDisableVertexAttribArray(tex_attrib);
-        printf("DEBUG: Frame rendered\n");
-
-        eglSwapBuffers(egl_display, egl_surface);
-        printf("DEBUG: Buffers swapped\n");
+        stage_start = stats_now_ns();
+        PROBE_TEXTURE_UPLOAD(frame_id, frame_width, frame_height);
+        trace_begin("upload", frame_id);
+        if (use_software) software_present_draw(&software, frame);
+        else texture_stream_upload(&video_stream, frame);
+        trace_end("upload", frame_id);
+        startup_mark(STARTUP_FIRST_UPLOAD);
+        stats_record(STAT_UPLOAD, stats_now_ns() - stage_start);
+        release_frame(frame_id);
+        DEBUG_FRAME("DEBUG: Texture updated\n");
+
+        if (!use_software) {
+            trace_begin("draw", frame_id);
+            glClear(GL_COLOR_BUFFER_BIT);
+            if (scale_filter.kind != SCALE_FILTER_BILINEAR) {
+                scale_filter_draw(&scale_filter, video_stream.textures[video_stream.last], vbo);
+            } else {
+                glBindBuffer(GL_ARRAY_BUFFER, vbo);
+                glEnableVertexAttribArray(pos_attrib);
+                glVertexAttribPointer(pos_attrib, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
+                glEnableVertexAttribArray(tex_attrib);
+                glVertexAttribPointer(tex_attrib, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                glDisableVertexAttribArray(pos_attrib);
+                glDisableVertexAttribArray(tex_attrib);
+            }
+            texture_stream_fence(&video_stream);
+            uint64_t scale_gpu_ns;
+            if (scale_filter_poll(&scale_filter, &scale_gpu_ns)) stats_record(STAT_SCALE_GPU, scale_gpu_ns);
+            trace_end("draw", frame_id);
+            DEBUG_FRAME("DEBUG: Frame rendered\n");
+        }
+
+        stage_start = stats_now_ns();
+        trace_begin("swap", frame_id);
+        if (use_software) software_present_show(&software);
+        present_swap();
+        trace_end("swap", frame_id);
+        startup_mark(STARTUP_FIRST_SWAP);
+        PROBE_SWAP(frame_id, total_frames + 1);
+        uint64_t swap_done = stats_now_ns();
+        stats_record(STAT_SWAP, swap_done - stage_start);
+        if (last_swap_ns) stats_record(STAT_FRAME_INTERVAL, swap_done - last_swap_ns);
+        last_swap_ns = swap_done;
+        stats_count(COUNTER_FRAMES_RENDERED);
+        DEBUG_FRAME("DEBUG: Buffers swapped\n");
 
         frame_count++;
         total_frames++;
@@ -450,12 +551,16 @@ void render_loop() {
             frame_count = 0;
             last_fps_time = current_time;
         }
+        stats_poll(current_time);
 
-        if (elapsed < frame_time) {
+        if (!present_is_throttled() && elapsed < frame_time) {
             usleep((frame_time - elapsed) * 1e6);
-            printf("DEBUG: Slept for %.3f ms\n", (frame_time - elapsed) * 1000);
-        } else if (elapsed > frame_time * 2) {
-            printf("DEBUG: Frame dropped, took %.3f ms\n", elapsed * 1000);
+            DEBUG_FRAME("DEBUG: Slept for %.3f ms\n", (frame_time - elapsed) * 1000);
+        } else if (present.mode != PRESENT_OFFSCREEN && elapsed > frame_time * 2) {
+            // Offscreen frames have no presentation time to miss, a slow one is only slow
+            trace_instant("frame_dropped", frame_id);
+            stats_count(COUNTER_FRAMES_DROPPED);
+            DEBUG_FRAME("DEBUG: Frame dropped, took %.3f ms\n", elapsed * 1000);
         }
     }
 
@@ -466,6 +571,8 @@ void render_loop() {
 
     printf("DEBUG: Render loop ended\n");
     printf("DEBUG: Total frames: %d, Total time: %.2f s, Average FPS: %.1f\n", total_frames, total_time, avg_fps);
+    stats_cpu(STAGE_RENDER, stats_thread_cpu_ns() - render_cpu_start);
+    stats_print_summary();
 }
 
 // Cleanup functions
@@ -473,26 +580,31 @@ void cleanup_video_source() {
     printf("DEBUG: Cleaning up video source\n");
     if (raw_file) fclose(raw_file);
 
-    pthread_mutex_lock(&buffer_mutex);
-    while (frame_buffer_count > 0) {
-        if (frame_buffer[frame_buffer_head].data) {
-            free(frame_buffer[frame_buffer_head].data);
-            frame_buffer[frame_buffer_head].data = NULL;
-        }
-        frame_buffer_head = (frame_buffer_head + 1) % FRAME_BUFFER_SIZE;
-        frame_buffer_count--;
+    for (int i = 0; i < FRAME_BUFFER_SIZE; i++) {
+        free(frame_buffer[i].data);
+        frame_buffer[i].data = NULL;
     }
-    pthread_mutex_unlock(&buffer_mutex);
 }
 
-void cleanup_display() {
-    printf("DEBUG: Cleaning up display\n");
+// Also drops a half-initialized EGL before falling back to software presentation
+void cleanup_egl() {
+    if (display_server_type == DISPLAY_HEADLESS) headless_egl_destroy();
     if (egl_display != EGL_NO_DISPLAY) {
         eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
         if (egl_context != EGL_NO_CONTEXT) eglDestroyContext(egl_display, egl_context);
         if (egl_surface != EGL_NO_SURFACE) eglDestroySurface(egl_display, egl_surface);
         eglTerminate(egl_display);
     }
+    egl_display = EGL_NO_DISPLAY;
+    egl_context = EGL_NO_CONTEXT;
+    egl_surface = EGL_NO_SURFACE;
+}
+
+void cleanup_display() {
+    printf("DEBUG: Cleaning up display\n");
+    present_destroy();
+    software_present_free(&software);
+    cleanup_egl();
     if (display_server_type == DISPLAY_WAYLAND) {
         if (wl_egl_window) wl_egl_window_destroy(wl_egl_window);
         if (shell_surface) wl_shell_surface_destroy(shell_surface);
@@ -510,16 +622,65 @@ void cleanup_display() {
 
 void cleanup_gl() {
     printf("DEBUG: Cleaning up GL\n");
-    if (texture_id) glDeleteTextures(1, &texture_id);
+    texture_stream_free(&video_stream);
+    scale_filter_free(&scale_filter);
     if (vbo) glDeleteBuffers(1, &vbo);
     if (program) glDeleteProgram(program);
 }
 
+// Start the read thread feeding frame_ring
+void start_pipeline() {
+    frame_ring_init(&frame_ring, FRAME_BUFFER_SIZE);
+    pthread_create(&decode_thread, NULL, decode_thread_func, NULL);
+}
+
+// Stop every stage, including one blocked on a full or empty ring, and wait for it
+void stop_pipeline() {
+    running = 0;
+    frame_ring_stop(&frame_ring);
+    pthread_join(decode_thread, NULL);
+}
+
+// --null-sink: read frames as fast as the file allows and discard them, with
+// no display or GL at all. The fps, per-stage CPU time and peak RSS it
+// reports are the read path's own cost, the baseline for the renderer.
+int run_null_sink() {
+    printf("DEBUG: Null sink, frames are discarded after reading\n");
+    uint8_t* frame;
+    int frame_id = -1, frames = 0;
+    uint64_t start_ns = stats_now_ns();
+    start_pipeline();
+    while (get_next_frame(&frame, &frame_id) >= 0) {
+        release_frame(frame_id);
+        frames++;
+        stats_poll(stats_now_ns() / 1e9);
+    }
+    double seconds = (stats_now_ns() - start_ns) / 1e9;
+    stop_pipeline();
+
+    printf("DEBUG: Null sink: %d frames in %.2f s, %.1f fps\n", frames, seconds, seconds > 0 ? frames / seconds : 0.0);
+    stats_print_summary();
+    cleanup_video_source();
+    printf("DEBUG: Program terminated\n");
+    return EXIT_SUCCESS;
+}
+
 // Main function
 int main(int argc, char *argv[]) {
+    startup_begin();
     printf("DEBUG: Program started\n");
+    trace_init("render");
+    stats_init();
+
+    // --null-sink may come anywhere, the other arguments are positional
+    int null_sink = 0, positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--null-sink") == 0) null_sink = 1;
+        else argv[++positional] = argv[i];
+    }
+    argc = positional + 1;
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s <video_file.rgba>\n", argv[0]);
+        fprintf(stderr, "Usage: %s [--null-sink] <video_file.rgba>\n", argv[0]);
         return EXIT_FAILURE;
     }
 
@@ -527,47 +688,60 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "DEBUG: Failed to open raw RGBA file\n");
         return EXIT_FAILURE;
     }
+    startup_mark(STARTUP_PROBE);
+    if (null_sink) return run_null_sink();
 
-    display_server_type = detect_display_server();
-    if (display_server_type == DISPLAY_UNKNOWN) {
-        cleanup_video_source();
-        return EXIT_FAILURE;
-    }
+    // Frames are read ahead while the display, window and EGL come up
+    start_pipeline();
 
-    if (display_server_type == DISPLAY_WAYLAND) {
-        if (init_wayland() < 0) {
-            cleanup_video_source();
-            return EXIT_FAILURE;
+    display_server_type = detect_display_server();
+    int display_ready = display_server_type != DISPLAY_UNKNOWN;
+    if (display_ready && display_server_type == DISPLAY_WAYLAND) display_ready = init_wayland() == 0;
+    else if (display_ready && display_server_type == DISPLAY_X11) display_ready = init_x11() == 0;
+    if (display_ready) {
+        startup_mark(STARTUP_WINDOW);
+        use_software = software_present_requested();
+        if (!use_software && init_egl() < 0) {
+            fprintf(stderr, "DEBUG: EGL initialization failed, falling back to software presentation\n");
+            cleanup_egl();
+            use_software = 1;
         }
-    } else if (display_server_type == DISPLAY_X11) {
-        if (init_x11() < 0) {
-            cleanup_video_source();
-            return EXIT_FAILURE;
+    }
+    if (display_ready && use_software) display_ready = init_software() == 0;
+    if (display_ready && !use_software) {
+        startup_mark(STARTUP_EGL);
+        if (display_server_type == DISPLAY_HEADLESS) {
+            present_init_offscreen(egl_display);
+        } else {
+            present_init(egl_display, egl_surface, display_server_type == DISPLAY_WAYLAND ? wl_display : NULL,
+                         display_server_type == DISPLAY_WAYLAND ? wl_surface : NULL);
         }
     }
-
-    if (init_egl() < 0) {
+    if (!display_ready) {
+        stop_pipeline();
         cleanup_video_source();
         cleanup_display();
         return EXIT_FAILURE;
     }
 
-    program = init_shaders();
-    if (!program) {
-        cleanup_video_source();
-        cleanup_display();
-        return EXIT_FAILURE;
-    }
+    if (!use_software) {
+        program = init_shaders();
+        if (!program) {
+            stop_pipeline();
+            cleanup_video_source();
+            cleanup_display();
+            return EXIT_FAILURE;
+        }
+        startup_mark(STARTUP_SHADERS);
 
-    init_geometry();
-    init_video_texture();
+        init_geometry();
+        init_video_texture();
+        startup_mark(STARTUP_TEXTURES);
+    }
 
-    pthread_create(&decode_thread, NULL, decode_thread_func, NULL);
     render_loop();
-
-    running = 0;
-    pthread_join(decode_thread, NULL);
-    cleanup_gl();
+    stop_pipeline();
+    if (!use_software) cleanup_gl();
     cleanup_video_source();
     cleanup_display();
 
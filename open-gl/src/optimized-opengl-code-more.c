@@ -6,6 +6,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <errno.h>
 #include <unistd.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -13,14 +15,34 @@
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
-
-#define TARGET_FPS 60
+#include "frame-trace.h"
+#include "frame-stats.h"
+#include "frame-ring.h"
+#include "present-sync.h"
+#include "headless-egl.h"
+#include "decoder-pool.h"
+#include "slice-convert.h"
+#include "yuv-upload.h"
+#include "texture-stream.h"
+#include "scale-filter.h"
+#include "program-cache.h"
+#include "startup-timing.h"
+#include "software-present.h"
+
+#define TARGET_FPS 60  // Only used when the stream has no frame rate
 #define FRAME_DURATION (1.0 / TARGET_FPS) // 16.67ms
+#define LATE_DROP_NS 20000000ll  // Drop a frame this late instead of uploading it
+#define MAX_LATE_DROPS 4  // Still show every fifth frame when everything is late
+#define SKIP_NONREF_AFTER 8  // Consecutive late frames before the decoder skips non-reference frames
+#define SKIP_NONREF_CLEAR 60  // Consecutive on-time frames before it decodes everything again
+#define CLOCK_RESYNC_NS 1000000000ll  // Re-anchor the clock rather than drop a second of video
 #define WINDOW_WIDTH  1920
 #define WINDOW_HEIGHT 1080
-#define FRAME_BUFFER_SIZE 8
+#define FRAME_BUFFER_SIZE 8   // RGBA frames ready for the renderer
+#define PACKET_QUEUE_SIZE 64  // Demuxed packets waiting for the decoder
+#define DECODED_QUEUE_SIZE 8  // Decoder frames waiting for conversion
 
-typedef enum { DISPLAY_WAYLAND, DISPLAY_X11, DISPLAY_UNKNOWN } DisplayServerType;
+typedef enum { DISPLAY_WAYLAND, DISPLAY_X11, DISPLAY_HEADLESS, DISPLAY_UNKNOWN } DisplayServerType;
 
 DisplayServerType display_server_type = DISPLAY_UNKNOWN;
 
@@ -28,13 +50,16 @@ DisplayServerType display_server_type = DISPLAY_UNKNOWN;
 AVFormatContext* format_context = NULL;
 AVCodecContext* codec_context = NULL;
 AVFrame* av_frame = NULL;
-AVFrame* rgba_frame = NULL;
-AVPacket* packet = NULL;
-struct SwsContext* sws_context = NULL;
+SliceConverter converter;
+YuvTextures yuv;  // yuv.format != YUV_NONE: planes go to the GPU unconverted
 int video_stream_index = -1;
-uint8_t* rgb_buffer = NULL;
 int rgb_buffer_size = 0;
 int frame_width = 0, frame_height = 0;
+AVRational stream_time_base = {1, AV_TIME_BASE};
+int64_t frame_duration_ns = (int64_t)(FRAME_DURATION * 1e9);  // Nominal, for frames without a timestamp
+int64_t last_pts_ns = -1;
+atomic_int decoder_skip_nonref;  // Set by the renderer, applied by the decode thread
+int late_streak = 0, on_time_streak = 0;
 
 // Display globals
 struct wl_display *wl_display;
@@ -55,20 +80,46 @@ EGLSurface egl_surface;
 EGLConfig egl_config;
 
 // OpenGL globals
-GLuint texture_id, program, vbo;
+GLuint program, vbo;
+TextureStream video_stream;
+ScaleFilter scale_filter;
+int quad_width = WINDOW_WIDTH, quad_height = WINDOW_HEIGHT;  // Video quad in window pixels
+SoftwarePresent software;
+int use_software = 0;  // CPU scaling into shared memory instead of GL
 int running = 1, decoding_done = 0;
 
+// Pipeline queues, each a bounded ring so a slow stage blocks the one before it:
+// demux -> packet_ring -> decode -> decoded_ring -> convert -> frame_ring -> render
+AVPacket* packet_queue[PACKET_QUEUE_SIZE];
+FrameRing packet_ring;
+
+typedef struct {
+    AVFrame* frame;  // Reference to the decoder's own picture, from decoder-pool.h
+    int frame_id;
+} DecodedFrame;
+
+DecodedFrame decoded_queue[DECODED_QUEUE_SIZE];
+FrameRing decoded_ring;
+
 // Frame buffer
 typedef struct {
     uint8_t* data;
     int size;
+    int stride;  // Bytes per row, the sws_scale destination stride
+    int frame_id;
+    int64_t pts_ns;  // Presentation time on the stream clock
+    AVFrame* picture;  // Decoder picture reference on the YUV path, where data is unused
 } FrameBuffer;
 
-FrameBuffer frame_buffer[FRAME_BUFFER_SIZE];
-int frame_buffer_head = 0, frame_buffer_tail = 0, frame_buffer_count = 0;
-pthread_mutex_t buffer_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t buffer_cond = PTHREAD_COND_INITIALIZER;
-pthread_t decode_thread;
+FrameBuffer frame_buffer[FRAME_BUFFER_SIZE];  // RGBA slots handed from the convert thread to the renderer
+FrameRing frame_ring;
+pthread_t demux_thread, decode_thread, convert_thread;
+
+// The convert thread holds its first frame until main has picked the output
+// (YUV planes or RGBA), which needs both the probe and the EGL result
+pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t output_cond = PTHREAD_COND_INITIALIZER;
+int output_decided = 0;
 
 // FPS tracking
 double last_fps_time = 0.0;
@@ -114,22 +165,88 @@ static const struct wl_registry_listener registry_listener = {
 
 // Detect display server
 DisplayServerType detect_display_server() {
-    struct wl_display *test_display = wl_display_connect(NULL);
-    if (test_display) {
+    if (headless_requested()) {
+        printf("DEBUG: Headless mode requested\n");
+        return DISPLAY_HEADLESS;
+    }
+    // The connection that answers is kept for init_wayland / init_x11
+    wl_display = wl_display_connect(NULL);
+    if (wl_display) {
         printf("DEBUG: Detected Wayland display server\n");
-        wl_display_disconnect(test_display);
+        startup_mark(STARTUP_DISPLAY);
         return DISPLAY_WAYLAND;
     }
-    Display *test_x_display = XOpenDisplay(NULL);
-    if (test_x_display) {
+    x_display = XOpenDisplay(NULL);
+    if (x_display) {
         printf("DEBUG: Detected X11 display server\n");
-        XCloseDisplay(test_x_display);
+        startup_mark(STARTUP_DISPLAY);
         return DISPLAY_X11;
     }
-    printf("DEBUG: No supported display server detected\n");
+    printf("DEBUG: No supported display server detected (HEADLESS=1 runs offscreen)\n");
     return DISPLAY_UNKNOWN;
 }
 
+// Block the convert thread until main has chosen YUV upload or RGBA output
+void wait_for_output_format() {
+    pthread_mutex_lock(&output_lock);
+    while (!output_decided) pthread_cond_wait(&output_cond, &output_lock);
+    pthread_mutex_unlock(&output_lock);
+}
+
+// Also called by stop_pipeline, so a convert thread still waiting can exit
+void publish_output_format() {
+    pthread_mutex_lock(&output_lock);
+    output_decided = 1;
+    pthread_cond_broadcast(&output_cond);
+    pthread_mutex_unlock(&output_lock);
+}
+
+// Slots the convert thread fills and the renderer uploads from: a picture
+// reference each, plus RGBA pixels once init_output_format picks RGBA.
+// Nothing is allocated, copied or freed per frame while playing.
+int init_frame_pool() {
+    for (int i = 0; i < PACKET_QUEUE_SIZE; i++) {
+        packet_queue[i] = av_packet_alloc();
+        if (!packet_queue[i]) return -1;
+    }
+    for (int i = 0; i < DECODED_QUEUE_SIZE; i++) {
+        decoded_queue[i].frame = av_frame_alloc();
+        if (!decoded_queue[i].frame) return -1;
+    }
+    for (int i = 0; i < FRAME_BUFFER_SIZE; i++) {
+        frame_buffer[i].picture = av_frame_alloc();
+        if (!frame_buffer[i].picture) return -1;
+    }
+    printf("DEBUG: Frame pool allocated - %d packets, %d decoded, %d frame slots\n", PACKET_QUEUE_SIZE,
+           DECODED_QUEUE_SIZE, FRAME_BUFFER_SIZE);
+    return 0;
+}
+
+// Pick YUV upload or sws_scale to RGBA, once the probe and the display are
+// both done, and let the convert thread start. The scale filters and software
+// presentation read RGBA, so they take the sws_scale path.
+int init_output_format(int rgba_required) {
+    yuv.format = rgba_required || scale_filter_requested() != SCALE_FILTER_BILINEAR
+                     ? YUV_NONE
+                     : yuv_upload_format(codec_context->pix_fmt);
+    int result = 0;
+    if (yuv.format == YUV_NONE) {
+        for (int i = 0; i < FRAME_BUFFER_SIZE && result == 0; i++) {
+            frame_buffer[i].data = av_malloc(rgb_buffer_size);  // av_malloc aligns for sws_scale's SIMD stores
+            if (!frame_buffer[i].data) {
+                fprintf(stderr, "DEBUG: Failed to allocate frame slot %d\n", i);
+                result = -1;
+            }
+            frame_buffer[i].size = rgb_buffer_size;
+            frame_buffer[i].stride = frame_width * 4;
+        }
+        if (result == 0) result = slice_convert_init(&converter, frame_width, frame_height, codec_context->pix_fmt);
+        if (result == 0) printf("DEBUG: Converting to %d RGBA slots of %d bytes\n", FRAME_BUFFER_SIZE, rgb_buffer_size);
+    }
+    if (result == 0) publish_output_format();  // On failure stop_pipeline releases the thread
+    return result;
+}
+
 // Initialize MP4
 int init_mp4_file(const char* filename) {
     printf("DEBUG: Initializing MP4 file: %s\n", filename);
@@ -152,94 +269,245 @@ int init_mp4_file(const char* filename) {
     const AVCodec* codec = avcodec_find_decoder(format_context->streams[video_stream_index]->codecpar->codec_id);
     codec_context = avcodec_alloc_context3(codec);
     avcodec_parameters_to_context(codec_context, format_context->streams[video_stream_index]->codecpar);
+    decoder_pool_attach(codec_context);
     ret = avcodec_open2(codec_context, codec, NULL);
     if (ret < 0) return -1;
 
     av_frame = av_frame_alloc();
-    rgba_frame = av_frame_alloc();
-    if (!av_frame || !rgba_frame) return -1;
+    if (!av_frame) return -1;
+
+    AVStream* stream = format_context->streams[video_stream_index];
+    stream_time_base = stream->time_base;
+    if (stream->avg_frame_rate.num > 0 && stream->avg_frame_rate.den > 0)
+        frame_duration_ns = (int64_t)(1e9 / av_q2d(stream->avg_frame_rate));
+    printf("DEBUG: Stream time base %d/%d, frame duration %.3f ms\n", stream_time_base.num, stream_time_base.den,
+           frame_duration_ns / 1e6);
 
     frame_width = codec_context->width;
     frame_height = codec_context->height;
     rgb_buffer_size = av_image_get_buffer_size(AV_PIX_FMT_RGBA, frame_width, frame_height, 1);
-    rgb_buffer = av_malloc(rgb_buffer_size);
-    av_image_fill_arrays(rgba_frame->data, rgba_frame->linesize, rgb_buffer, AV_PIX_FMT_RGBA, frame_width, frame_height, 1);
-
-    sws_context = sws_getContext(frame_width, frame_height, codec_context->pix_fmt,
-                                 frame_width, frame_height, AV_PIX_FMT_RGBA, SWS_BILINEAR, NULL, NULL, NULL);
-    if (!sws_context) return -1;
-
-    packet = av_packet_alloc();
-    if (!packet) return -1;
+    if (init_frame_pool() < 0) return -1;
 
     printf("DEBUG: MP4 initialized - %dx%d\n", frame_width, frame_height);
     return 0;
 }
 
-// Decoding thread
-void* decode_thread_func(void* arg) {
-    printf("DEBUG: Starting decode thread\n");
-    while (running && !decoding_done) {
-        pthread_mutex_lock(&buffer_mutex);
-        while (frame_buffer_count >= FRAME_BUFFER_SIZE && running) {
-            printf("DEBUG: Buffer full, waiting\n");
-            pthread_cond_wait(&buffer_cond, &buffer_mutex);
-        }
-        pthread_mutex_unlock(&buffer_mutex);
-
-        if (!running) break;
-
-        int ret = av_read_frame(format_context, packet);
+// Demux thread: read the video stream's packets into packet_ring
+void* demux_thread_func(void* arg) {
+    printf("DEBUG: Starting demux thread\n");
+    trace_register_thread("demux");
+    int packet_id = 0;
+    while (running) {
+        trace_begin("queue_wait", packet_id);
+        int slot = frame_ring_reserve(&packet_ring);
+        trace_end("queue_wait", packet_id);
+        if (slot < 0 || !running) break;
+
+        uint64_t stage_start = stats_now_ns();
+        trace_begin("demux", packet_id);
+        int ret = av_read_frame(format_context, packet_queue[slot]);
+        trace_end("demux", packet_id);
+        stats_busy(STAGE_DEMUX, stats_now_ns() - stage_start);
         if (ret < 0) {
             printf("DEBUG: End of video reached\n");
             decoding_done = 1;
             break;
         }
 
-        if (packet->stream_index == video_stream_index) {
-            avcodec_send_packet(codec_context, packet);
-            if (avcodec_receive_frame(codec_context, av_frame) == 0) {
-                sws_scale(sws_context, (const uint8_t* const*)av_frame->data, av_frame->linesize, 0,
-                          codec_context->height, rgba_frame->data, rgba_frame->linesize);
-
-                pthread_mutex_lock(&buffer_mutex);
-                frame_buffer[frame_buffer_tail].data = malloc(rgb_buffer_size);
-                memcpy(frame_buffer[frame_buffer_tail].data, rgb_buffer, rgb_buffer_size);
-                frame_buffer[frame_buffer_tail].size = rgb_buffer_size;
-                frame_buffer_tail = (frame_buffer_tail + 1) % FRAME_BUFFER_SIZE;
-                frame_buffer_count++;
-                printf("DEBUG: Frame decoded and buffered - count: %d\n", frame_buffer_count);
-                pthread_cond_signal(&buffer_cond);
-                pthread_mutex_unlock(&buffer_mutex);
-            }
+        if (packet_queue[slot]->stream_index != video_stream_index) {
+            av_packet_unref(packet_queue[slot]);  // Not published, the slot is reused
+            continue;
+        }
+        frame_ring_push(&packet_ring);
+        packet_id++;
+    }
+    stats_cpu(STAGE_DEMUX, stats_thread_cpu_ns());
+    frame_ring_close(&packet_ring);
+    printf("DEBUG: Demux thread exiting\n");
+    return NULL;
+}
+
+// Queue every frame the decoder has ready for the convert thread; a packet
+// can yield none or several. decode_ns accumulates decoder time between
+// frames so STAT_DECODE is the cost of one frame. Returns -1 once stopped.
+int drain_decoder(int* frame_id, uint64_t* decode_ns) {
+    for (;;) {
+        uint64_t stage_start = stats_now_ns();
+        trace_begin("decode", *frame_id);
+        int ret = avcodec_receive_frame(codec_context, av_frame);
+        trace_end("decode", *frame_id);
+        uint64_t elapsed = stats_now_ns() - stage_start;
+        stats_busy(STAGE_DECODE, elapsed);
+        *decode_ns += elapsed;
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) return 0;
+        if (ret < 0) {
+            fprintf(stderr, "DEBUG: Failed to receive frame (%d)\n", ret);
+            return 0;
         }
-        av_packet_unref(packet);
+        stats_record(STAT_DECODE, *decode_ns);
+        *decode_ns = 0;
+
+        trace_begin("queue_wait", *frame_id);
+        int slot = frame_ring_reserve(&decoded_ring);
+        trace_end("queue_wait", *frame_id);
+        if (slot < 0) {
+            av_frame_unref(av_frame);
+            return -1;
+        }
+
+        av_frame_move_ref(decoded_queue[slot].frame, av_frame);  // Hand our reference to the slot
+        decoded_queue[slot].frame_id = (*frame_id)++;
+        frame_ring_push(&decoded_ring);
+        stats_count(COUNTER_FRAMES_DECODED);
     }
+}
+
+// Decode thread: packets from packet_ring in, decoder frames to decoded_ring out
+void* decode_thread_func(void* arg) {
+    printf("DEBUG: Starting decode thread\n");
+    trace_register_thread("decode");
+    int frame_id = 0;
+    uint64_t decode_ns = 0;
+    while (running) {
+        stats_record(STAT_PACKET_QUEUE_DEPTH, frame_ring_count(&packet_ring));
+        trace_begin("queue_wait", frame_id);
+        int slot = frame_ring_peek(&packet_ring);
+        trace_end("queue_wait", frame_id);
+        if (slot < 0) break;
+
+        enum AVDiscard skip = atomic_load_explicit(&decoder_skip_nonref, memory_order_relaxed) ? AVDISCARD_NONREF
+                                                                                                : AVDISCARD_DEFAULT;
+        if (codec_context->skip_frame != skip) {
+            codec_context->skip_frame = skip;
+            printf("DEBUG: Decoder %s non-reference frames\n", skip == AVDISCARD_NONREF ? "skipping" : "decoding all");
+        }
+
+        uint64_t stage_start = stats_now_ns();
+        trace_begin("decode", frame_id);
+        int ret = avcodec_send_packet(codec_context, packet_queue[slot]);
+        trace_end("decode", frame_id);
+        uint64_t elapsed = stats_now_ns() - stage_start;
+        stats_busy(STAGE_DECODE, elapsed);
+        decode_ns += elapsed;
+        av_packet_unref(packet_queue[slot]);
+        frame_ring_pop(&packet_ring);
+        if (ret < 0) fprintf(stderr, "DEBUG: Failed to send packet (%d)\n", ret);
+
+        if (drain_decoder(&frame_id, &decode_ns) < 0) break;
+    }
+
+    if (running && decoding_done) {
+        avcodec_send_packet(codec_context, NULL);  // Flush the frames held back for reordering
+        drain_decoder(&frame_id, &decode_ns);
+    }
+    stats_cpu(STAGE_DECODE, stats_thread_cpu_ns());
+    frame_ring_close(&decoded_ring);
     printf("DEBUG: Decode thread exiting\n");
     return NULL;
 }
 
-// Get next frame
-int get_next_frame(uint8_t** frame_ptr) {
-    pthread_mutex_lock(&buffer_mutex);
-    while (frame_buffer_count == 0 && !decoding_done) {
-        printf("DEBUG: Buffer empty, waiting\n");
-        pthread_cond_wait(&buffer_cond, &buffer_mutex);
+// Stream-clock presentation time of a decoded frame in ns; a frame without a
+// timestamp is placed one nominal frame duration after the previous one
+int64_t frame_pts_ns(const AVFrame* frame) {
+    int64_t pts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+    if (pts != AV_NOPTS_VALUE)
+        last_pts_ns = av_rescale_q(pts, stream_time_base, (AVRational){1, 1000000000});
+    else
+        last_pts_ns = last_pts_ns < 0 ? 0 : last_pts_ns + frame_duration_ns;
+    return last_pts_ns;
+}
+
+// Convert thread: decoder frames to RGBA slots in frame_ring, sliced across
+// the converter's worker threads
+void* convert_thread_func(void* arg) {
+    printf("DEBUG: Starting convert thread\n");
+    trace_register_thread("convert");
+    int frame_id = 0;
+    wait_for_output_format();
+    while (running) {
+        stats_record(STAT_DECODED_QUEUE_DEPTH, frame_ring_count(&decoded_ring));
+        trace_begin("queue_wait", frame_id);
+        int in = frame_ring_peek(&decoded_ring);
+        int out = in < 0 ? -1 : frame_ring_reserve(&frame_ring);
+        trace_end("queue_wait", frame_id);
+        if (out < 0) break;
+
+        DecodedFrame* decoded = &decoded_queue[in];
+        frame_id = decoded->frame_id;
+        int64_t pts_ns = frame_pts_ns(decoded->frame);
+        if (yuv.format != YUV_NONE) {
+            // The shader converts; the decoder's reference moves on to the renderer
+            av_frame_move_ref(frame_buffer[out].picture, decoded->frame);
+        } else {
+            uint64_t stage_start = stats_now_ns();
+            trace_begin("sws_scale", frame_id);
+            slice_convert_run(&converter, decoded->frame, frame_buffer[out].data, frame_buffer[out].stride);
+            trace_end("sws_scale", frame_id);
+            uint64_t elapsed = stats_now_ns() - stage_start;
+            stats_record(STAT_CONVERT, elapsed);
+            stats_busy(STAGE_CONVERT, elapsed);
+            av_frame_unref(decoded->frame);  // The picture goes back to the decoder pool
+        }
+        frame_ring_pop(&decoded_ring);
+
+        trace_begin("enqueue", frame_id);
+        frame_buffer[out].frame_id = frame_id;
+        frame_buffer[out].pts_ns = pts_ns;
+        frame_ring_push(&frame_ring);
+        startup_mark(STARTUP_FIRST_DECODE);
+        PROBE_FRAME_ENQUEUE(frame_id, frame_width, frame_height, frame_ring_count(&frame_ring));
+        DEBUG_FRAME("DEBUG: Frame converted and buffered - count: %d\n", frame_ring_count(&frame_ring));
+        trace_end("enqueue", frame_id);
+        frame_id++;
     }
-    if (frame_buffer_count == 0 && decoding_done) {
-        pthread_mutex_unlock(&buffer_mutex);
+    stats_cpu(STAGE_CONVERT, stats_thread_cpu_ns() + slice_convert_cpu_ns(&converter));
+    frame_ring_close(&frame_ring);
+    printf("DEBUG: Convert thread exiting\n");
+    return NULL;
+}
+
+// Get next frame; the slot stays owned by the renderer until release_frame
+int get_next_frame(FrameBuffer** frame_ptr, int* frame_id, int64_t* pts_ns) {
+    stats_record(STAT_QUEUE_DEPTH, frame_ring_count(&frame_ring));
+    int slot = frame_ring_peek(&frame_ring);
+    if (slot < 0) {
         printf("DEBUG: No more frames available\n");
         return -1;
     }
 
-    *frame_ptr = frame_buffer[frame_buffer_head].data;
-    int size = frame_buffer[frame_buffer_head].size;
-    frame_buffer_head = (frame_buffer_head + 1) % FRAME_BUFFER_SIZE;
-    frame_buffer_count--;
-    printf("DEBUG: Frame retrieved - count: %d\n", frame_buffer_count);
-    pthread_cond_signal(&buffer_cond);
-    pthread_mutex_unlock(&buffer_mutex);
-    return size;
+    *frame_ptr = &frame_buffer[slot];
+    *frame_id = frame_buffer[slot].frame_id;
+    *pts_ns = frame_buffer[slot].pts_ns;
+    DEBUG_FRAME("DEBUG: Frame retrieved - count: %d\n", frame_ring_count(&frame_ring));
+    return frame_buffer[slot].size;
+}
+
+// Return the slot from get_next_frame to the convert thread once it is uploaded
+void release_frame(int frame_id) {
+    int slot = frame_ring_try_peek(&frame_ring);
+    if (slot >= 0 && frame_buffer[slot].picture) av_frame_unref(frame_buffer[slot].picture);
+    frame_ring_pop(&frame_ring);
+    PROBE_FRAME_DEQUEUE(frame_id, frame_ring_count(&frame_ring));
+    DEBUG_FRAME("DEBUG: Frame released - count: %d\n", frame_ring_count(&frame_ring));
+}
+
+// Ask the decoder to skip non-reference frames while the renderer keeps
+// falling behind, and to decode everything again once it has caught up
+void update_decoder_skip(int late) {
+    late_streak = late ? late_streak + 1 : 0;
+    on_time_streak = late ? 0 : on_time_streak + 1;
+    int skipping = atomic_load_explicit(&decoder_skip_nonref, memory_order_relaxed);
+    if (!skipping && late_streak >= SKIP_NONREF_AFTER)
+        atomic_store_explicit(&decoder_skip_nonref, 1, memory_order_relaxed);
+    else if (skipping && on_time_streak >= SKIP_NONREF_CLEAR)
+        atomic_store_explicit(&decoder_skip_nonref, 0, memory_order_relaxed);
+}
+
+// Sleep until an absolute CLOCK_MONOTONIC time, so sleep error never accumulates
+void wait_until_ns(int64_t deadline_ns) {
+    if (deadline_ns <= (int64_t)stats_now_ns()) return;
+    struct timespec deadline = {deadline_ns / 1000000000, deadline_ns % 1000000000};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {}
 }
 
 // Compile shader
@@ -261,8 +529,12 @@ GLuint compile_shader(GLenum type, const char *source) {
 // Initialize shaders
 GLuint init_shaders() {
     printf("DEBUG: Initializing shaders\n");
+    const char* fragment_source = yuv.format != YUV_NONE ? yuv_fragment_shader(yuv.format) : fragment_shader_source_rgba;
+    ProgramCacheEntry cache_entry;
+    program = program_cache_load(&cache_entry, "video", vertex_shader_source, fragment_source);
+    if (program) return program;
     GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
-    GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source_rgba);
+    GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
     program = glCreateProgram();
     glAttachShader(program, vertex_shader);
     glAttachShader(program, fragment_shader);
@@ -276,6 +548,7 @@ GLuint init_shaders() {
     }
     glDeleteShader(vertex_shader);
     glDeleteShader(fragment_shader);
+    program_cache_store(&cache_entry, program);
     printf("DEBUG: Shaders initialized\n");
     return program;
 }
@@ -309,24 +582,28 @@ void init_geometry() {
     glGenBuffers(1, &vbo);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    // Only the video quad changes between frames, the letterbox stays black
+    quad_width = (int)(scaled_width * WINDOW_WIDTH + 0.5f);
+    quad_height = (int)(scaled_height * WINDOW_HEIGHT + 0.5f);
+    present_set_damage((WINDOW_WIDTH - quad_width) / 2, (WINDOW_HEIGHT - quad_height) / 2, quad_width, quad_height);
 }
 
 // Initialize video texture
 void init_video_texture() {
     printf("DEBUG: Initializing video texture\n");
-    glGenTextures(1, &texture_id);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Smooth downscaling
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Smooth upscaling
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frame_width, frame_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    if (yuv.format != YUV_NONE) {
+        yuv_textures_init(&yuv, yuv.format, program);
+        return;
+    }
+    texture_stream_init(&video_stream, frame_width, frame_height);
+    if (scale_filter_init(&scale_filter, scale_filter_requested(), NULL) == 0)
+        scale_filter_resize(&scale_filter, frame_width, frame_height, quad_width, quad_height);
 }
 
 // Initialize Wayland
 int init_wayland() {
     printf("DEBUG: Initializing Wayland\n");
-    wl_display = wl_display_connect(NULL);
+    if (!wl_display) wl_display = wl_display_connect(NULL);
     if (!wl_display) return -1;
 
     struct wl_registry *registry = wl_display_get_registry(wl_display);
@@ -353,7 +630,7 @@ int init_wayland() {
 // Initialize X11
 int init_x11() {
     printf("DEBUG: Initializing X11\n");
-    x_display = XOpenDisplay(NULL);
+    if (!x_display) x_display = XOpenDisplay(NULL);
     if (!x_display) return -1;
 
     int screen = DefaultScreen(x_display);
@@ -374,10 +651,11 @@ int init_x11() {
     XMapWindow(x_display, x_window);
     XFlush(x_display);
 
-    XWindowAttributes window_attributes;
+    // Sleep until the server reports the window mapped (StructureNotifyMask is selected)
+    XEvent event;
     do {
-        XGetWindowAttributes(x_display, x_window, &window_attributes);
-    } while (window_attributes.map_state != IsViewable);
+        XWindowEvent(x_display, x_window, StructureNotifyMask, &event);
+    } while (event.type != MapNotify);
 
     printf("DEBUG: X11 initialized\n");
     return 0;
@@ -385,6 +663,8 @@ int init_x11() {
 
 // Initialize EGL
 int init_egl() {
+    if (display_server_type == DISPLAY_HEADLESS)
+        return headless_egl_init(&egl_display, &egl_config, &egl_context, &egl_surface, WINDOW_WIDTH, WINDOW_HEIGHT);
     printf("DEBUG: Initializing EGL\n");
     EGLint config_attribs[] = {
         EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
@@ -421,31 +701,57 @@ int init_egl() {
     return 0;
 }
 
-// Render loop with corrected FPS calculation and background clearing
+// Software presentation, for PRESENT_BACKEND=software or when EGL fails
+int init_software() {
+    software_present_layout(&software, frame_width, frame_height, WINDOW_WIDTH, WINDOW_HEIGHT, 1);
+    int result;
+    if (display_server_type == DISPLAY_WAYLAND) result = software_present_init_wayland(&software, wl_display, wl_surface);
+    else if (display_server_type == DISPLAY_X11) result = software_present_init_x11(&software, x_display, x_window);
+    else result = software_present_init_headless(&software);
+    if (result < 0) {
+        fprintf(stderr, "DEBUG: Software presentation failed\n");
+        software_present_free(&software);
+        return -1;
+    }
+    present_init_software(display_server_type == DISPLAY_WAYLAND ? wl_display : NULL,
+                          display_server_type == DISPLAY_WAYLAND ? wl_surface : NULL,
+                          display_server_type == DISPLAY_HEADLESS);
+    return 0;
+}
+
+// Render loop, presenting each frame at its timestamp on the stream clock, with background clearing
 void render_loop() {
     printf("DEBUG: Starting render loop\n");
-    struct timespec start_time, end_time, loop_start_time, loop_end_time;
-    double elapsed, frame_time = FRAME_DURATION;
-    uint8_t* frame;
-
+    struct timespec end_time, loop_start_time, loop_end_time;
+    FrameBuffer* frame;
+    int frame_id = -1;
+    int64_t pts_ns, clock_base_ns = 0;  // Stream time 0 maps to clock_base_ns on CLOCK_MONOTONIC
+    int clock_started = 0, late_drops = 0;
+    int judged_frame_id = -1;  // Held frames come round again; count each frame once
+    uint64_t stage_start, last_swap_ns = 0;
+
+    uint64_t render_cpu_start = stats_thread_cpu_ns();
     clock_gettime(CLOCK_MONOTONIC, &loop_start_time);
     last_fps_time = loop_start_time.tv_sec + loop_start_time.tv_nsec / 1e9;
 
-    glUseProgram(program);
-    GLint pos_attrib = glGetAttribLocation(program, "position");
-    GLint tex_attrib = glGetAttribLocation(program, "texcoord");
-    GLint tex_uniform = glGetUniformLocation(program, "texture");
-    glUniform1i(tex_uniform, 0);
-
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);  // Set background to black for letterboxing
+    GLint pos_attrib = -1, tex_attrib = -1;
+    if (!use_software) {
+        glUseProgram(program);
+        pos_attrib = glGetAttribLocation(program, "position");
+        tex_attrib = glGetAttribLocation(program, "texcoord");
+        GLint tex_uniform = glGetUniformLocation(program, "texture");
+        glUniform1i(tex_uniform, 0);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);  // Set background to black for letterboxing
+    }
 
     while (running) {
-        clock_gettime(CLOCK_MONOTONIC, &start_time);
+        trace_poll();
 
         if (display_server_type == DISPLAY_X11) {
             while (XPending(x_display)) {
                 XEvent xev;
                 XNextEvent(x_display, &xev);
+                if (software_present_handle_event(&software, &xev)) continue;
                 if (xev.type == KeyPress) {
                     printf("DEBUG: Keypress detected, stopping\n");
                     running = 0;
@@ -453,38 +759,127 @@ void render_loop() {
             }
         } else if (display_server_type == DISPLAY_WAYLAND) {
             wl_display_dispatch_pending(wl_display);
-            printf("DEBUG: Wayland events dispatched\n");
+            DEBUG_FRAME("DEBUG: Wayland events dispatched\n");
         }
 
-        int frame_size = get_next_frame(&frame);
+        trace_begin("vsync_wait", frame_id + 1);
+        present_wait();
+        trace_end("vsync_wait", frame_id + 1);
+
+        stage_start = stats_now_ns();
+        trace_begin("queue_wait", frame_id + 1);
+        int frame_size = get_next_frame(&frame, &frame_id, &pts_ns);
+        trace_end("queue_wait", frame_id);
+        stats_record(STAT_QUEUE_WAIT, stats_now_ns() - stage_start);
         if (frame_size < 0) {
             running = 0;
             break;
         }
 
-        glBindTexture(GL_TEXTURE_2D, texture_id);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame_width, frame_height, GL_RGBA, GL_UNSIGNED_BYTE, frame);
-        free(frame);
-        printf("DEBUG: Texture updated\n");
-
-        glClear(GL_COLOR_BUFFER_BIT);  // Clear to black before rendering
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glEnableVertexAttribArray(pos_attrib);
-        glVertexAttribPointer(pos_attrib, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
-        glEnableVertexAttribArray(tex_attrib);
-        glVertexAttribPointer(tex_attrib, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-        glDisableVertexAttribArray(pos_attrib);
-        glDisableVertexAttribArray(tex_attrib);
-        printf("DEBUG: Frame rendered\n");
-
-        eglSwapBuffers(egl_display, egl_surface);
-        printf("DEBUG: Buffers swapped\n");
+        // Presentation clock: anchored at the first frame, re-anchored after a long stall
+        int64_t now = (int64_t)stats_now_ns();
+        if (!clock_started || now - (clock_base_ns + pts_ns) > CLOCK_RESYNC_NS) {
+            if (clock_started) printf("DEBUG: Clock resync, %.1f ms behind\n", (now - clock_base_ns - pts_ns) / 1e6);
+            clock_base_ns = now - pts_ns;
+            clock_started = 1;
+        }
+        // Headless benchmarks run flat out: every frame is due as soon as it is ready
+        int64_t due_ns = display_server_type == DISPLAY_HEADLESS ? now : clock_base_ns + pts_ns;
+        // Under fifo/triple the display paces the loop and nothing sleeps: a
+        // frame is judged against the vblank the next swap reaches, and one
+        // due more than half a refresh after it is held while the previous
+        // frame is shown again. Only mailbox sleeps until the frame's time.
+        int64_t vblank_ns = present_next_vblank_ns();
+        int late = (vblank_ns ? vblank_ns : now) - due_ns > LATE_DROP_NS;
+        if (frame_id != judged_frame_id) {
+            update_decoder_skip(late);
+            judged_frame_id = frame_id;
+        }
+        if (late && late_drops < MAX_LATE_DROPS) {
+            release_frame(frame_id);
+            late_drops++;
+            trace_instant("frame_dropped", frame_id);
+            stats_count(COUNTER_FRAMES_DROPPED);
+            DEBUG_FRAME("DEBUG: Frame %d dropped, %.3f ms late\n", frame_id, (now - due_ns) / 1e6);
+            continue;
+        }
+        late_drops = 0;
+        int repeat = vblank_ns && total_frames > 0 && due_ns - vblank_ns > present.refresh_ns / 2;
+
+        stage_start = stats_now_ns();
+        uint64_t render_start = stage_start;
+        if (!repeat) {
+            PROBE_TEXTURE_UPLOAD(frame_id, frame_width, frame_height);
+            trace_begin("upload", frame_id);
+            if (use_software) {
+                software_present_draw(&software, frame->data);
+            } else if (yuv.format != YUV_NONE) {
+                if (yuv_textures_upload(&yuv, frame->picture) < 0)
+                    DEBUG_FRAME("DEBUG: Frame %d changed pixel format, not uploaded\n", frame_id);
+            } else {
+                texture_stream_upload(&video_stream, frame->data);
+            }
+            trace_end("upload", frame_id);
+            startup_mark(STARTUP_FIRST_UPLOAD);
+            stats_record(STAT_UPLOAD, stats_now_ns() - stage_start);
+            release_frame(frame_id);
+            DEBUG_FRAME("DEBUG: Texture updated\n");
+        }
+
+        if (!use_software) {
+            trace_begin("draw", frame_id);
+            glClear(GL_COLOR_BUFFER_BIT);  // Clear to black before rendering
+            if (scale_filter.kind != SCALE_FILTER_BILINEAR) {
+                scale_filter_draw(&scale_filter, video_stream.textures[video_stream.last], vbo);
+            } else {
+                glBindBuffer(GL_ARRAY_BUFFER, vbo);
+                glEnableVertexAttribArray(pos_attrib);
+                glVertexAttribPointer(pos_attrib, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
+                glEnableVertexAttribArray(tex_attrib);
+                glVertexAttribPointer(tex_attrib, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                glDisableVertexAttribArray(pos_attrib);
+                glDisableVertexAttribArray(tex_attrib);
+            }
+            if (!repeat) texture_stream_fence(&video_stream);
+            uint64_t scale_gpu_ns;
+            if (scale_filter_poll(&scale_filter, &scale_gpu_ns)) stats_record(STAT_SCALE_GPU, scale_gpu_ns);
+            trace_end("draw", frame_id);
+            DEBUG_FRAME("DEBUG: Frame rendered\n");
+        }
+
+        uint64_t wait_start = stats_now_ns();
+        if (!present_is_throttled()) {
+            trace_begin("present_wait", frame_id);
+            wait_until_ns(due_ns);
+            trace_end("present_wait", frame_id);
+        }
+
+        stage_start = stats_now_ns();
+        trace_begin("swap", frame_id);
+        if (use_software) software_present_show(&software);
+        present_swap();
+        trace_end("swap", frame_id);
+        startup_mark(STARTUP_FIRST_SWAP);
+        PROBE_SWAP(frame_id, total_frames + 1);
+        uint64_t swap_done = stats_now_ns();
+        stats_record(STAT_SWAP, swap_done - stage_start);
+        if (repeat) {
+            // Still queued for a later vblank; the frame interval spans the repeats
+            trace_instant("frame_held", frame_id);
+            DEBUG_FRAME("DEBUG: Frame %d held, due %.3f ms after the vblank\n", frame_id, (due_ns - vblank_ns) / 1e6);
+            continue;
+        }
+        if (last_swap_ns) stats_record(STAT_FRAME_INTERVAL, swap_done - last_swap_ns);
+        last_swap_ns = swap_done;
+        stats_record(STAT_PRESENT_LATENESS, (int64_t)swap_done > due_ns ? swap_done - due_ns : 0);
+        stats_busy(STAGE_RENDER, swap_done - render_start - (stage_start - wait_start));
+        stats_count(COUNTER_FRAMES_RENDERED);
+        DEBUG_FRAME("DEBUG: Buffers swapped\n");
 
         frame_count++;
         total_frames++;
         clock_gettime(CLOCK_MONOTONIC, &end_time);
-        elapsed = (end_time.tv_sec - start_time.tv_sec) + (end_time.tv_nsec - start_time.tv_nsec) / 1e9;
 
         double current_time = end_time.tv_sec + end_time.tv_nsec / 1e9;
         if (current_time - last_fps_time >= 1.0) {
@@ -493,13 +888,7 @@ void render_loop() {
             frame_count = 0;
             last_fps_time = current_time;
         }
-
-        if (elapsed < frame_time) {
-            usleep((frame_time - elapsed) * 1e6);
-            printf("DEBUG: Slept for %.3f ms\n", (frame_time - elapsed) * 1000);
-        } else if (elapsed > frame_time * 2) {
-            printf("DEBUG: Frame dropped, took %.3f ms\n", elapsed * 1000);
-        }
+        stats_poll(current_time);
     }
 
     clock_gettime(CLOCK_MONOTONIC, &loop_end_time);
@@ -509,42 +898,55 @@ void render_loop() {
 
     printf("DEBUG: Render loop ended\n");
     printf("DEBUG: Total frames: %d, Total time: %.2f s, Average FPS: %.1f\n", total_frames, total_time, avg_fps);
+    stats_cpu(STAGE_RENDER, stats_thread_cpu_ns() - render_cpu_start);
+    stats_print_summary();
 }
 
 // Cleanup functions
 void cleanup_video_source() {
     printf("DEBUG: Cleaning up video source\n");
-    if (packet) av_packet_free(&packet);
-    if (rgba_frame) av_frame_free(&rgba_frame);
     if (av_frame) av_frame_free(&av_frame);
     if (codec_context) {
         avcodec_close(codec_context);
         avcodec_free_context(&codec_context);
     }
     if (format_context) avformat_close_input(&format_context);
-    if (sws_context) sws_freeContext(sws_context);
-    if (rgb_buffer) av_free(rgb_buffer);
-
-    pthread_mutex_lock(&buffer_mutex);
-    while (frame_buffer_count > 0) {
-        if (frame_buffer[frame_buffer_head].data) {
-            free(frame_buffer[frame_buffer_head].data);
-            frame_buffer[frame_buffer_head].data = NULL;
-        }
-        frame_buffer_head = (frame_buffer_head + 1) % FRAME_BUFFER_SIZE;
-        frame_buffer_count--;
+    slice_convert_free(&converter);
+
+    // Release the frame pool; unreferencing the last queued pictures frees the decoder pool
+    for (int i = 0; i < PACKET_QUEUE_SIZE; i++) {
+        if (packet_queue[i]) av_packet_free(&packet_queue[i]);
     }
-    pthread_mutex_unlock(&buffer_mutex);
+    for (int i = 0; i < DECODED_QUEUE_SIZE; i++) {
+        if (decoded_queue[i].frame) av_frame_free(&decoded_queue[i].frame);
+    }
+    for (int i = 0; i < FRAME_BUFFER_SIZE; i++) {
+        av_free(frame_buffer[i].data);
+        frame_buffer[i].data = NULL;
+        av_frame_free(&frame_buffer[i].picture);
+    }
+    decoder_pool_release();
 }
 
-void cleanup_display() {
-    printf("DEBUG: Cleaning up display\n");
+// Also drops a half-initialized EGL before falling back to software presentation
+void cleanup_egl() {
+    if (display_server_type == DISPLAY_HEADLESS) headless_egl_destroy();
     if (egl_display != EGL_NO_DISPLAY) {
         eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
         if (egl_context != EGL_NO_CONTEXT) eglDestroyContext(egl_display, egl_context);
         if (egl_surface != EGL_NO_SURFACE) eglDestroySurface(egl_display, egl_surface);
         eglTerminate(egl_display);
     }
+    egl_display = EGL_NO_DISPLAY;
+    egl_context = EGL_NO_CONTEXT;
+    egl_surface = EGL_NO_SURFACE;
+}
+
+void cleanup_display() {
+    printf("DEBUG: Cleaning up display\n");
+    present_destroy();
+    software_present_free(&software);
+    cleanup_egl();
     if (display_server_type == DISPLAY_WAYLAND) {
         if (wl_egl_window) wl_egl_window_destroy(wl_egl_window);
         if (shell_surface) wl_shell_surface_destroy(shell_surface);
@@ -562,64 +964,162 @@ void cleanup_display() {
 
 void cleanup_gl() {
     printf("DEBUG: Cleaning up GL\n");
-    if (texture_id) glDeleteTextures(1, &texture_id);
+    texture_stream_free(&video_stream);
+    scale_filter_free(&scale_filter);
+    yuv_textures_free(&yuv);
     if (vbo) glDeleteBuffers(1, &vbo);
     if (program) glDeleteProgram(program);
 }
 
+// Start the demux, decode and convert threads feeding frame_ring
+void start_pipeline() {
+    frame_ring_init(&packet_ring, PACKET_QUEUE_SIZE);
+    frame_ring_init(&decoded_ring, DECODED_QUEUE_SIZE);
+    frame_ring_init(&frame_ring, FRAME_BUFFER_SIZE);
+    pthread_create(&demux_thread, NULL, demux_thread_func, NULL);
+    pthread_create(&decode_thread, NULL, decode_thread_func, NULL);
+    pthread_create(&convert_thread, NULL, convert_thread_func, NULL);
+}
+
+// Stop every stage, including one blocked on a full or empty ring, and wait for it
+void stop_pipeline() {
+    running = 0;
+    publish_output_format();
+    frame_ring_stop(&packet_ring);
+    frame_ring_stop(&decoded_ring);
+    frame_ring_stop(&frame_ring);
+    pthread_join(demux_thread, NULL);
+    pthread_join(decode_thread, NULL);
+    pthread_join(convert_thread, NULL);
+}
+
+// --null-sink: demux, decode and convert as fast as the pipeline allows and
+// discard every frame, with no display or GL at all. Frames always go through
+// the RGBA conversion, even inputs the renderer would upload as YUV, so the
+// fps, per-stage CPU time and peak RSS it reports are the decode+convert
+// cost, the baseline to hold the renderer against; it runs on any machine.
+int run_null_sink() {
+    printf("DEBUG: Null sink, frames are discarded after RGBA conversion\n");
+    FrameBuffer* frame;
+    int frame_id = -1, frames = 0;
+    int64_t pts_ns;
+    uint64_t start_ns = stats_now_ns();
+    start_pipeline();
+    while (get_next_frame(&frame, &frame_id, &pts_ns) >= 0) {
+        release_frame(frame_id);
+        frames++;
+        stats_poll(stats_now_ns() / 1e9);
+    }
+    double seconds = (stats_now_ns() - start_ns) / 1e9;
+    stop_pipeline();
+
+    printf("DEBUG: Null sink: %d frames in %.2f s, %.1f fps\n", frames, seconds, seconds > 0 ? frames / seconds : 0.0);
+    stats_print_summary();
+    cleanup_video_source();
+    printf("DEBUG: Program terminated\n");
+    return EXIT_SUCCESS;
+}
+
+// Startup: open the file and start decoding while main sets up the display
+int probe_result = -1;
+void* probe_thread_func(void* arg) {
+    probe_result = init_mp4_file((const char*)arg);
+    if (probe_result < 0) return NULL;
+    startup_mark(STARTUP_PROBE);
+    start_pipeline();
+    return NULL;
+}
+
 // Main function
 int main(int argc, char *argv[]) {
+    startup_begin();
     printf("DEBUG: Program started\n");
+    trace_init("render");
+    stats_init();
+
+    // --null-sink may come anywhere, the other arguments are positional
+    int null_sink = 0, positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--null-sink") == 0) null_sink = 1;
+        else argv[++positional] = argv[i];
+    }
+    argc = positional + 1;
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s <video_file.mp4>\n", argv[0]);
+        fprintf(stderr, "Usage: %s [--null-sink] <video_file.mp4>\n", argv[0]);
         return EXIT_FAILURE;
     }
 
-    if (init_mp4_file(argv[1]) < 0) {
-        fprintf(stderr, "DEBUG: Failed to open MP4 file\n");
-        return EXIT_FAILURE;
+    if (null_sink) {
+        if (init_mp4_file(argv[1]) < 0 || init_output_format(1) < 0) {
+            fprintf(stderr, "DEBUG: Failed to open MP4 file\n");
+            return EXIT_FAILURE;
+        }
+        return run_null_sink();
     }
 
-    display_server_type = detect_display_server();
-    if (display_server_type == DISPLAY_UNKNOWN) {
-        cleanup_video_source();
-        return EXIT_FAILURE;
-    }
+    // The file is probed and the first frames decoded on probe_thread while
+    // the display, window and EGL come up here; the shaders need both
+    pthread_t probe_thread;
+    pthread_create(&probe_thread, NULL, probe_thread_func, argv[1]);
 
-    if (display_server_type == DISPLAY_WAYLAND) {
-        if (init_wayland() < 0) {
-            cleanup_video_source();
-            return EXIT_FAILURE;
+    display_server_type = detect_display_server();
+    int display_ready = display_server_type != DISPLAY_UNKNOWN;
+    if (display_ready && display_server_type == DISPLAY_WAYLAND) display_ready = init_wayland() == 0;
+    else if (display_ready && display_server_type == DISPLAY_X11) display_ready = init_x11() == 0;
+    if (display_ready) {
+        startup_mark(STARTUP_WINDOW);
+        use_software = software_present_requested();
+        if (!use_software && init_egl() < 0) {
+            fprintf(stderr, "DEBUG: EGL initialization failed, falling back to software presentation\n");
+            cleanup_egl();
+            use_software = 1;
         }
-    } else if (display_server_type == DISPLAY_X11) {
-        if (init_x11() < 0) {
-            cleanup_video_source();
-            return EXIT_FAILURE;
+    }
+    if (display_ready && !use_software) {
+        startup_mark(STARTUP_EGL);
+        if (display_server_type == DISPLAY_HEADLESS) {
+            present_init_offscreen(egl_display);
+        } else {
+            present_init(egl_display, egl_surface, display_server_type == DISPLAY_WAYLAND ? wl_display : NULL,
+                         display_server_type == DISPLAY_WAYLAND ? wl_surface : NULL);
         }
     }
 
-    if (init_egl() < 0) {
-        cleanup_video_source();
+    pthread_join(probe_thread, NULL);
+    if (probe_result < 0) {
+        fprintf(stderr, "DEBUG: Failed to open MP4 file\n");
         cleanup_display();
         return EXIT_FAILURE;
     }
-
-    program = init_shaders();
-    if (!program) {
+    // YUV upload needs the GL path, and software presentation is laid out
+    // for the frame size the probe found
+    if (display_ready && init_output_format(use_software) < 0) display_ready = 0;
+    if (display_ready && use_software) display_ready = init_software() == 0;
+    if (!display_ready) {
+        stop_pipeline();
         cleanup_video_source();
         cleanup_display();
         return EXIT_FAILURE;
     }
 
-    init_geometry();  // Now scales based on frame_width and frame_height
-    init_video_texture();
+    if (!use_software) {
+        program = init_shaders();
+        if (!program) {
+            stop_pipeline();
+            cleanup_video_source();
+            cleanup_display();
+            return EXIT_FAILURE;
+        }
+        startup_mark(STARTUP_SHADERS);
 
-    pthread_create(&decode_thread, NULL, decode_thread_func, NULL);
-    render_loop();
+        init_geometry();  // Now scales based on frame_width and frame_height
+        init_video_texture();
+        startup_mark(STARTUP_TEXTURES);
+    }
 
-    running = 0;
-    pthread_join(decode_thread, NULL);
-    cleanup_gl();
+    render_loop();
+    stop_pipeline();
+    if (!use_software) cleanup_gl();
     cleanup_video_source();
     cleanup_display();
 
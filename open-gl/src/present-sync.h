@@ -0,0 +1,224 @@
+#ifndef PRESENT_SYNC_H
+#define PRESENT_SYNC_H
+
+// Display-driven presentation for the players: swap interval, Wayland frame
+// callbacks and swap-with-damage behind one small API.
+//
+// PRESENT_MODE selects the policy (default fifo):
+//   fifo     Wait for the display before drawing each frame. On Wayland the
+//            swap interval is 0 and the loop blocks on the wl_surface_frame
+//            callback of the previous commit, so nothing else sleeps and the
+//            swap never blocks; on X11 it is eglSwapInterval(1).
+//   triple   eglSwapInterval(1) without waiting first: the driver throttles
+//            inside the next swap, so one frame is drawn while the previous
+//            one is still queued (one more frame of latency, more slack).
+//   mailbox  eglSwapInterval(0): the newest frame replaces a queued one and
+//            the caller paces itself (on X11 without a compositor it tears).
+//
+// fifo and triple also track when the display last took a frame and the
+// refresh period between such vblanks, so the player can match each frame to
+// the vblank it will reach (present_next_vblank_ns) and let the swap pace it.
+//
+// Headless runs (headless-egl.h) use present_init_offscreen instead: there is
+// nothing to present, so a swap only waits for the GPU to finish the frame
+// and the loop runs as fast as the pipeline allows.
+//
+// Software presentation (software-present.h) uses present_init_software: the
+// frame is already attached to the surface, so a swap is the Wayland commit,
+// with the frame callback requested as for fifo; on X11 the put is the
+// present and the caller paces itself as for mailbox.
+//
+// The Wayland path runs unchanged against weston's headless backend, which
+// sends frame callbacks at its repaint rate:
+//   weston --backend=headless-backend.so --socket=wayland-test &
+//   WAYLAND_DISPLAY=wayland-test FRAME_STATS=out.prom ./player video.mp4
+// player_frame_interval_seconds then shows the pacing jitter.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <wayland-client.h>
+
+typedef enum { PRESENT_FIFO, PRESENT_TRIPLE, PRESENT_MAILBOX, PRESENT_OFFSCREEN } PresentMode;
+
+static const char* const present_mode_names[] = {"fifo", "triple", "mailbox", "offscreen"};
+
+typedef struct {
+    PresentMode mode;
+    EGLDisplay display;
+    EGLSurface surface;
+    struct wl_display* wl_display;  // NULL on X11
+    struct wl_surface* wl_surface;
+    struct wl_callback* frame_callback;  // Outstanding wl_surface_frame request
+    PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swap_with_damage;  // NULL without the extension
+    EGLint damage[4];  // x, y, width, height with the origin at the bottom left
+    int has_damage;
+    int swaps;
+    int software;  // No EGL surface, buffers attached by software-present.h
+    int64_t vblank_ns;  // CLOCK_MONOTONIC time the display last took a frame, 0 until then
+    int64_t refresh_ns;  // Estimated refresh period, 0 until two vblanks were seen
+} PresentSync;
+
+static PresentSync present;
+
+// Called when the display has taken a frame: after a blocking swap, or when
+// the Wayland frame callback arrives. An interval over 1.5 periods spans a
+// missed vblank and does not move the estimate.
+static void present_mark_vblank(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t now = (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+    if (present.vblank_ns) {
+        int64_t interval = now - present.vblank_ns;
+        if (!present.refresh_ns) present.refresh_ns = interval;
+        else if (interval < present.refresh_ns * 3 / 2) present.refresh_ns += (interval - present.refresh_ns) / 8;
+    }
+    present.vblank_ns = now;
+}
+
+static void present_frame_done(void* data, struct wl_callback* callback, uint32_t time_ms) {
+    wl_callback_destroy(callback);
+    present.frame_callback = NULL;
+    present_mark_vblank();
+}
+
+static const struct wl_callback_listener present_frame_listener = {present_frame_done};
+
+static int present_has_extension(EGLDisplay display, const char* name) {
+    const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+    size_t length = strlen(name);
+    for (const char* p = extensions; p && (p = strstr(p, name)); p += length) {
+        if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')) return 1;
+    }
+    return 0;
+}
+
+// Call once the EGL surface is current; wl_display/wl_surface are NULL on X11
+static void present_init(EGLDisplay display, EGLSurface surface, struct wl_display* wl_display,
+                         struct wl_surface* wl_surface) {
+    memset(&present, 0, sizeof(present));
+    present.display = display;
+    present.surface = surface;
+    present.wl_display = wl_display;
+    present.wl_surface = wl_surface;
+
+    const char* mode = getenv("PRESENT_MODE");
+    present.mode = PRESENT_FIFO;
+    if (mode && strcmp(mode, "triple") == 0) present.mode = PRESENT_TRIPLE;
+    else if (mode && strcmp(mode, "mailbox") == 0) present.mode = PRESENT_MAILBOX;
+    else if (mode && *mode && strcmp(mode, "fifo") != 0)
+        fprintf(stderr, "DEBUG: Unknown PRESENT_MODE %s, using fifo\n", mode);
+
+    // Wayland fifo throttles on our own frame callback, so EGL must not block as well
+    int interval = (present.mode == PRESENT_MAILBOX || (present.mode == PRESENT_FIFO && wl_display)) ? 0 : 1;
+    if (!eglSwapInterval(display, interval)) fprintf(stderr, "DEBUG: eglSwapInterval(%d) failed\n", interval);
+
+    if (present_has_extension(display, "EGL_KHR_swap_buffers_with_damage"))
+        present.swap_with_damage = (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+    else if (present_has_extension(display, "EGL_EXT_swap_buffers_with_damage"))
+        present.swap_with_damage = (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)eglGetProcAddress("eglSwapBuffersWithDamageEXT");
+
+    printf("DEBUG: Present mode %s, swap interval %d, swap with damage %s\n", present_mode_names[present.mode],
+           interval, present.swap_with_damage ? "yes" : "no");
+}
+
+// Headless counterpart of present_init: no swap interval, no damage
+static void present_init_offscreen(EGLDisplay display) {
+    memset(&present, 0, sizeof(present));
+    present.mode = PRESENT_OFFSCREEN;
+    present.display = display;
+    present.surface = EGL_NO_SURFACE;
+    printf("DEBUG: Present mode %s\n", present_mode_names[present.mode]);
+}
+
+// Software presentation: fifo on Wayland, mailbox on X11, offscreen headless
+static void present_init_software(struct wl_display* wl_display, struct wl_surface* wl_surface, int headless) {
+    memset(&present, 0, sizeof(present));
+    present.software = 1;
+    present.wl_display = wl_display;
+    present.wl_surface = wl_surface;
+    present.mode = headless ? PRESENT_OFFSCREEN : wl_display ? PRESENT_FIFO : PRESENT_MAILBOX;
+    printf("DEBUG: Present mode %s (software)\n", present_mode_names[present.mode]);
+}
+
+// Region that changes from frame to frame (the video quad); the rest of the
+// surface is cleared to the same black every frame
+static void present_set_damage(int x, int y, int width, int height) {
+    present.damage[0] = x;
+    present.damage[1] = y;
+    present.damage[2] = width;
+    present.damage[3] = height;
+    present.has_damage = width > 0 && height > 0;
+}
+
+// True when the caller must not sleep to pace itself: either the display
+// paces the loop, or it is offscreen and meant to run flat out
+static int present_is_throttled(void) {
+    return present.mode != PRESENT_MAILBOX;
+}
+
+// Predicted time of the first vblank still ahead, which the next swap will
+// reach; 0 when the display does not pace the swap or the period is unknown
+static int64_t present_next_vblank_ns(void) {
+    if ((present.mode != PRESENT_FIFO && present.mode != PRESENT_TRIPLE) || !present.refresh_ns) return 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t now = (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+    int64_t next = present.vblank_ns + present.refresh_ns;
+    if (next <= now) next += ((now - next) / present.refresh_ns + 1) * present.refresh_ns;
+    return next;
+}
+
+// Block until the previous frame has been taken by the display (fifo on
+// Wayland); reads the Wayland socket, so nothing spins or oversleeps
+static void present_wait(void) {
+    while (present.frame_callback) {
+        if (wl_display_dispatch(present.wl_display) < 0) {
+            fprintf(stderr, "DEBUG: Wayland connection lost while waiting for frame callback\n");
+            wl_callback_destroy(present.frame_callback);
+            present.frame_callback = NULL;
+        }
+    }
+}
+
+static void present_swap(void) {
+    if (present.software) {
+        if (present.wl_surface) {
+            if (present.mode == PRESENT_FIFO && !present.frame_callback) {
+                present.frame_callback = wl_surface_frame(present.wl_surface);
+                wl_callback_add_listener(present.frame_callback, &present_frame_listener, NULL);
+            }
+            wl_surface_commit(present.wl_surface);
+            wl_display_flush(present.wl_display);
+        }
+        return;
+    }
+    if (present.mode == PRESENT_OFFSCREEN) {
+        // Like a swap into a full queue, returns once the frame's GPU work is done
+        eglWaitClient();
+        return;
+    }
+    if (present.mode == PRESENT_FIFO && present.wl_surface && !present.frame_callback) {
+        // Requested before the swap so it belongs to the commit eglSwapBuffers makes
+        present.frame_callback = wl_surface_frame(present.wl_surface);
+        wl_callback_add_listener(present.frame_callback, &present_frame_listener, NULL);
+    }
+    // The first frame is presented in full so the compositor has every pixel once
+    if (present.swap_with_damage && present.has_damage && present.swaps++ > 0)
+        present.swap_with_damage(present.display, present.surface, present.damage, 1);
+    else
+        eglSwapBuffers(present.display, present.surface);
+    // With swap interval 1 the swap itself returns at a vblank
+    if (present.mode == PRESENT_TRIPLE || (present.mode == PRESENT_FIFO && !present.wl_surface)) present_mark_vblank();
+}
+
+static void present_destroy(void) {
+    if (present.frame_callback) wl_callback_destroy(present.frame_callback);
+    present.frame_callback = NULL;
+}
+
+#endif // PRESENT_SYNC_H
@@ -0,0 +1,193 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+// On-disk cache of linked program binaries (GL_OES_get_program_binary, core
+// in GLES3), so a warm start skips shader compilation and linking.
+//
+//   ProgramCacheEntry entry;
+//   GLuint program = program_cache_load(&entry, "video", vertex_source, fragment_source);
+//   if (!program) {
+//       ... compile, glBindAttribLocation, link ...
+//       program_cache_store(&entry, program);
+//   }
+//
+// Files live in PROGRAM_CACHE_DIR (default $XDG_CACHE_HOME/gl-player or
+// ~/.cache/gl-player), one per program, named by a hash of the GL vendor,
+// renderer and version strings and both shader sources: a driver update or
+// an edited shader gets a new file instead of a stale binary. A binary the
+// driver rejects is deleted and the program compiled as usual.
+// PROGRAM_CACHE=0 turns the cache off.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#define PROGRAM_CACHE_MAGIC 0x43504c47u  // "GLPC"
+
+typedef struct {
+    const char* name;  // For the log
+    uint64_t key;
+    char path[1024];  // Empty when the cache is off or unsupported
+    uint64_t start_ns;
+} ProgramCacheEntry;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t format;  // Driver's binary format enum
+    uint64_t key;  // Repeated in case of a truncated or foreign file
+    uint32_t length;
+    uint32_t reserved;
+} ProgramCacheHeader;
+
+static int program_cache_state = -1;  // -1 not probed yet, 0 off, 1 on
+static PFNGLGETPROGRAMBINARYOESPROC program_cache_get_binary;
+static PFNGLPROGRAMBINARYOESPROC program_cache_program_binary;
+
+static uint64_t program_cache_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// 64-bit FNV-1a, continued from hash; strings are hashed with their terminator
+static uint64_t program_cache_hash(uint64_t hash, const char* text) {
+    if (!text) text = "";
+    do {
+        hash ^= (unsigned char)*text;
+        hash *= 0x100000001b3ull;
+    } while (*text++);
+    return hash;
+}
+
+static int program_cache_directory(char* dir, size_t size) {
+    const char* env = getenv("PROGRAM_CACHE_DIR");
+    if (env && *env) {
+        snprintf(dir, size, "%s", env);
+        return mkdir(dir, 0755) == 0 || errno == EEXIST ? 0 : -1;
+    }
+    const char* base = getenv("XDG_CACHE_HOME");
+    if (base && *base) {
+        snprintf(dir, size, "%s/gl-player", base);
+    } else {
+        const char* home = getenv("HOME");
+        if (!home || !*home) return -1;
+        snprintf(dir, size, "%s/.cache", home);
+        if (mkdir(dir, 0755) < 0 && errno != EEXIST) return -1;
+        snprintf(dir, size, "%s/.cache/gl-player", home);
+    }
+    return mkdir(dir, 0755) == 0 || errno == EEXIST ? 0 : -1;
+}
+
+// Whether the context can save and load binaries; probed once per process
+static int program_cache_enabled(void) {
+    if (program_cache_state >= 0) return program_cache_state;
+    program_cache_state = 0;
+    const char* env = getenv("PROGRAM_CACHE");
+    if (env && strcmp(env, "0") == 0) return 0;
+
+    // GLES3 has the same entry points without the suffix
+    const char* version = (const char*)glGetString(GL_VERSION);
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+    if (extensions && strstr(extensions, "GL_OES_get_program_binary")) {
+        program_cache_get_binary = (PFNGLGETPROGRAMBINARYOESPROC)eglGetProcAddress("glGetProgramBinaryOES");
+        program_cache_program_binary = (PFNGLPROGRAMBINARYOESPROC)eglGetProcAddress("glProgramBinaryOES");
+    } else if (version && strncmp(version, "OpenGL ES 3", 11) == 0) {
+        program_cache_get_binary = (PFNGLGETPROGRAMBINARYOESPROC)eglGetProcAddress("glGetProgramBinary");
+        program_cache_program_binary = (PFNGLPROGRAMBINARYOESPROC)eglGetProcAddress("glProgramBinary");
+    }
+    GLint formats = 0;
+    if (program_cache_get_binary && program_cache_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+    if (formats > 0) program_cache_state = 1;
+    else printf("DEBUG: Program binaries not supported, shaders compile on every start\n");
+    return program_cache_state;
+}
+
+// Program linked from the cached binary for these sources, or 0 (then build
+// the program and hand it to program_cache_store); starts the startup clock
+static GLuint program_cache_load(ProgramCacheEntry* entry, const char* name, const char* vertex_source,
+                                 const char* fragment_source) {
+    memset(entry, 0, sizeof(*entry));
+    entry->name = name;
+    entry->start_ns = program_cache_now_ns();
+    if (!program_cache_enabled()) return 0;
+
+    uint64_t key = 0xcbf29ce484222325ull;
+    key = program_cache_hash(key, (const char*)glGetString(GL_VENDOR));
+    key = program_cache_hash(key, (const char*)glGetString(GL_RENDERER));
+    key = program_cache_hash(key, (const char*)glGetString(GL_VERSION));
+    key = program_cache_hash(key, vertex_source);
+    key = program_cache_hash(key, fragment_source);
+    entry->key = key;
+    char dir[960];
+    if (program_cache_directory(dir, sizeof(dir)) < 0) return 0;
+    snprintf(entry->path, sizeof(entry->path), "%s/%016llx.bin", dir, (unsigned long long)key);
+
+    FILE* file = fopen(entry->path, "rb");
+    if (!file) return 0;
+    ProgramCacheHeader header;
+    void* binary = NULL;
+    int valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == PROGRAM_CACHE_MAGIC &&
+                header.key == key && header.length > 0 && (binary = malloc(header.length)) != NULL &&
+                fread(binary, header.length, 1, file) == 1;
+    fclose(file);
+
+    GLuint program = 0;
+    if (valid) {
+        program = glCreateProgram();
+        program_cache_program_binary(program, header.format, binary, header.length);
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    free(binary);
+    if (!program) {
+        fprintf(stderr, "DEBUG: Cached program %s rejected, recompiling\n", entry->path);
+        unlink(entry->path);
+        return 0;
+    }
+    printf("DEBUG: Program %s: warm start, binary loaded in %.2f ms\n", name,
+           (program_cache_now_ns() - entry->start_ns) / 1e6);
+    return program;
+}
+
+// Save the freshly linked program under the entry's key and log the cold start time
+static void program_cache_store(ProgramCacheEntry* entry, GLuint program) {
+    double cold_ms = (program_cache_now_ns() - entry->start_ns) / 1e6;
+    if (!entry->path[0] || !program) {
+        printf("DEBUG: Program %s: cold start, compiled and linked in %.2f ms\n", entry->name, cold_ms);
+        return;
+    }
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    void* binary = length > 0 ? malloc(length) : NULL;
+    ProgramCacheHeader header = {PROGRAM_CACHE_MAGIC, 0, entry->key, 0, 0};
+    GLsizei written = 0;
+    if (binary) program_cache_get_binary(program, length, &written, &header.format, binary);
+    header.length = written;
+
+    // Written aside and renamed, so a concurrent start never reads half a file
+    char temp[1040];
+    snprintf(temp, sizeof(temp), "%s.%d", entry->path, (int)getpid());
+    FILE* file = written > 0 ? fopen(temp, "wb") : NULL;
+    int saved = file && fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary, written, 1, file) == 1;
+    if (file && fclose(file) != 0) saved = 0;
+    if (saved && rename(temp, entry->path) != 0) saved = 0;
+    if (file && !saved) unlink(temp);
+    free(binary);
+    printf("DEBUG: Program %s: cold start, compiled and linked in %.2f ms%s%s\n", entry->name, cold_ms,
+           saved ? ", cached to " : ", not cached", saved ? entry->path : "");
+}
+
+#endif // PROGRAM_CACHE_H
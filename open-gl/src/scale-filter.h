@@ -0,0 +1,337 @@
+#ifndef SCALE_FILTER_H
+#define SCALE_FILTER_H
+
+// Separable bicubic and Lanczos scaling in two passes, for GPU output that
+// matches the CPU scalers instead of plain GL_LINEAR sampling.
+//
+// SCALE_FILTER selects the filter (default bilinear, which skips all this):
+//   bicubic  Catmull-Rom (a = -0.5), the kernel of multi-core/scalers.h. Its
+//            two inner weights are positive, so one bilinear fetch at the
+//            weighted position between them replaces two texel fetches:
+//            3 fetches per pass instead of 4.
+//   lanczos  Lanczos-3, its support widened by the downscale factor (up to
+//            SCALE_FILTER_MAX_RADIUS texels) so shrinking does not alias.
+//
+// The first pass filters horizontally from the source texture into an
+// intermediate dst_width x src_height texture; the second filters that
+// vertically into whatever framebuffer was bound, with the caller's quad.
+// Both passes sit inside one GL_EXT_disjoint_timer_query, polled without
+// blocking a few frames later.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+#include "program-cache.h"
+
+#define SCALE_FILTER_MAX_RADIUS 8  // Texels each side; Lanczos-3 down to 3/8 scale
+#define SCALE_FILTER_QUERIES 4  // Timer queries in flight
+
+typedef enum { SCALE_FILTER_BILINEAR, SCALE_FILTER_BICUBIC, SCALE_FILTER_LANCZOS } ScaleFilterKind;
+
+static const char* const scale_filter_names[] = {"bilinear", "bicubic", "lanczos"};
+
+typedef struct {
+    ScaleFilterKind kind;  // SCALE_FILTER_BILINEAR: not initialized, draw the usual way
+    GLuint program;
+    int owns_program;  // 0 when shared from another ScaleFilter
+    GLint source_uniform, size_uniform, direction_uniform, support_uniform;
+    GLuint quad_vbo;  // Fullscreen quad for the horizontal pass
+    GLuint intermediate, framebuffer;
+    int src_width, src_height, dst_width, dst_height;
+    int timed;  // Cleared by callers that already time the draw
+    GLuint queries[SCALE_FILTER_QUERIES];
+    int query_next, query_pending;  // Ring of issued queries, oldest at query_next - query_pending
+    int query_results;  // Results read so far; the first one is dropped (garbage on some drivers)
+    PFNGLGENQUERIESEXTPROC gen_queries;  // NULL without GL_EXT_disjoint_timer_query
+    PFNGLDELETEQUERIESEXTPROC delete_queries;
+    PFNGLBEGINQUERYEXTPROC begin_query;
+    PFNGLENDQUERYEXTPROC end_query;
+    PFNGLGETQUERYOBJECTUIVEXTPROC get_query_uiv;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC get_query_u64;
+} ScaleFilter;
+
+static const char* const scale_filter_vertex_shader =
+    "attribute vec3 position;\n"
+    "attribute vec2 texcoord;\n"
+    "varying vec2 v_texcoord;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(position, 1.0);\n"
+    "  v_texcoord = texcoord;\n"
+    "}\n";
+
+// Common part of both passes: coord is the output position in source texels
+// along direction, base the texel centre at or left of it
+static const char* const scale_filter_fragment_header =
+    "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+    "precision highp float;\n"
+    "#else\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "varying vec2 v_texcoord;\n"
+    "uniform sampler2D source;\n"
+    "uniform vec2 source_size;\n"
+    "uniform vec2 direction;\n"
+    "uniform float support;\n"
+    "vec4 fetch(float texel) {\n"
+    "  vec2 along = direction * (texel + 0.5) / source_size;\n"
+    "  return texture2D(source, along + v_texcoord * (1.0 - direction));\n"
+    "}\n";
+
+static const char* const scale_filter_fragment_bicubic =
+    "void main() {\n"
+    "  float coord = dot(v_texcoord * source_size, direction) - 0.5;\n"
+    "  float base = floor(coord);\n"
+    "  float f = coord - base;\n"
+    "  float w0 = f * (-0.5 + f * (1.0 - 0.5 * f));\n"
+    "  float w1 = 1.0 + f * f * (-2.5 + 1.5 * f);\n"
+    "  float w2 = f * (0.5 + f * (2.0 - 1.5 * f));\n"
+    "  float w3 = f * f * (-0.5 + 0.5 * f);\n"
+    "  float w12 = w1 + w2;\n"
+    "  gl_FragColor = fetch(base - 1.0) * w0 + fetch(base + w2 / w12) * w12 + fetch(base + 2.0) * w3;\n"
+    "}\n";
+
+static const char* const scale_filter_fragment_lanczos =
+    "const float PI = 3.14159265;\n"
+    "float lanczos(float x) {\n"
+    "  if (abs(x) < 1e-4) return 1.0;\n"
+    "  if (abs(x) >= 3.0) return 0.0;\n"
+    "  float px = PI * x;\n"
+    "  return 3.0 * sin(px) * sin(px / 3.0) / (px * px);\n"
+    "}\n"
+    "void main() {\n"
+    "  float coord = dot(v_texcoord * source_size, direction) - 0.5;\n"
+    "  float base = floor(coord);\n"
+    "  float radius = ceil(3.0 * support);\n"
+    "  vec4 sum = vec4(0.0);\n"
+    "  float weight_sum = 0.0;\n"
+    "  for (int i = -SCALE_FILTER_MAX_RADIUS + 1; i <= SCALE_FILTER_MAX_RADIUS; i++) {\n"
+    "    float texel = base + float(i);\n"
+    "    if (abs(texel - coord) > radius) continue;\n"
+    "    float weight = lanczos((texel - coord) / support);\n"
+    "    sum += fetch(texel) * weight;\n"
+    "    weight_sum += weight;\n"
+    "  }\n"
+    "  gl_FragColor = sum / weight_sum;\n"
+    "}\n";
+
+// Filter called name, -1 when there is none
+static int scale_filter_parse(const char* name) {
+    for (int i = 0; i < 3; i++)
+        if (strcmp(name, scale_filter_names[i]) == 0) return i;
+    return -1;
+}
+
+// Filter named by SCALE_FILTER, SCALE_FILTER_BILINEAR when unset or unknown
+static ScaleFilterKind scale_filter_requested(void) {
+    const char* env = getenv("SCALE_FILTER");
+    if (!env || !*env) return SCALE_FILTER_BILINEAR;
+    int kind = scale_filter_parse(env);
+    if (kind >= 0) return (ScaleFilterKind)kind;
+    fprintf(stderr, "DEBUG: Unknown SCALE_FILTER %s, using bilinear\n", env);
+    return SCALE_FILTER_BILINEAR;
+}
+
+static GLuint scale_filter_compile(GLenum type, const char* const* sources, int count) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, count, sources, NULL);
+    glCompileShader(shader);
+    GLint compiled;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char log[512];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "DEBUG: Scale filter shader compilation failed: %s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+static GLuint scale_filter_program(ScaleFilterKind kind) {
+    // One string, which is also what the program cache hashes
+    char fragment[4096];
+    snprintf(fragment, sizeof(fragment), "#define SCALE_FILTER_MAX_RADIUS %d\n%s%s", SCALE_FILTER_MAX_RADIUS,
+             scale_filter_fragment_header,
+             kind == SCALE_FILTER_LANCZOS ? scale_filter_fragment_lanczos : scale_filter_fragment_bicubic);
+    const char* fragment_source = fragment;
+    ProgramCacheEntry cache_entry;
+    GLuint program = program_cache_load(&cache_entry, scale_filter_names[kind], scale_filter_vertex_shader,
+                                        fragment_source);
+    if (program) return program;
+    GLuint vertex_shader = scale_filter_compile(GL_VERTEX_SHADER, &scale_filter_vertex_shader, 1);
+    GLuint fragment_shader = scale_filter_compile(GL_FRAGMENT_SHADER, &fragment_source, 1);
+    if (vertex_shader && fragment_shader) {
+        program = glCreateProgram();
+        glAttachShader(program, vertex_shader);
+        glAttachShader(program, fragment_shader);
+        glBindAttribLocation(program, 0, "position");
+        glBindAttribLocation(program, 1, "texcoord");
+        glLinkProgram(program);
+        GLint linked;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            fprintf(stderr, "DEBUG: Scale filter program linking failed\n");
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    if (vertex_shader) glDeleteShader(vertex_shader);
+    if (fragment_shader) glDeleteShader(fragment_shader);
+    if (program) program_cache_store(&cache_entry, program);
+    return program;
+}
+
+// Build the filter's program, or take it from share (same kind) to scale a
+// second size; kind stays SCALE_FILTER_BILINEAR and -1 is returned on failure
+static int scale_filter_init(ScaleFilter* sf, ScaleFilterKind kind, const ScaleFilter* share) {
+    memset(sf, 0, sizeof(*sf));
+    if (kind == SCALE_FILTER_BILINEAR) return 0;
+    if (share) {
+        sf->program = share->program;
+    } else {
+        sf->program = scale_filter_program(kind);
+        sf->owns_program = 1;
+    }
+    if (!sf->program) return -1;
+    sf->source_uniform = glGetUniformLocation(sf->program, "source");
+    sf->size_uniform = glGetUniformLocation(sf->program, "source_size");
+    sf->direction_uniform = glGetUniformLocation(sf->program, "direction");
+    sf->support_uniform = glGetUniformLocation(sf->program, "support");
+
+    static const float quad[] = {
+        -1.0f, -1.0f, 0.0f,  0.0f, 0.0f,
+         1.0f, -1.0f, 0.0f,  1.0f, 0.0f,
+        -1.0f,  1.0f, 0.0f,  0.0f, 1.0f,
+         1.0f,  1.0f, 0.0f,  1.0f, 1.0f
+    };
+    glGenBuffers(1, &sf->quad_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, sf->quad_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+    if (extensions && strstr(extensions, "GL_EXT_disjoint_timer_query")) {
+        sf->gen_queries = (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+        sf->delete_queries = (PFNGLDELETEQUERIESEXTPROC)eglGetProcAddress("glDeleteQueriesEXT");
+        sf->begin_query = (PFNGLBEGINQUERYEXTPROC)eglGetProcAddress("glBeginQueryEXT");
+        sf->end_query = (PFNGLENDQUERYEXTPROC)eglGetProcAddress("glEndQueryEXT");
+        sf->get_query_uiv = (PFNGLGETQUERYOBJECTUIVEXTPROC)eglGetProcAddress("glGetQueryObjectuivEXT");
+        sf->get_query_u64 = (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress("glGetQueryObjectui64vEXT");
+        if (sf->delete_queries && sf->begin_query && sf->end_query && sf->get_query_uiv && sf->get_query_u64)
+            sf->gen_queries(SCALE_FILTER_QUERIES, sf->queries);
+        else
+            sf->gen_queries = NULL;
+    }
+    sf->timed = sf->gen_queries != NULL;
+    sf->kind = kind;
+    return 0;
+}
+
+// Size the intermediate texture for scaling src to dst pixels
+static void scale_filter_resize(ScaleFilter* sf, int src_width, int src_height, int dst_width, int dst_height) {
+    if (sf->kind == SCALE_FILTER_BILINEAR) return;
+    sf->src_width = src_width;
+    sf->src_height = src_height;
+    sf->dst_width = dst_width;
+    sf->dst_height = dst_height;
+    if (!sf->intermediate) {
+        glGenTextures(1, &sf->intermediate);
+        glGenFramebuffers(1, &sf->framebuffer);
+    }
+    GLint previous;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    glBindTexture(GL_TEXTURE_2D, sf->intermediate);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dst_width, src_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindFramebuffer(GL_FRAMEBUFFER, sf->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sf->intermediate, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "DEBUG: Scale filter framebuffer incomplete, using bilinear\n");
+        sf->kind = SCALE_FILTER_BILINEAR;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+    printf("DEBUG: Scale filter %s, %dx%d to %dx%d in two passes, GPU timer %s\n", scale_filter_names[sf->kind],
+           src_width, src_height, dst_width, dst_height, sf->timed ? "yes" : "no");
+}
+
+static void scale_filter_pass(ScaleFilter* sf, GLuint source, GLuint vbo, float dx, float width, float height,
+                              float scale) {
+    glBindTexture(GL_TEXTURE_2D, source);
+    glUniform2f(sf->size_uniform, width, height);
+    glUniform2f(sf->direction_uniform, dx, 1.0f - dx);
+    // Lanczos widens its support when shrinking; Catmull-Rom stays at 2 texels like the CPU scaler
+    glUniform1f(sf->support_uniform, scale > 1.0f ? scale : 1.0f);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+// Scale source into the bound framebuffer through vbo (position xyz,
+// texcoord st), on texture unit 0; leaves the filter's program in use
+static void scale_filter_draw(ScaleFilter* sf, GLuint source, GLuint vbo) {
+    GLint framebuffer, viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    int timing = sf->timed && sf->query_pending < SCALE_FILTER_QUERIES;
+    if (timing) sf->begin_query(GL_TIME_ELAPSED_EXT, sf->queries[sf->query_next]);
+
+    glUseProgram(sf->program);
+    glUniform1i(sf->source_uniform, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, sf->framebuffer);
+    glViewport(0, 0, sf->dst_width, sf->src_height);
+    scale_filter_pass(sf, source, sf->quad_vbo, 1.0f, sf->src_width, sf->src_height,
+                      (float)sf->src_width / sf->dst_width);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    scale_filter_pass(sf, sf->intermediate, vbo, 0.0f, sf->dst_width, sf->src_height,
+                      (float)sf->src_height / sf->dst_height);
+
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    if (timing) {
+        sf->end_query(GL_TIME_ELAPSED_EXT);
+        sf->query_next = (sf->query_next + 1) % SCALE_FILTER_QUERIES;
+        sf->query_pending++;
+    }
+}
+
+// GPU time of the oldest finished draw; 0 when none is ready yet (never blocks)
+static int scale_filter_poll(ScaleFilter* sf, uint64_t* gpu_ns) {
+    if (!sf->query_pending) return 0;
+    GLuint query = sf->queries[(sf->query_next - sf->query_pending + SCALE_FILTER_QUERIES) % SCALE_FILTER_QUERIES];
+    GLuint available = 0;
+    sf->get_query_uiv(query, GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+    if (!available) return 0;
+    GLuint64 elapsed = 0;
+    GLint disjoint = 0;
+    sf->get_query_u64(query, GL_QUERY_RESULT_EXT, &elapsed);
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    sf->query_pending--;
+    if (disjoint || sf->query_results++ == 0) return scale_filter_poll(sf, gpu_ns);
+    *gpu_ns = elapsed;
+    return 1;
+}
+
+static void scale_filter_free(ScaleFilter* sf) {
+    if (sf->intermediate) glDeleteTextures(1, &sf->intermediate);
+    if (sf->framebuffer) glDeleteFramebuffers(1, &sf->framebuffer);
+    if (sf->quad_vbo) glDeleteBuffers(1, &sf->quad_vbo);
+    if (sf->gen_queries) sf->delete_queries(SCALE_FILTER_QUERIES, sf->queries);
+    if (sf->owns_program && sf->program) glDeleteProgram(sf->program);
+    memset(sf, 0, sizeof(*sf));
+}
+
+#endif // SCALE_FILTER_H
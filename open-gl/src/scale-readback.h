@@ -0,0 +1,316 @@
+#ifndef SCALE_READBACK_H
+#define SCALE_READBACK_H
+
+// Offline GPU scaling with asynchronous readback, for using the GPU as a
+// scaling coprocessor in batch jobs.
+//
+// Each frame is drawn into one of SCALE_INFLIGHT render targets (default 3)
+// and its readback is queued right behind the draw: on GLES3 glReadPixels
+// into that slot's pixel pack buffer, which returns without waiting for the
+// GPU. A fence marks when the slot's pixels are ready; the slot is retired
+// (fence wait, map, copy out) only when it comes round again, so up to
+// SCALE_INFLIGHT frames are on the GPU while the CPU queues the next one.
+// GLES2 has no pack buffers: the ring of render targets still decouples the
+// frames, and the glReadPixels done at retire time finds its frame finished.
+// The GLES3 calls go through eglGetProcAddress, so nothing links against
+// entry points a GLES2-only libGLESv2 does not export.
+//
+// With GL_EXT_disjoint_timer_query each draw is bracketed by a
+// GL_TIME_ELAPSED query, read back at retire time without stalling; the
+// report gives wall-clock throughput next to the GPU time per frame.
+//
+//   for each frame:
+//     scale_readback_begin(&rb);  // retires the slot, binds its framebuffer
+//     ... upload and draw ...
+//     scale_readback_end(&rb);    // queues the readback and the fence
+//   scale_readback_drain(&rb);    // rb.output holds the last frame
+//
+// A consumer that wants every frame sets rb.sink, which is called at retire
+// time with the pixels in place (the mapped PBO), instead of the copy into
+// rb.output.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+#define SCALE_READBACK_MAX 8
+#define SCALE_READBACK_DEFAULT 3
+#define SCALE_READBACK_WAIT_NS 1000000000ull  // Give up on a fence after a second (lost GPU)
+
+typedef struct {
+    int depth;  // Frames in flight
+    int width, height;
+    size_t size;  // Bytes per RGBA frame
+    int use_pbo;  // GLES3 context with the entry points below
+    GLuint framebuffers[SCALE_READBACK_MAX];
+    GLuint textures[SCALE_READBACK_MAX];
+    GLuint pbos[SCALE_READBACK_MAX];
+    GLsync gl_fences[SCALE_READBACK_MAX];
+    EGLSyncKHR egl_fences[SCALE_READBACK_MAX];
+    GLuint queries[SCALE_READBACK_MAX];
+    int frames[SCALE_READBACK_MAX];  // Frame in the slot, -1 when free
+    uint64_t submit_ns[SCALE_READBACK_MAX];
+    int submitted, retired;
+
+    unsigned char* output;  // Pixels of the last retired frame, unless sink is set
+    void (*sink)(void* data, int frame, const unsigned char* pixels);  // Pixels valid during the call
+    void* sink_data;
+    int capacity;  // Frames with room for a sample below
+    double* gpu_seconds;  // Per frame, -1 where no timer result (always frame 0)
+    double* latency_seconds;  // Submit to pixels in memory
+
+    PFNGLFENCESYNCPROC fence_sync;  // GLES3 only
+    PFNGLCLIENTWAITSYNCPROC gl_client_wait_sync;
+    PFNGLDELETESYNCPROC delete_sync;
+    PFNGLMAPBUFFERRANGEPROC map_buffer_range;
+    PFNGLUNMAPBUFFERPROC unmap_buffer;
+    EGLDisplay egl_display;
+    PFNEGLCREATESYNCKHRPROC create_sync;  // NULL without EGL_KHR_fence_sync
+    PFNEGLCLIENTWAITSYNCKHRPROC client_wait_sync;
+    PFNEGLDESTROYSYNCKHRPROC destroy_sync;
+    PFNGLGENQUERIESEXTPROC gen_queries;  // NULL without GL_EXT_disjoint_timer_query
+    PFNGLDELETEQUERIESEXTPROC delete_queries;
+    PFNGLBEGINQUERYEXTPROC begin_query;
+    PFNGLENDQUERYEXTPROC end_query;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC get_query_u64;
+} ScaleReadback;
+
+static uint64_t scale_readback_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int scale_readback_has_extension(const char* extensions, const char* name) {
+    size_t length = strlen(name);
+    for (const char* p = extensions; p && (p = strstr(p, name)); p += length) {
+        if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')) return 1;
+    }
+    return 0;
+}
+
+// Create the render targets for width x height RGBA output and room for
+// frames timing samples (0 for none); needs a current context. Returns -1
+// on failure. Set sink afterwards
+static int scale_readback_init(ScaleReadback* rb, int width, int height, int frames) {
+    memset(rb, 0, sizeof(*rb));
+    const char* env = getenv("SCALE_INFLIGHT");
+    rb->depth = env ? atoi(env) : SCALE_READBACK_DEFAULT;
+    if (rb->depth < 1) rb->depth = 1;
+    if (rb->depth > SCALE_READBACK_MAX) rb->depth = SCALE_READBACK_MAX;
+    rb->width = width;
+    rb->height = height;
+    rb->size = (size_t)width * height * 4;
+    rb->capacity = frames;
+    rb->output = (unsigned char*)calloc(1, rb->size);
+    rb->gpu_seconds = (double*)malloc(frames * sizeof(double));
+    rb->latency_seconds = (double*)malloc(frames * sizeof(double));
+    if (!rb->output || (frames > 0 && (!rb->gpu_seconds || !rb->latency_seconds))) return -1;
+    for (int i = 0; i < frames; i++) rb->gpu_seconds[i] = rb->latency_seconds[i] = -1.0;
+
+    const char* version = (const char*)glGetString(GL_VERSION);
+    if (version && strncmp(version, "OpenGL ES 3", 11) == 0) {
+        rb->fence_sync = (PFNGLFENCESYNCPROC)eglGetProcAddress("glFenceSync");
+        rb->gl_client_wait_sync = (PFNGLCLIENTWAITSYNCPROC)eglGetProcAddress("glClientWaitSync");
+        rb->delete_sync = (PFNGLDELETESYNCPROC)eglGetProcAddress("glDeleteSync");
+        rb->map_buffer_range = (PFNGLMAPBUFFERRANGEPROC)eglGetProcAddress("glMapBufferRange");
+        rb->unmap_buffer = (PFNGLUNMAPBUFFERPROC)eglGetProcAddress("glUnmapBuffer");
+        rb->use_pbo = rb->fence_sync && rb->gl_client_wait_sync && rb->delete_sync && rb->map_buffer_range &&
+                      rb->unmap_buffer;
+    }
+    if (!rb->use_pbo) {
+        rb->egl_display = eglGetCurrentDisplay();
+        if (scale_readback_has_extension(eglQueryString(rb->egl_display, EGL_EXTENSIONS), "EGL_KHR_fence_sync")) {
+            rb->create_sync = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+            rb->client_wait_sync = (PFNEGLCLIENTWAITSYNCKHRPROC)eglGetProcAddress("eglClientWaitSyncKHR");
+            rb->destroy_sync = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+            if (!rb->client_wait_sync || !rb->destroy_sync) rb->create_sync = NULL;
+        }
+    }
+    if (scale_readback_has_extension((const char*)glGetString(GL_EXTENSIONS), "GL_EXT_disjoint_timer_query")) {
+        rb->gen_queries = (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+        rb->delete_queries = (PFNGLDELETEQUERIESEXTPROC)eglGetProcAddress("glDeleteQueriesEXT");
+        rb->begin_query = (PFNGLBEGINQUERYEXTPROC)eglGetProcAddress("glBeginQueryEXT");
+        rb->end_query = (PFNGLENDQUERYEXTPROC)eglGetProcAddress("glEndQueryEXT");
+        rb->get_query_u64 = (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress("glGetQueryObjectui64vEXT");
+        if (!rb->delete_queries || !rb->begin_query || !rb->end_query || !rb->get_query_u64) rb->gen_queries = NULL;
+    }
+
+    glGenFramebuffers(rb->depth, rb->framebuffers);
+    glGenTextures(rb->depth, rb->textures);
+    for (int i = 0; i < rb->depth; i++) {
+        glBindTexture(GL_TEXTURE_2D, rb->textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, rb->framebuffers[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, rb->textures[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            fprintf(stderr, "Readback framebuffer %d is not complete\n", i);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return -1;
+        }
+        rb->frames[i] = -1;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (rb->use_pbo) {
+        glGenBuffers(rb->depth, rb->pbos);
+        for (int i = 0; i < rb->depth; i++) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbos[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, rb->size, NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    if (rb->gen_queries) rb->gen_queries(rb->depth, rb->queries);
+
+    printf("Readback ring: %d frames in flight, %s, %s fences, GPU timer %s\n", rb->depth,
+           rb->use_pbo ? "PBO readback" : "glReadPixels at retire",
+           rb->use_pbo ? "GL" : rb->create_sync ? "EGL" : "no", rb->gen_queries ? "yes" : "no");
+    return 0;
+}
+
+// Wait for the slot's frame and copy its pixels to rb->output
+static void scale_readback_retire(ScaleReadback* rb, int slot) {
+    int frame = rb->frames[slot];
+    if (frame < 0) return;
+
+    if (rb->gl_fences[slot]) {
+        rb->gl_client_wait_sync(rb->gl_fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, SCALE_READBACK_WAIT_NS);
+        rb->delete_sync(rb->gl_fences[slot]);
+        rb->gl_fences[slot] = 0;
+    }
+    if (rb->egl_fences[slot]) {
+        rb->client_wait_sync(rb->egl_display, rb->egl_fences[slot], EGL_SYNC_FLUSH_COMMANDS_BIT_KHR,
+                             SCALE_READBACK_WAIT_NS);
+        rb->destroy_sync(rb->egl_display, rb->egl_fences[slot]);
+        rb->egl_fences[slot] = EGL_NO_SYNC_KHR;
+    }
+
+    if (rb->use_pbo) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbos[slot]);
+        void* mapped = rb->map_buffer_range(GL_PIXEL_PACK_BUFFER, 0, rb->size, GL_MAP_READ_BIT);
+        if (mapped) {
+            if (rb->sink) rb->sink(rb->sink_data, frame, (const unsigned char*)mapped);
+            else memcpy(rb->output, mapped, rb->size);
+            rb->unmap_buffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    } else {
+        GLint previous;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+        glBindFramebuffer(GL_FRAMEBUFFER, rb->framebuffers[slot]);
+        glReadPixels(0, 0, rb->width, rb->height, GL_RGBA, GL_UNSIGNED_BYTE, rb->output);
+        glBindFramebuffer(GL_FRAMEBUFFER, previous);
+        if (rb->sink) rb->sink(rb->sink_data, frame, rb->output);
+    }
+
+    if (frame < rb->capacity) {
+        rb->latency_seconds[frame] = (scale_readback_now_ns() - rb->submit_ns[slot]) / 1e9;
+        if (rb->gen_queries && frame > 0) {
+            // The fence has passed, so the result is available without blocking;
+            // frame 0 is warm-up (and its first query is garbage on some drivers)
+            GLuint64 elapsed = 0;
+            GLint disjoint = 0;
+            rb->get_query_u64(rb->queries[slot], GL_QUERY_RESULT_EXT, &elapsed);
+            glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+            if (!disjoint) rb->gpu_seconds[frame] = elapsed / 1e9;
+        }
+    }
+    rb->frames[slot] = -1;
+    rb->retired++;
+}
+
+// Bind the next slot's framebuffer for drawing, retiring its previous frame
+// first; returns the framebuffer
+static GLuint scale_readback_begin(ScaleReadback* rb) {
+    int slot = rb->submitted % rb->depth;
+    scale_readback_retire(rb, slot);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, rb->framebuffers[slot]);
+    glViewport(0, 0, rb->width, rb->height);
+    rb->submit_ns[slot] = scale_readback_now_ns();
+    if (rb->gen_queries) rb->begin_query(GL_TIME_ELAPSED_EXT, rb->queries[slot]);
+    return rb->framebuffers[slot];
+}
+
+// Queue the readback of the frame drawn since scale_readback_begin
+static void scale_readback_end(ScaleReadback* rb) {
+    int slot = rb->submitted % rb->depth;
+    if (rb->gen_queries) rb->end_query(GL_TIME_ELAPSED_EXT);
+
+    if (rb->use_pbo) {
+        glBindFramebuffer(GL_FRAMEBUFFER, rb->framebuffers[slot]);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbos[slot]);
+        glReadPixels(0, 0, rb->width, rb->height, GL_RGBA, GL_UNSIGNED_BYTE, 0);  // Offset 0 into the PBO
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        rb->gl_fences[slot] = rb->fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    } else if (rb->create_sync) {
+        rb->egl_fences[slot] = rb->create_sync(rb->egl_display, EGL_SYNC_FENCE_KHR, NULL);
+    }
+    // Submit now rather than at the next retire, so the GPU starts on it
+    glFlush();
+    rb->frames[slot] = rb->submitted++;
+}
+
+// Retire every frame still in flight, oldest first
+static void scale_readback_drain(ScaleReadback* rb) {
+    for (int i = 0; i < rb->depth; i++) scale_readback_retire(rb, (rb->submitted + i) % rb->depth);
+}
+
+static int scale_readback_compare(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Median and maximum of the samples that were recorded (>= 0)
+static int scale_readback_summary(const double* samples, int count, double* median, double* max) {
+    double* sorted = (double*)malloc(count * sizeof(double));
+    int n = 0;
+    for (int i = 0; sorted && i < count; i++)
+        if (samples[i] >= 0) sorted[n++] = samples[i];
+    if (n > 0) {
+        qsort(sorted, n, sizeof(double), scale_readback_compare);
+        *median = sorted[n / 2];
+        *max = sorted[n - 1];
+    }
+    free(sorted);
+    return n;
+}
+
+static void scale_readback_report(const ScaleReadback* rb, double wall_seconds) {
+    int frames = rb->retired < rb->capacity ? rb->retired : rb->capacity;
+    double median, max;
+    printf("Batch scaling: %d frames in %.3f s wall clock, %.1f frames/s, %.1f MB/s read back\n", rb->retired,
+           wall_seconds, rb->retired / wall_seconds, rb->retired * (double)rb->size / wall_seconds / 1e6);
+    if (scale_readback_summary(rb->latency_seconds, frames, &median, &max) > 0)
+        printf("Frame latency (submit to pixels): p50 %.3f ms, max %.3f ms\n", median * 1e3, max * 1e3);
+    if (scale_readback_summary(rb->gpu_seconds, frames, &median, &max) > 0)
+        printf("GPU time per frame: p50 %.3f ms, max %.3f ms\n", median * 1e3, max * 1e3);
+    else
+        printf("GPU time per frame: not available (no GL_EXT_disjoint_timer_query)\n");
+}
+
+static void scale_readback_free(ScaleReadback* rb) {
+    for (int i = 0; i < rb->depth; i++) {
+        if (rb->gl_fences[i]) rb->delete_sync(rb->gl_fences[i]);
+        if (rb->egl_fences[i]) rb->destroy_sync(rb->egl_display, rb->egl_fences[i]);
+    }
+    if (rb->depth) {
+        glDeleteFramebuffers(rb->depth, rb->framebuffers);
+        glDeleteTextures(rb->depth, rb->textures);
+        if (rb->use_pbo) glDeleteBuffers(rb->depth, rb->pbos);
+        if (rb->gen_queries) rb->delete_queries(rb->depth, rb->queries);
+    }
+    free(rb->output);
+    free(rb->gpu_seconds);
+    free(rb->latency_seconds);
+    memset(rb, 0, sizeof(*rb));
+}
+
+#endif // SCALE_READBACK_H
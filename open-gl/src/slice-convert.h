@@ -0,0 +1,159 @@
+#ifndef SLICE_CONVERT_H
+#define SLICE_CONVERT_H
+
+// Pixel-format conversion to RGBA split across threads by horizontal bands.
+//
+// Each band is converted as a separate picture by its own SwsContext, so no
+// band depends on another. Band edges fall on whole chroma rows. For yuv420p
+// and the other formats swscale converts on its unscaled yuv2rgb path, each
+// row reads only its own chroma row and the bands should match a single
+// sws_scale call (not checked byte for byte here). Formats that take the
+// scaled path filter chroma vertically, so rows next to a band edge can
+// differ slightly from a single call. The calling thread converts band 0 and
+// the workers the rest; two barriers per frame hand out the job and wait for it.
+//
+// The band count comes from CONVERT_THREADS, or defaults to the number of
+// online CPUs (at most SLICE_CONVERT_MAX_THREADS).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+
+#define SLICE_CONVERT_MAX_THREADS 8
+#define SLICE_CONVERT_ROW_ALIGN 16  // Band heights; a multiple of every vertical chroma subsampling (at most 4)
+
+typedef struct SliceConverter SliceConverter;
+
+typedef struct {
+    SliceConverter* owner;
+    struct SwsContext* sws;
+    int y, height;  // Rows of the picture this band converts
+    pthread_t thread;
+} SliceBand;
+
+struct SliceConverter {
+    SliceBand bands[SLICE_CONVERT_MAX_THREADS];
+    int band_count;
+    int workers;  // Worker threads running (band_count - 1 once started)
+    int chroma_shift;  // log2 vertical chroma subsampling of the source
+    pthread_barrier_t start, done;
+    int stopping;
+    // Current job, written by the caller before the start barrier
+    const AVFrame* src;
+    uint8_t* dst;
+    int dst_linesize;
+};
+
+static void slice_convert_band(SliceBand* band) {
+    SliceConverter* conv = band->owner;
+    const AVFrame* src = conv->src;
+    const uint8_t* planes[4] = {NULL};
+    for (int p = 0; p < 4 && src->data[p]; p++) {
+        int shift = (p == 1 || p == 2) ? conv->chroma_shift : 0;
+        planes[p] = src->data[p] + (size_t)(band->y >> shift) * src->linesize[p];
+    }
+    uint8_t* dst = conv->dst + (size_t)band->y * conv->dst_linesize;
+    sws_scale(band->sws, planes, src->linesize, 0, band->height, &dst, &conv->dst_linesize);
+}
+
+static void* slice_convert_worker(void* arg) {
+    SliceBand* band = (SliceBand*)arg;
+    SliceConverter* conv = band->owner;
+    for (;;) {
+        pthread_barrier_wait(&conv->start);
+        if (conv->stopping) break;
+        slice_convert_band(band);
+        pthread_barrier_wait(&conv->done);
+    }
+    return NULL;
+}
+
+static int slice_convert_thread_count(void) {
+    const char* env = getenv("CONVERT_THREADS");
+    int threads = env ? atoi(env) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > SLICE_CONVERT_MAX_THREADS) threads = SLICE_CONVERT_MAX_THREADS;
+    return threads;
+}
+
+static int slice_convert_init(SliceConverter* conv, int width, int height, enum AVPixelFormat src_format) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(src_format);
+    if (!desc) return -1;
+    conv->chroma_shift = desc->log2_chroma_h;
+    conv->stopping = 0;
+    conv->workers = 0;
+
+    // Equal bands rounded to whole chroma rows, the last one takes the
+    // remainder: every band but the last is even (4:2:0 chroma rows are
+    // never split), and the last ends at the bottom of the picture
+    int threads = slice_convert_thread_count();
+    int rows = (height / threads + SLICE_CONVERT_ROW_ALIGN - 1) & ~(SLICE_CONVERT_ROW_ALIGN - 1);
+    if (rows < SLICE_CONVERT_ROW_ALIGN) rows = SLICE_CONVERT_ROW_ALIGN;
+    conv->band_count = 0;
+    for (int y = 0; y < height && conv->band_count < threads; y += rows) {
+        SliceBand* band = &conv->bands[conv->band_count++];
+        band->owner = conv;
+        band->y = y;
+        band->height = (conv->band_count == threads || y + rows > height) ? height - y : rows;
+        band->sws = sws_getContext(width, band->height, src_format, width, band->height, AV_PIX_FMT_RGBA,
+                                   SWS_BILINEAR, NULL, NULL, NULL);
+        if (!band->sws) return -1;
+        if (band->y + band->height >= height) break;
+    }
+
+    if (conv->band_count > 1) {
+        pthread_barrier_init(&conv->start, NULL, conv->band_count);
+        pthread_barrier_init(&conv->done, NULL, conv->band_count);
+        for (int i = 1; i < conv->band_count; i++)
+            pthread_create(&conv->bands[i].thread, NULL, slice_convert_worker, &conv->bands[i]);
+        conv->workers = conv->band_count - 1;
+    }
+    printf("DEBUG: Converting %dx%d in %d band(s)\n", width, height, conv->band_count);
+    return 0;
+}
+
+// CPU time the worker threads have used so far; band 0 runs on the caller
+static uint64_t slice_convert_cpu_ns(const SliceConverter* conv) {
+    uint64_t total = 0;
+    for (int i = 1; i <= conv->workers; i++) {
+        clockid_t clock;
+        struct timespec ts;
+        if (pthread_getcpuclockid(conv->bands[i].thread, &clock) == 0 && clock_gettime(clock, &ts) == 0)
+            total += (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+    return total;
+}
+
+// Convert src into a packed RGBA picture; returns once every band is done
+static void slice_convert_run(SliceConverter* conv, const AVFrame* src, uint8_t* dst, int dst_linesize) {
+    conv->src = src;
+    conv->dst = dst;
+    conv->dst_linesize = dst_linesize;
+    if (conv->workers) pthread_barrier_wait(&conv->start);
+    slice_convert_band(&conv->bands[0]);
+    if (conv->workers) pthread_barrier_wait(&conv->done);
+}
+
+static void slice_convert_free(SliceConverter* conv) {
+    if (conv->workers) {
+        conv->stopping = 1;
+        pthread_barrier_wait(&conv->start);
+        for (int i = 1; i <= conv->workers; i++) pthread_join(conv->bands[i].thread, NULL);
+        pthread_barrier_destroy(&conv->start);
+        pthread_barrier_destroy(&conv->done);
+        conv->workers = 0;
+    }
+    for (int i = 0; i < conv->band_count; i++) {
+        if (conv->bands[i].sws) sws_freeContext(conv->bands[i].sws);
+        conv->bands[i].sws = NULL;
+    }
+    conv->band_count = 0;
+}
+
+#endif // SLICE_CONVERT_H
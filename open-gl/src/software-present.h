@@ -0,0 +1,383 @@
+#ifndef SOFTWARE_PRESENT_H
+#define SOFTWARE_PRESENT_H
+
+// Presentation without GL, for hosts whose GPU or driver is missing or
+// broken. Each frame is scaled on the CPU by the multi-core scaler (OpenMP
+// over all cores when built with -fopenmp) into shared memory the display
+// server reads without another copy, double-buffered:
+//   Wayland   two window-sized wl_shm buffers; a buffer is reused once the
+//             compositor releases it. The letterbox is cleared once when
+//             the buffer is made, then only the video rectangle is written
+//             and damaged.
+//   X11       two video-sized MIT-SHM images put at the letterbox offset
+//             (XShmPutImage); an image is reused after its ShmCompletion.
+//   headless  two plain buffers that nobody shows: the CPU path on its own,
+//             for CI machines.
+// Display servers take BGRX almost everywhere, so the scaler writes RGBA
+// into a scratch frame and the copy into the buffer swaps R and B. When the
+// server takes RGBX (wl_shm XBGR8888, an X visual with red in the low byte)
+// and the frame fills the buffer, the scaler writes into it directly.
+//
+// software_present_draw is the upload stage, software_present_show the swap
+// (put on X11, attach and damage on Wayland, where present_swap commits
+// after present_init_software, so frame callback pacing is the GL path's).
+// PRESENT_BACKEND=software selects it; the players also fall back to it
+// when EGL does not come up.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <wayland-client.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include "../../multi-core/scalers.h"
+
+#define SOFTWARE_BUFFERS 2
+
+typedef enum { SOFTWARE_NONE, SOFTWARE_WAYLAND, SOFTWARE_X11, SOFTWARE_HEADLESS } SoftwareTarget;
+
+typedef struct {
+    unsigned char* pixels;
+    size_t size;
+    int busy;  // The display server may still be reading it
+    int presented;  // Shown at least once (Wayland damages all of it the first time)
+    struct wl_buffer* wl_buffer;
+    XImage* image;
+    XShmSegmentInfo shm;
+} SoftwareBuffer;
+
+typedef struct {
+    SoftwareTarget target;  // SOFTWARE_NONE: not in use
+    int frame_width, frame_height;
+    int x, y, width, height;  // Video rectangle in the window
+    int buffer_width, buffer_height;
+    int swap_rb;  // Buffer is BGRX
+    unsigned char* scratch;  // RGBA video rectangle when the scaler cannot write the buffer directly
+    SoftwareBuffer buffers[SOFTWARE_BUFFERS];
+    int next;
+    int drawn;  // Buffer software_present_show hands over, -1 when none
+    struct wl_display* wl_display;
+    struct wl_surface* wl_surface;
+    struct wl_shm* wl_shm;
+    int has_xbgr;  // Compositor announced WL_SHM_FORMAT_XBGR8888
+    Display* x_display;
+    Window x_window;
+    GC x_gc;
+    int completion_type;  // XShmGetEventBase + ShmCompletion
+} SoftwarePresent;
+
+static int software_present_requested(void) {
+    const char* env = getenv("PRESENT_BACKEND");
+    return env && strcmp(env, "software") == 0;
+}
+
+// Place the frame in the window, aspect-correct when letterbox is set
+static void software_present_layout(SoftwarePresent* sp, int frame_width, int frame_height, int window_width,
+                                    int window_height, int letterbox) {
+    memset(sp, 0, sizeof(*sp));
+    sp->drawn = -1;
+    sp->frame_width = frame_width;
+    sp->frame_height = frame_height;
+    sp->buffer_width = window_width;
+    sp->buffer_height = window_height;
+    sp->width = window_width;
+    sp->height = window_height;
+    if (letterbox) {
+        if ((long)frame_width * window_height > (long)window_width * frame_height)
+            sp->height = (int)((long)window_width * frame_height / frame_width);
+        else
+            sp->width = (int)((long)window_height * frame_width / frame_height);
+    }
+    sp->x = (window_width - sp->width) / 2;
+    sp->y = (window_height - sp->height) / 2;
+}
+
+static void software_buffer_release(void* data, struct wl_buffer* buffer) {
+    ((SoftwareBuffer*)data)->busy = 0;
+}
+
+static const struct wl_buffer_listener software_buffer_listener = {software_buffer_release};
+
+static void software_shm_format(void* data, struct wl_shm* shm, uint32_t format) {
+    if (format == WL_SHM_FORMAT_XBGR8888) ((SoftwarePresent*)data)->has_xbgr = 1;
+}
+
+static const struct wl_shm_listener software_shm_listener = {software_shm_format};
+
+static void software_registry_global(void* data, struct wl_registry* registry, uint32_t name,
+                                     const char* interface, uint32_t version) {
+    SoftwarePresent* sp = (SoftwarePresent*)data;
+    if (strcmp(interface, "wl_shm") == 0 && !sp->wl_shm) {
+        sp->wl_shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+        wl_shm_add_listener(sp->wl_shm, &software_shm_listener, sp);
+    }
+}
+
+static void software_registry_global_remove(void* data, struct wl_registry* registry, uint32_t name) {}
+
+static const struct wl_registry_listener software_registry_listener = {
+    software_registry_global,
+    software_registry_global_remove
+};
+
+static int software_present_alloc_scratch(SoftwarePresent* sp) {
+    // The scaler writes the buffer itself only when both layout and byte order match
+    int direct = !sp->swap_rb && sp->width == sp->buffer_width && sp->height == sp->buffer_height;
+    if (direct) return 0;
+    sp->scratch = (unsigned char*)malloc((size_t)sp->width * sp->height * 4);
+    return sp->scratch ? 0 : -1;
+}
+
+static const char* software_present_describe(const SoftwarePresent* sp) {
+    return sp->scratch ? (sp->swap_rb ? "scaled into scratch, copied as BGRX" : "scaled into scratch, copied")
+                       : "scaled in place";
+}
+
+// wl_shm buffers on the players' surface; call after software_present_layout
+static int software_present_init_wayland(SoftwarePresent* sp, struct wl_display* display,
+                                         struct wl_surface* surface) {
+    sp->target = SOFTWARE_WAYLAND;  // From here on software_present_free releases what was made
+    sp->wl_display = display;
+    sp->wl_surface = surface;
+    struct wl_registry* registry = wl_display_get_registry(display);
+    wl_registry_add_listener(registry, &software_registry_listener, sp);
+    wl_display_roundtrip(display);  // Globals
+    wl_display_roundtrip(display);  // wl_shm formats
+    wl_registry_destroy(registry);
+    if (!sp->wl_shm) {
+        fprintf(stderr, "DEBUG: Compositor has no wl_shm\n");
+        return -1;
+    }
+    sp->swap_rb = !sp->has_xbgr;
+    uint32_t format = sp->has_xbgr ? WL_SHM_FORMAT_XBGR8888 : WL_SHM_FORMAT_XRGB8888;
+
+    int stride = sp->buffer_width * 4;
+    for (int i = 0; i < SOFTWARE_BUFFERS; i++) {
+        SoftwareBuffer* buffer = &sp->buffers[i];
+        buffer->size = (size_t)stride * sp->buffer_height;
+        // Anonymous shared memory: the name is gone again before anyone else could open it
+        char name[64];
+        snprintf(name, sizeof(name), "/gl-player-%d-%d", (int)getpid(), i);
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) return -1;
+        shm_unlink(name);
+        if (ftruncate(fd, buffer->size) < 0) {
+            close(fd);
+            return -1;
+        }
+        buffer->pixels = mmap(NULL, buffer->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (buffer->pixels == MAP_FAILED) {
+            buffer->pixels = NULL;
+            close(fd);
+            return -1;
+        }
+        memset(buffer->pixels, 0, buffer->size);  // Black letterbox, written once
+        struct wl_shm_pool* pool = wl_shm_create_pool(sp->wl_shm, fd, buffer->size);
+        buffer->wl_buffer = wl_shm_pool_create_buffer(pool, 0, sp->buffer_width, sp->buffer_height, stride, format);
+        wl_buffer_add_listener(buffer->wl_buffer, &software_buffer_listener, buffer);
+        wl_shm_pool_destroy(pool);
+        close(fd);
+    }
+    if (software_present_alloc_scratch(sp) < 0) return -1;
+    printf("DEBUG: Software presentation on wl_shm, %dx%d buffers, video %dx%d at %d,%d, %s\n", sp->buffer_width,
+           sp->buffer_height, sp->width, sp->height, sp->x, sp->y, software_present_describe(sp));
+    return 0;
+}
+
+// Byte offset in memory of the channel a 32-bpp XImage mask selects, or -1
+// when the mask is not one whole byte
+static int software_x11_channel_offset(unsigned long mask, int byte_order) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        if (mask == 0xfful << shift) return byte_order == LSBFirst ? shift / 8 : 3 - shift / 8;
+    }
+    return -1;
+}
+
+// MIT-SHM images of the video rectangle for the players' window
+static int software_present_init_x11(SoftwarePresent* sp, Display* display, Window window) {
+    sp->target = SOFTWARE_X11;
+    sp->x_display = display;
+    sp->x_window = window;
+    if (!XShmQueryExtension(display)) {
+        fprintf(stderr, "DEBUG: X server has no MIT-SHM\n");
+        return -1;
+    }
+    XWindowAttributes attributes;
+    XGetWindowAttributes(display, window, &attributes);
+    sp->completion_type = XShmGetEventBase(display) + ShmCompletion;
+    sp->buffer_width = sp->width;
+    sp->buffer_height = sp->height;
+
+    for (int i = 0; i < SOFTWARE_BUFFERS; i++) {
+        SoftwareBuffer* buffer = &sp->buffers[i];
+        buffer->image = XShmCreateImage(display, attributes.visual, attributes.depth, ZPixmap, NULL, &buffer->shm,
+                                        sp->width, sp->height);
+        if (!buffer->image) return -1;
+        if (buffer->image->bits_per_pixel != 32 || buffer->image->bytes_per_line != sp->width * 4) {
+            fprintf(stderr, "DEBUG: Unsupported X visual for software presentation (%d bpp)\n",
+                    buffer->image->bits_per_pixel);
+            return -1;
+        }
+        buffer->size = (size_t)buffer->image->bytes_per_line * sp->height;
+        buffer->shm.shmid = shmget(IPC_PRIVATE, buffer->size, IPC_CREAT | 0600);
+        if (buffer->shm.shmid < 0) return -1;
+        buffer->shm.shmaddr = buffer->image->data = shmat(buffer->shm.shmid, NULL, 0);
+        buffer->shm.readOnly = False;
+        if (buffer->shm.shmaddr == (char*)-1) {
+            buffer->shm.shmaddr = buffer->image->data = NULL;
+            shmctl(buffer->shm.shmid, IPC_RMID, NULL);
+            return -1;
+        }
+        buffer->pixels = (unsigned char*)buffer->shm.shmaddr;
+        XShmAttach(display, &buffer->shm);
+    }
+    XSync(display, False);
+    // Marked for removal now; the segments live until both sides detach
+    for (int i = 0; i < SOFTWARE_BUFFERS; i++) shmctl(sp->buffers[i].shm.shmid, IPC_RMID, NULL);
+
+    // The scaler writes RGBX, and the copy can swap it to BGRX; other layouts are refused
+    XImage* image = sp->buffers[0].image;
+    int red = software_x11_channel_offset(image->red_mask, image->byte_order);
+    int green = software_x11_channel_offset(image->green_mask, image->byte_order);
+    int blue = software_x11_channel_offset(image->blue_mask, image->byte_order);
+    if (green != 1 || !((red == 0 && blue == 2) || (red == 2 && blue == 0))) {
+        fprintf(stderr, "DEBUG: Unsupported X visual channel layout (masks %lx %lx %lx)\n", image->red_mask,
+                image->green_mask, image->blue_mask);
+        return -1;
+    }
+    sp->swap_rb = red == 2;
+    if (software_present_alloc_scratch(sp) < 0) return -1;
+    sp->x_gc = XCreateGC(display, window, 0, NULL);
+    XSetWindowBackground(display, window, BlackPixel(display, DefaultScreen(display)));
+    XClearWindow(display, window);
+    printf("DEBUG: Software presentation on MIT-SHM, video %dx%d at %d,%d, %s\n", sp->width, sp->height, sp->x,
+           sp->y, software_present_describe(sp));
+    return 0;
+}
+
+// Nothing shown; same scaling and copies, for measuring the CPU path
+static int software_present_init_headless(SoftwarePresent* sp) {
+    sp->target = SOFTWARE_HEADLESS;
+    sp->swap_rb = 1;  // Do the work a BGRX display would cost
+    for (int i = 0; i < SOFTWARE_BUFFERS; i++) {
+        sp->buffers[i].size = (size_t)sp->buffer_width * sp->buffer_height * 4;
+        sp->buffers[i].pixels = (unsigned char*)calloc(1, sp->buffers[i].size);
+        if (!sp->buffers[i].pixels) return -1;
+    }
+    if (software_present_alloc_scratch(sp) < 0) return -1;
+    printf("DEBUG: Software presentation offscreen, video %dx%d, %s\n", sp->width, sp->height,
+           software_present_describe(sp));
+    return 0;
+}
+
+static Bool software_is_completion(Display* display, XEvent* event, XPointer arg) {
+    SoftwarePresent* sp = (SoftwarePresent*)arg;
+    return event->type == sp->completion_type;
+}
+
+// Feed every X event through this first; returns 1 for our ShmCompletion events
+static int software_present_handle_event(SoftwarePresent* sp, XEvent* event) {
+    if (sp->target != SOFTWARE_X11 || event->type != sp->completion_type) return 0;
+    ShmSeg segment = ((XShmCompletionEvent*)event)->shmseg;
+    for (int i = 0; i < SOFTWARE_BUFFERS; i++)
+        if (sp->buffers[i].shm.shmseg == segment) sp->buffers[i].busy = 0;
+    return 1;
+}
+
+// Block until the display server is done reading buffer
+static void software_present_wait(SoftwarePresent* sp, SoftwareBuffer* buffer) {
+    while (buffer->busy) {
+        if (sp->target == SOFTWARE_WAYLAND) {
+            if (wl_display_dispatch(sp->wl_display) < 0) buffer->busy = 0;
+        } else if (sp->target == SOFTWARE_X11) {
+            XEvent event;
+            XIfEvent(sp->x_display, &event, software_is_completion, (XPointer)sp);
+            software_present_handle_event(sp, &event);
+        } else {
+            buffer->busy = 0;
+        }
+    }
+}
+
+// Scale an RGBA frame into the next free buffer
+static void software_present_draw(SoftwarePresent* sp, const unsigned char* rgba) {
+    SoftwareBuffer* buffer = &sp->buffers[sp->next];
+    software_present_wait(sp, buffer);
+    sp->drawn = sp->next;
+    sp->next = (sp->next + 1) % SOFTWARE_BUFFERS;
+
+    Resolution src = {sp->frame_width, sp->frame_height, (unsigned char*)rgba};
+    Resolution dst = {sp->width, sp->height, sp->scratch ? sp->scratch : buffer->pixels};
+    scaleResolutionBilinear(&src, &dst);
+    if (sp->scratch) {
+        int swap_rb = sp->swap_rb;
+        #pragma omp parallel for
+        for (int y = 0; y < sp->height; y++) {
+            const unsigned char* in = sp->scratch + (size_t)y * sp->width * 4;
+            unsigned char* out = buffer->pixels + (((size_t)(sp->y + y) * sp->buffer_width + sp->x) * 4);
+            if (!swap_rb) {
+                memcpy(out, in, (size_t)sp->width * 4);
+                continue;
+            }
+            for (int x = 0; x < sp->width * 4; x += 4) {
+                out[x] = in[x + 2];
+                out[x + 1] = in[x + 1];
+                out[x + 2] = in[x];
+                out[x + 3] = 255;
+            }
+        }
+    }
+}
+
+// Hand the last drawn buffer to the display server
+static void software_present_show(SoftwarePresent* sp) {
+    if (sp->drawn < 0) return;
+    SoftwareBuffer* buffer = &sp->buffers[sp->drawn];
+    sp->drawn = -1;
+    if (sp->target == SOFTWARE_WAYLAND) {
+        wl_surface_attach(sp->wl_surface, buffer->wl_buffer, 0, 0);
+        if (buffer->presented)
+            wl_surface_damage(sp->wl_surface, sp->x, sp->y, sp->width, sp->height);
+        else
+            wl_surface_damage(sp->wl_surface, 0, 0, sp->buffer_width, sp->buffer_height);
+        buffer->busy = 1;
+    } else if (sp->target == SOFTWARE_X11) {
+        XShmPutImage(sp->x_display, sp->x_window, sp->x_gc, buffer->image, 0, 0, sp->x, sp->y, sp->width,
+                     sp->height, True);
+        XFlush(sp->x_display);
+        buffer->busy = 1;
+    }
+    buffer->presented = 1;
+}
+
+// Call before the display connection is closed; also after a failed init
+static void software_present_free(SoftwarePresent* sp) {
+    if (sp->target == SOFTWARE_NONE) return;
+    for (int i = 0; i < SOFTWARE_BUFFERS; i++) {
+        SoftwareBuffer* buffer = &sp->buffers[i];
+        if (buffer->wl_buffer) wl_buffer_destroy(buffer->wl_buffer);
+        if (sp->target == SOFTWARE_WAYLAND && buffer->pixels) munmap(buffer->pixels, buffer->size);
+        if (buffer->image) {
+            if (buffer->pixels) {
+                XShmDetach(sp->x_display, &buffer->shm);
+                shmdt(buffer->shm.shmaddr);
+                shmctl(buffer->shm.shmid, IPC_RMID, NULL);  // Already gone unless init failed halfway
+            }
+            buffer->image->data = NULL;
+            XDestroyImage(buffer->image);
+        }
+        if (sp->target == SOFTWARE_HEADLESS) free(buffer->pixels);
+    }
+    if (sp->x_gc) XFreeGC(sp->x_display, sp->x_gc);
+    if (sp->wl_shm) wl_shm_destroy(sp->wl_shm);
+    free(sp->scratch);
+    memset(sp, 0, sizeof(*sp));
+}
+
+#endif // SOFTWARE_PRESENT_H
@@ -0,0 +1,59 @@
+#ifndef STARTUP_TIMING_H
+#define STARTUP_TIMING_H
+
+// Time-to-first-frame breakdown. startup_begin() at the top of main starts
+// the clock; each startup step calls startup_mark() once it is done, from
+// whichever thread ran it (the first call per mark counts, later ones are a
+// load and a branch). The first swap prints every mark as its offset from
+// the start: probing and decoding run beside the display and EGL setup, so
+// the latest of the two is what the first frame waited for.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef enum {
+    STARTUP_PROBE,  // Container opened, decoder ready
+    STARTUP_FIRST_DECODE,  // First frame decoded and converted, waiting for the renderer
+    STARTUP_DISPLAY,  // Display server connected
+    STARTUP_WINDOW,  // Window created and mapped
+    STARTUP_EGL,  // Context current
+    STARTUP_SHADERS,
+    STARTUP_TEXTURES,  // Geometry and video textures allocated
+    STARTUP_FIRST_UPLOAD,
+    STARTUP_FIRST_SWAP,  // Prints the breakdown
+    STARTUP_COUNT
+} StartupMark;
+
+static const char* const startup_names[STARTUP_COUNT] = {
+    "probe", "first decode", "display", "window", "egl", "shaders", "textures", "first upload", "first swap"
+};
+
+static uint64_t startup_start_ns;
+static volatile uint64_t startup_marks[STARTUP_COUNT];  // ns after startup_start_ns, 0 until marked
+
+static uint64_t startup_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void startup_begin(void) {
+    startup_start_ns = startup_now_ns();
+}
+
+static void startup_report(void) {
+    printf("DEBUG: Time to first frame %.1f ms:\n", startup_marks[STARTUP_FIRST_SWAP] / 1e6);
+    for (int m = 0; m < STARTUP_COUNT; m++) {
+        if (startup_marks[m])
+            printf("DEBUG:   %-13s at %7.1f ms\n", startup_names[m], startup_marks[m] / 1e6);
+    }
+}
+
+static void startup_mark(StartupMark mark) {
+    if (startup_marks[mark] || !startup_start_ns) return;
+    startup_marks[mark] = startup_now_ns() - startup_start_ns;
+    if (mark == STARTUP_FIRST_SWAP) startup_report();
+}
+
+#endif // STARTUP_TIMING_H
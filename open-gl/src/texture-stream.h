@@ -0,0 +1,176 @@
+#ifndef TEXTURE_STREAM_H
+#define TEXTURE_STREAM_H
+
+// Streaming RGBA texture upload that does not stall on the frame being drawn.
+//
+// Frames rotate through TEXTURE_STREAM_BUFFERS textures (default 3), each
+// allocated once, so frame N+1 is uploaded into a different texture while
+// the GPU may still be drawing frame N. A fence after each draw records when
+// its texture is free again; the upload that comes back round to it waits on
+// that fence, which only blocks when the GPU is a whole ring behind.
+//
+// On GLES3 each texture also has its own pixel buffer object: the frame is
+// copied into the mapped PBO and glTexSubImage2D from the PBO is queued for
+// the GPU instead of copying client memory inside the call. GLES2 uploads
+// straight from client memory and fences with EGL_KHR_fence_sync when the
+// driver has it. The GLES3 entry points are looked up with eglGetProcAddress,
+// so the binary still links and loads against a GLES2-only libGLESv2.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+
+#define TEXTURE_STREAM_MAX 8
+#define TEXTURE_STREAM_DEFAULT 3
+#define TEXTURE_STREAM_WAIT_NS 1000000000ull  // Give up on a fence after a second (lost GPU)
+
+typedef struct {
+    int count;  // 0 until texture_stream_init
+    int next, last;  // Slot of the next upload, slot of the previous one
+    int width, height;
+    size_t size;  // Bytes per RGBA frame
+    int use_pbo;  // GLES3 context with the entry points below
+    GLuint textures[TEXTURE_STREAM_MAX];
+    GLuint pbos[TEXTURE_STREAM_MAX];
+    GLsync gl_fences[TEXTURE_STREAM_MAX];
+    EGLSyncKHR egl_fences[TEXTURE_STREAM_MAX];
+    PFNGLFENCESYNCPROC fence_sync;  // GLES3 only
+    PFNGLCLIENTWAITSYNCPROC gl_client_wait_sync;
+    PFNGLDELETESYNCPROC delete_sync;
+    PFNGLMAPBUFFERRANGEPROC map_buffer_range;
+    PFNGLUNMAPBUFFERPROC unmap_buffer;
+    EGLDisplay egl_display;
+    PFNEGLCREATESYNCKHRPROC create_sync;  // NULL without EGL_KHR_fence_sync
+    PFNEGLCLIENTWAITSYNCKHRPROC client_wait_sync;
+    PFNEGLDESTROYSYNCKHRPROC destroy_sync;
+} TextureStream;
+
+static int texture_stream_buffer_count(void) {
+    const char* env = getenv("TEXTURE_STREAM_BUFFERS");
+    int count = env ? atoi(env) : TEXTURE_STREAM_DEFAULT;
+    if (count < 1) count = 1;
+    if (count > TEXTURE_STREAM_MAX) count = TEXTURE_STREAM_MAX;
+    return count;
+}
+
+// Allocate the textures (and PBOs) for width x height RGBA frames; needs a
+// current context, which also decides between the GLES3 and GLES2 paths
+static void texture_stream_init(TextureStream* ts, int width, int height) {
+    memset(ts, 0, sizeof(*ts));
+    ts->count = texture_stream_buffer_count();
+    ts->width = width;
+    ts->height = height;
+    ts->size = (size_t)width * height * 4;
+    ts->last = -1;
+
+    const char* version = (const char*)glGetString(GL_VERSION);
+    if (version && strncmp(version, "OpenGL ES 3", 11) == 0) {
+        ts->fence_sync = (PFNGLFENCESYNCPROC)eglGetProcAddress("glFenceSync");
+        ts->gl_client_wait_sync = (PFNGLCLIENTWAITSYNCPROC)eglGetProcAddress("glClientWaitSync");
+        ts->delete_sync = (PFNGLDELETESYNCPROC)eglGetProcAddress("glDeleteSync");
+        ts->map_buffer_range = (PFNGLMAPBUFFERRANGEPROC)eglGetProcAddress("glMapBufferRange");
+        ts->unmap_buffer = (PFNGLUNMAPBUFFERPROC)eglGetProcAddress("glUnmapBuffer");
+        ts->use_pbo = ts->fence_sync && ts->gl_client_wait_sync && ts->delete_sync && ts->map_buffer_range &&
+                      ts->unmap_buffer;
+    }
+    if (!ts->use_pbo) {
+        ts->egl_display = eglGetCurrentDisplay();
+        const char* extensions = eglQueryString(ts->egl_display, EGL_EXTENSIONS);
+        if (extensions && strstr(extensions, "EGL_KHR_fence_sync")) {
+            ts->create_sync = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+            ts->client_wait_sync = (PFNEGLCLIENTWAITSYNCKHRPROC)eglGetProcAddress("eglClientWaitSyncKHR");
+            ts->destroy_sync = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+            if (!ts->client_wait_sync || !ts->destroy_sync) ts->create_sync = NULL;
+        }
+    }
+
+    glGenTextures(ts->count, ts->textures);
+    for (int i = 0; i < ts->count; i++) {
+        glBindTexture(GL_TEXTURE_2D, ts->textures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+    if (ts->use_pbo) {
+        glGenBuffers(ts->count, ts->pbos);
+        for (int i = 0; i < ts->count; i++) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ts->pbos[i]);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, ts->size, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    printf("DEBUG: Texture stream of %d %dx%d textures, %s, %s fences\n", ts->count, width, height,
+           ts->use_pbo ? "PBO upload" : "direct upload",
+           ts->use_pbo ? "GL" : ts->create_sync ? "EGL" : "no");
+}
+
+// Block until the last draw from the slot's texture (and its PBO copy) is done
+static void texture_stream_wait(TextureStream* ts, int slot) {
+    if (ts->gl_fences[slot]) {
+        ts->gl_client_wait_sync(ts->gl_fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, TEXTURE_STREAM_WAIT_NS);
+        ts->delete_sync(ts->gl_fences[slot]);
+        ts->gl_fences[slot] = 0;
+    }
+    if (ts->egl_fences[slot]) {
+        ts->client_wait_sync(ts->egl_display, ts->egl_fences[slot], EGL_SYNC_FLUSH_COMMANDS_BIT_KHR,
+                             TEXTURE_STREAM_WAIT_NS);
+        ts->destroy_sync(ts->egl_display, ts->egl_fences[slot]);
+        ts->egl_fences[slot] = EGL_NO_SYNC_KHR;
+    }
+}
+
+// Upload one frame into the next texture of the ring and leave it bound to
+// GL_TEXTURE_2D; pixels can be reused as soon as this returns
+static GLuint texture_stream_upload(TextureStream* ts, const void* pixels) {
+    int slot = ts->next;
+    texture_stream_wait(ts, slot);
+    glBindTexture(GL_TEXTURE_2D, ts->textures[slot]);
+
+    const void* source = pixels;
+    if (ts->use_pbo) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ts->pbos[slot]);
+        // The fence already covers the previous copy out of this PBO
+        void* mapped = ts->map_buffer_range(GL_PIXEL_UNPACK_BUFFER, 0, ts->size, GL_MAP_WRITE_BIT |
+                                            GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (mapped) {
+            memcpy(mapped, pixels, ts->size);
+            source = ts->unmap_buffer(GL_PIXEL_UNPACK_BUFFER) ? NULL : pixels;  // NULL: offset 0 into the PBO
+        }
+        if (source) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ts->width, ts->height, GL_RGBA, GL_UNSIGNED_BYTE, source);
+    if (ts->use_pbo) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    ts->last = slot;
+    ts->next = (slot + 1) % ts->count;
+    return ts->textures[slot];
+}
+
+// Call after the draw that samples the texture from the last upload; does
+// nothing for a stream that was never initialized (the YUV upload path)
+static void texture_stream_fence(TextureStream* ts) {
+    if (!ts->count || ts->last < 0) return;
+    texture_stream_wait(ts, ts->last);  // Normally nothing left; keeps one fence per slot
+    if (ts->use_pbo)
+        ts->gl_fences[ts->last] = ts->fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    else if (ts->create_sync)
+        ts->egl_fences[ts->last] = ts->create_sync(ts->egl_display, EGL_SYNC_FENCE_KHR, NULL);
+}
+
+static void texture_stream_free(TextureStream* ts) {
+    if (!ts->count) return;
+    for (int i = 0; i < ts->count; i++) {
+        if (ts->gl_fences[i]) ts->delete_sync(ts->gl_fences[i]);
+        if (ts->egl_fences[i]) ts->destroy_sync(ts->egl_display, ts->egl_fences[i]);
+    }
+    glDeleteTextures(ts->count, ts->textures);
+    if (ts->use_pbo) glDeleteBuffers(ts->count, ts->pbos);
+    ts->count = 0;
+}
+
+#endif // TEXTURE_STREAM_H
@@ -0,0 +1,521 @@
+// Offline transcode-scale: decode a video once and write it scaled to one or
+// more sizes as raw RGBA or Y4M, for asset preparation.
+//
+//   transcode-scale [--cpu] [--y4m] [--filter=bicubic|lanczos] input.mp4 output_dir 640x480 1280x720 ...
+//
+// writes output_dir/<input name>_<W>x<H>.rgba (or .y4m) per size, the same
+// files videos/convert-rgba makes with one ffmpeg run per size. Three stages
+// run on their own threads and overlap: decode + RGBA conversion, scaling
+// (on the GPU through a headless context, or with the OpenMP bilinear scaler
+// of multi-core/ with --cpu) and writing. The GPU path uploads each source
+// frame once through the texture stream, draws every size into its own
+// readback ring and hands the pixels to the writer from the mapped PBO.
+// --filter replaces bilinear sampling with the two-pass filters of
+// scale-filter.h (the CPU path has bicubic only).
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+#include <libavutil/imgutils.h>
+
+#include "../../multi-core/scalers.h"
+#include "frame-ring.h"
+#include "headless-egl.h"
+#include "decoder-pool.h"
+#include "slice-convert.h"
+#include "texture-stream.h"
+#include "scale-readback.h"
+#include "scale-filter.h"
+#include "program-cache.h"
+
+#define MAX_TARGETS 16
+#define SOURCE_QUEUE_SIZE 4  // Decoded RGBA frames waiting for the scaler
+#define WRITE_QUEUE_SIZE 16  // Scaled frames waiting for the writer
+#define TIMED_FRAMES 4096  // GPU timer samples kept per target
+
+typedef enum { OUTPUT_RGBA, OUTPUT_Y4M } OutputFormat;
+
+typedef struct {
+    int width, height;
+    size_t size;  // RGBA bytes per frame
+    char path[1024];
+    FILE* file;
+    struct SwsContext* to_yuv;  // Y4M: RGBA to yuv420p
+    uint8_t* yuv[4];  // One tightly packed yuv420p picture
+    int yuv_linesize[4];
+    int yuv_size;
+    ScaleReadback readback;  // GPU path
+    ScaleFilter filter;  // GPU path with --filter
+    int frames_written;
+} Target;
+
+typedef struct {
+    int target;
+    unsigned char* data;  // Room for the largest target
+} WriteSlot;
+
+// Video decoding globals
+AVFormatContext* format_context = NULL;
+AVCodecContext* codec_context = NULL;
+AVFrame* av_frame = NULL;
+AVPacket* packet = NULL;
+SliceConverter converter;
+int video_stream_index = -1;
+int frame_width = 0, frame_height = 0;
+AVRational frame_rate = {25, 1};
+
+// Pipeline: decode -> source_ring -> scale -> write_ring -> write
+unsigned char* source_frames[SOURCE_QUEUE_SIZE];
+FrameRing source_ring;
+WriteSlot write_slots[WRITE_QUEUE_SIZE];
+FrameRing write_ring;
+uint64_t decode_busy_ns = 0, scale_busy_ns = 0, write_busy_ns = 0;
+uint64_t bytes_written = 0;
+int write_failed = 0;
+
+// Outputs
+Target targets[MAX_TARGETS];
+int target_count = 0;
+OutputFormat output_format = OUTPUT_RGBA;
+int use_gpu = 1;
+ScaleFilterKind filter_kind = SCALE_FILTER_BILINEAR;
+
+// GPU scaling globals
+EGLDisplay egl_display;
+EGLContext egl_context;
+EGLSurface egl_surface;
+GLuint program, vbo;
+TextureStream source_stream;
+
+const char* vertex_shader_source =
+    "attribute vec3 position;\n"
+    "attribute vec2 texcoord;\n"
+    "varying vec2 v_texcoord;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(position, 1.0);\n"
+    "  v_texcoord = texcoord;\n"
+    "}\n";
+
+const char* fragment_shader_source =
+    "precision mediump float;\n"
+    "varying vec2 v_texcoord;\n"
+    "uniform sampler2D texture;\n"
+    "void main() {\n"
+    "  gl_FragColor = texture2D(texture, v_texcoord);\n"
+    "}\n";
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Open the input and the decoder, and set up conversion to RGBA
+int init_mp4_file(const char* filename) {
+    printf("DEBUG: Initializing MP4 file: %s\n", filename);
+    if (avformat_open_input(&format_context, filename, NULL, NULL) < 0) {
+        fprintf(stderr, "DEBUG: Failed to open MP4 file\n");
+        return -1;
+    }
+    avformat_find_stream_info(format_context, NULL);
+    video_stream_index = av_find_best_stream(format_context, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (video_stream_index < 0) return -1;
+
+    AVStream* stream = format_context->streams[video_stream_index];
+    const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    codec_context = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(codec_context, stream->codecpar);
+    codec_context->thread_count = 0;  // Offline: let the decoder use every core
+    decoder_pool_attach(codec_context);
+    if (avcodec_open2(codec_context, codec, NULL) < 0) return -1;
+
+    av_frame = av_frame_alloc();
+    packet = av_packet_alloc();
+    if (!av_frame || !packet) return -1;
+
+    if (stream->avg_frame_rate.num > 0 && stream->avg_frame_rate.den > 0) frame_rate = stream->avg_frame_rate;
+    frame_width = codec_context->width;
+    frame_height = codec_context->height;
+    if (slice_convert_init(&converter, frame_width, frame_height, codec_context->pix_fmt) < 0) return -1;
+    printf("DEBUG: MP4 initialized - %dx%d at %d/%d fps\n", frame_width, frame_height, frame_rate.num,
+           frame_rate.den);
+    return 0;
+}
+
+// Convert every frame the decoder has ready into source_ring; -1 once stopped
+int drain_decoder(int* frame_id) {
+    for (;;) {
+        uint64_t stage_start = now_ns();
+        int ret = avcodec_receive_frame(codec_context, av_frame);
+        decode_busy_ns += now_ns() - stage_start;
+        if (ret < 0) return 0;  // EAGAIN or end of stream
+
+        int slot = frame_ring_reserve(&source_ring);
+        if (slot < 0) {
+            av_frame_unref(av_frame);
+            return -1;
+        }
+        stage_start = now_ns();
+        slice_convert_run(&converter, av_frame, source_frames[slot], frame_width * 4);
+        decode_busy_ns += now_ns() - stage_start;
+        av_frame_unref(av_frame);
+        frame_ring_push(&source_ring);
+        (*frame_id)++;
+    }
+}
+
+// Decode thread: demux, decode and convert to RGBA
+void* decode_thread_func(void* arg) {
+    printf("DEBUG: Starting decode thread\n");
+    int frame_id = 0;
+    for (;;) {
+        uint64_t stage_start = now_ns();
+        int ret = av_read_frame(format_context, packet);
+        if (ret < 0) break;
+        if (packet->stream_index == video_stream_index) ret = avcodec_send_packet(codec_context, packet);
+        av_packet_unref(packet);
+        decode_busy_ns += now_ns() - stage_start;
+        if (ret < 0 && ret != AVERROR(EAGAIN)) fprintf(stderr, "DEBUG: Decode error on frame %d\n", frame_id);
+        if (drain_decoder(&frame_id) < 0) break;
+    }
+    // Flush the frames the decoder still holds
+    avcodec_send_packet(codec_context, NULL);
+    drain_decoder(&frame_id);
+    frame_ring_close(&source_ring);
+    printf("DEBUG: Decode thread exiting after %d frames\n", frame_id);
+    return NULL;
+}
+
+// Writer thread: append each scaled frame to its target's file
+void* write_thread_func(void* arg) {
+    printf("DEBUG: Starting write thread\n");
+    int slot;
+    while ((slot = frame_ring_peek(&write_ring)) >= 0) {
+        WriteSlot* frame = &write_slots[slot];
+        Target* target = &targets[frame->target];
+        uint64_t stage_start = now_ns();
+        size_t expected, written;
+        if (output_format == OUTPUT_Y4M) {
+            const uint8_t* src[1] = {frame->data};
+            int src_linesize[1] = {target->width * 4};
+            sws_scale(target->to_yuv, src, src_linesize, 0, target->height, target->yuv, target->yuv_linesize);
+            fputs("FRAME\n", target->file);
+            expected = target->yuv_size;
+            written = fwrite(target->yuv[0], 1, expected, target->file);
+        } else {
+            expected = target->size;
+            written = fwrite(frame->data, 1, expected, target->file);
+        }
+        write_busy_ns += now_ns() - stage_start;
+        if (written != expected && !write_failed) {
+            fprintf(stderr, "DEBUG: Short write to %s\n", target->path);
+            write_failed = 1;
+        }
+        bytes_written += written;
+        target->frames_written++;
+        frame_ring_pop(&write_ring);
+    }
+    printf("DEBUG: Write thread exiting\n");
+    return NULL;
+}
+
+// Take a write slot for target; NULL once the writer has stopped
+unsigned char* reserve_write_slot(int target) {
+    int slot = frame_ring_reserve(&write_ring);
+    if (slot < 0) return NULL;
+    write_slots[slot].target = target;
+    return write_slots[slot].data;
+}
+
+// Readback sink: copy a retired GPU frame into the write queue
+void queue_scaled_frame(void* data, int frame, const unsigned char* pixels) {
+    Target* target = (Target*)data;
+    unsigned char* slot = reserve_write_slot((int)(target - targets));
+    if (!slot) return;
+    memcpy(slot, pixels, target->size);
+    frame_ring_push(&write_ring);
+}
+
+GLuint compile_shader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint compiled;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char log[512];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "DEBUG: Shader compilation failed: %s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Headless context, scaling program, fullscreen quad and one readback ring per target
+int init_gpu(void) {
+    EGLConfig config;
+    if (headless_egl_init(&egl_display, &config, &egl_context, &egl_surface, 1, 1) < 0) return -1;
+
+    ProgramCacheEntry cache_entry;
+    program = program_cache_load(&cache_entry, "scale", vertex_shader_source, fragment_shader_source);
+    if (!program) {
+        GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
+        GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
+        if (!vertex_shader || !fragment_shader) return -1;
+        program = glCreateProgram();
+        glAttachShader(program, vertex_shader);
+        glAttachShader(program, fragment_shader);
+        glLinkProgram(program);
+        glDeleteShader(vertex_shader);
+        glDeleteShader(fragment_shader);
+        GLint linked;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) return -1;
+        program_cache_store(&cache_entry, program);
+    }
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "texture"), 0);
+
+    // Texture row 0 (the top of the picture) at the bottom of the target, which is
+    // where glReadPixels starts, so the readback comes out top row first
+    float vertices[] = {
+        -1.0f, -1.0f, 0.0f,  0.0f, 0.0f,
+         1.0f, -1.0f, 0.0f,  1.0f, 0.0f,
+        -1.0f,  1.0f, 0.0f,  0.0f, 1.0f,
+         1.0f,  1.0f, 0.0f,  1.0f, 1.0f
+    };
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    GLint pos_attrib = glGetAttribLocation(program, "position");
+    GLint tex_attrib = glGetAttribLocation(program, "texcoord");
+    glEnableVertexAttribArray(pos_attrib);
+    glVertexAttribPointer(pos_attrib, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
+    glEnableVertexAttribArray(tex_attrib);
+    glVertexAttribPointer(tex_attrib, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+
+    texture_stream_init(&source_stream, frame_width, frame_height);
+    glActiveTexture(GL_TEXTURE0);
+    for (int i = 0; i < target_count; i++) {
+        if (scale_readback_init(&targets[i].readback, targets[i].width, targets[i].height, TIMED_FRAMES) < 0)
+            return -1;
+        targets[i].readback.sink = queue_scaled_frame;
+        targets[i].readback.sink_data = &targets[i];
+        if (filter_kind == SCALE_FILTER_BILINEAR) continue;
+        // One program for all sizes, an intermediate texture per size
+        if (scale_filter_init(&targets[i].filter, filter_kind, i ? &targets[0].filter : NULL) < 0) return -1;
+        targets[i].filter.timed = 0;  // The readback ring already times each draw
+        scale_filter_resize(&targets[i].filter, frame_width, frame_height, targets[i].width, targets[i].height);
+    }
+    return 0;
+}
+
+// Upload the frame once and draw it into every target's readback ring
+void scale_frame_gpu(const unsigned char* source) {
+    GLuint source_texture = texture_stream_upload(&source_stream, source);
+    for (int i = 0; i < target_count; i++) {
+        scale_readback_begin(&targets[i].readback);
+        if (filter_kind != SCALE_FILTER_BILINEAR) scale_filter_draw(&targets[i].filter, source_texture, vbo);
+        else glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        scale_readback_end(&targets[i].readback);
+    }
+    texture_stream_fence(&source_stream);
+}
+
+// Scale straight into write slots with the multi-core bilinear (or bicubic) scaler
+void scale_frame_cpu(unsigned char* source) {
+    Resolution src = {frame_width, frame_height, source};
+    for (int i = 0; i < target_count; i++) {
+        unsigned char* slot = reserve_write_slot(i);
+        if (!slot) return;
+        Resolution dst = {targets[i].width, targets[i].height, slot};
+        if (filter_kind == SCALE_FILTER_BICUBIC) scaleResolutionBicubic(&src, &dst);
+        else scaleResolutionBilinear(&src, &dst);
+        frame_ring_push(&write_ring);
+    }
+}
+
+// Open target's output file, with the Y4M header and converter when needed
+int open_target(Target* target, const char* output_dir, const char* base) {
+    const char* extension = output_format == OUTPUT_Y4M ? "y4m" : "rgba";
+    snprintf(target->path, sizeof(target->path), "%s/%s_%dx%d.%s", output_dir, base, target->width,
+             target->height, extension);
+    target->file = fopen(target->path, "wb");
+    if (!target->file) {
+        fprintf(stderr, "DEBUG: Failed to create %s\n", target->path);
+        return -1;
+    }
+    if (output_format == OUTPUT_Y4M) {
+        // swscale's default RGB to YUV is limited-range BT.601; chroma is
+        // area-averaged over each 2x2 block rather than point-sampled
+        fprintf(target->file, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", target->width,
+                target->height, frame_rate.num, frame_rate.den);
+        target->to_yuv = sws_getContext(target->width, target->height, AV_PIX_FMT_RGBA, target->width,
+                                        target->height, AV_PIX_FMT_YUV420P, SWS_AREA, NULL, NULL, NULL);
+        target->yuv_size = av_image_alloc(target->yuv, target->yuv_linesize, target->width, target->height,
+                                          AV_PIX_FMT_YUV420P, 1);
+        if (!target->to_yuv || target->yuv_size < 0) return -1;
+    }
+    printf("DEBUG: Writing %s\n", target->path);
+    return 0;
+}
+
+int parse_size(const char* arg, int* width, int* height) {
+    return sscanf(arg, "%dx%d", width, height) == 2 && *width > 0 && *height > 0 ? 0 : -1;
+}
+
+void cleanup(void) {
+    for (int i = 0; i < target_count; i++) {
+        if (use_gpu) scale_readback_free(&targets[i].readback);
+        if (use_gpu) scale_filter_free(&targets[i].filter);
+        if (targets[i].file) fclose(targets[i].file);
+        if (targets[i].to_yuv) sws_freeContext(targets[i].to_yuv);
+        if (targets[i].yuv_size > 0) av_freep(&targets[i].yuv[0]);
+    }
+    if (use_gpu && egl_context != EGL_NO_CONTEXT) {
+        texture_stream_free(&source_stream);
+        if (vbo) glDeleteBuffers(1, &vbo);
+        if (program) glDeleteProgram(program);
+        headless_egl_destroy();
+        eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (egl_surface != EGL_NO_SURFACE) eglDestroySurface(egl_display, egl_surface);
+        eglDestroyContext(egl_display, egl_context);
+        eglTerminate(egl_display);
+    }
+    for (int i = 0; i < SOURCE_QUEUE_SIZE; i++) free(source_frames[i]);
+    for (int i = 0; i < WRITE_QUEUE_SIZE; i++) free(write_slots[i].data);
+    slice_convert_free(&converter);
+    av_frame_free(&av_frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&codec_context);
+    decoder_pool_release();
+    avformat_close_input(&format_context);
+}
+
+int main(int argc, char** argv) {
+    const char* positional[2 + MAX_TARGETS];
+    int positional_count = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cpu") == 0) use_gpu = 0;
+        else if (strcmp(argv[i], "--y4m") == 0) output_format = OUTPUT_Y4M;
+        else if (strncmp(argv[i], "--filter=", 9) == 0) {
+            int kind = scale_filter_parse(argv[i] + 9);
+            if (kind < 0) {
+                fprintf(stderr, "Unknown filter %s, expected bilinear, bicubic or lanczos\n", argv[i] + 9);
+                return EXIT_FAILURE;
+            }
+            filter_kind = (ScaleFilterKind)kind;
+        }
+        else if (positional_count < 2 + MAX_TARGETS) positional[positional_count++] = argv[i];
+        else {
+            fprintf(stderr, "At most %d output sizes are supported\n", MAX_TARGETS);
+            return EXIT_FAILURE;
+        }
+    }
+    if (positional_count < 3) {
+        fprintf(stderr, "Usage: %s [--cpu] [--y4m] [--filter=NAME] <input.mp4> <output_dir> <WxH> [WxH ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (!use_gpu && filter_kind == SCALE_FILTER_LANCZOS) {
+        fprintf(stderr, "The CPU scalers have no Lanczos filter, drop --cpu\n");
+        return EXIT_FAILURE;
+    }
+    for (int i = 2; i < positional_count; i++) {
+        Target* target = &targets[target_count++];
+        if (parse_size(positional[i], &target->width, &target->height) < 0) {
+            fprintf(stderr, "Invalid size %s, expected WxH\n", positional[i]);
+            return EXIT_FAILURE;
+        }
+        target->size = (size_t)target->width * target->height * 4;
+    }
+
+    // Output names follow the input's file name without directory and extension
+    char base[256];
+    const char* name = strrchr(positional[0], '/');
+    snprintf(base, sizeof(base), "%s", name ? name + 1 : positional[0]);
+    char* dot = strrchr(base, '.');
+    if (dot && dot != base) *dot = '\0';
+
+    if (init_mp4_file(positional[0]) < 0) {
+        fprintf(stderr, "DEBUG: Failed to open MP4 file\n");
+        cleanup();
+        return EXIT_FAILURE;
+    }
+    size_t largest = 0;
+    for (int i = 0; i < target_count; i++) {
+        if (open_target(&targets[i], positional[1], base) < 0) {
+            cleanup();
+            return EXIT_FAILURE;
+        }
+        if (targets[i].size > largest) largest = targets[i].size;
+    }
+    int allocated = 1;
+    for (int i = 0; i < SOURCE_QUEUE_SIZE; i++) {
+        source_frames[i] = malloc((size_t)frame_width * frame_height * 4);
+        allocated = allocated && source_frames[i];
+    }
+    for (int i = 0; i < WRITE_QUEUE_SIZE; i++) {
+        write_slots[i].data = malloc(largest);
+        allocated = allocated && write_slots[i].data;
+    }
+    if (!allocated) {
+        fprintf(stderr, "DEBUG: Failed to allocate frame queues\n");
+        cleanup();
+        return EXIT_FAILURE;
+    }
+    frame_ring_init(&source_ring, SOURCE_QUEUE_SIZE);
+    frame_ring_init(&write_ring, WRITE_QUEUE_SIZE);
+
+    if (use_gpu && init_gpu() < 0) {
+        fprintf(stderr, "DEBUG: GPU scaling unavailable, rerun with --cpu\n");
+        cleanup();
+        return EXIT_FAILURE;
+    }
+    printf("DEBUG: Scaling %dx%d to %d size(s) on the %s, %s filter\n", frame_width, frame_height, target_count,
+           use_gpu ? "GPU" : "CPU", scale_filter_names[filter_kind]);
+
+    uint64_t start = now_ns();
+    pthread_t decode_thread, write_thread;
+    pthread_create(&decode_thread, NULL, decode_thread_func, NULL);
+    pthread_create(&write_thread, NULL, write_thread_func, NULL);
+
+    // The scaler runs here, on the thread that owns the GL context
+    int frames = 0, slot;
+    while ((slot = frame_ring_peek(&source_ring)) >= 0) {
+        uint64_t stage_start = now_ns();
+        if (use_gpu) scale_frame_gpu(source_frames[slot]);
+        else scale_frame_cpu(source_frames[slot]);
+        scale_busy_ns += now_ns() - stage_start;
+        frame_ring_pop(&source_ring);
+        frames++;
+    }
+    if (use_gpu) {
+        for (int i = 0; i < target_count; i++) scale_readback_drain(&targets[i].readback);
+    }
+    frame_ring_close(&write_ring);
+    pthread_join(decode_thread, NULL);
+    pthread_join(write_thread, NULL);
+    double wall = (now_ns() - start) / 1e9;
+
+    printf("DEBUG: %d frames to %d size(s) in %.2f s: %.1f frames/s, %.1f MB/s written\n", frames, target_count,
+           wall, frames / wall, bytes_written / wall / 1e6);
+    // Busy time close to the wall time marks the stage that limits throughput
+    printf("DEBUG: Busy time: decode %.2f s, scale %.2f s, write %.2f s\n", decode_busy_ns / 1e9,
+           scale_busy_ns / 1e9, write_busy_ns / 1e9);
+    for (int i = 0; use_gpu && i < target_count; i++) {
+        printf("DEBUG: %dx%d:\n", targets[i].width, targets[i].height);
+        scale_readback_report(&targets[i].readback, wall);
+    }
+    int failed = write_failed;
+    cleanup();
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
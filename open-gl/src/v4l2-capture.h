@@ -0,0 +1,366 @@
+#ifndef V4L2_CAPTURE_H
+#define V4L2_CAPTURE_H
+
+// V4L2 capture on its own thread. The thread sleeps in poll() on the device
+// and dequeues each buffer as soon as the driver has filled it, handing its
+// index to the renderer through a FrameRing; the renderer requeues a buffer
+// the moment it has uploaded (or drawn) it, so the driver keeps every other
+// buffer to fill while a frame is in the render loop.
+//
+// CAPTURE_MEMORY picks where frames land (default mmap):
+//   mmap     driver buffers mapped into the process
+//   userptr  page-aligned buffers we allocate once; the driver writes into
+//            them directly (falls back to mmap if the driver refuses)
+//   dmabuf   driver buffers also exported with VIDIOC_EXPBUF, for importing
+//            into EGL (EGL_EXT_image_dma_buf_import) instead of uploading;
+//            they stay mapped for readers that need the pixels
+// CAPTURE_BUFFERS sets the queue depth (default 4, 2 to 32; the driver may
+// round it): more buffers ride out longer render stalls, fewer hold less
+// stale video.
+//
+// When the renderer falls behind, capture_acquire returns the newest ready
+// frame and requeues the older ones, so latency stays at one frame instead
+// of growing to the queue depth. Frames carry the driver's capture
+// timestamp; capture_record_latency after the swap feeds
+// player_capture_latency_seconds (frame-stats.h).
+//
+// Without a camera, the vivid virtual driver supports all three modes:
+//   sudo modprobe vivid
+//   CAPTURE_MEMORY=userptr CAPTURE_BUFFERS=3 ./player /dev/video0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/videodev2.h>
+#include "frame-ring.h"
+#include "frame-stats.h"
+
+#define CAPTURE_MAX_BUFFERS 32  // Also the largest ring, a power of two
+#define CAPTURE_DEFAULT_BUFFERS 4
+
+typedef enum { CAPTURE_MMAP, CAPTURE_USERPTR, CAPTURE_DMABUF } CaptureMemory;
+
+static const char* const capture_memory_names[] = {"mmap", "userptr", "dmabuf"};
+
+typedef struct {
+    unsigned char* start;  // CPU view of the frame
+    size_t length;
+    int dmabuf_fd;  // VIDIOC_EXPBUF export with CAPTURE_DMABUF, otherwise -1
+    uint32_t bytesused;
+    uint32_t sequence;
+    uint64_t capture_ns;  // CLOCK_MONOTONIC, from the driver when it stamps monotonic time
+} CaptureBuffer;
+
+typedef struct {
+    int fd;  // Owned by the caller
+    CaptureMemory memory;
+    int count;
+    int width, height, stride;
+    uint32_t pixelformat;
+    size_t image_size;
+    CaptureBuffer buffers[CAPTURE_MAX_BUFFERS];
+    FrameRing ready;  // Dequeued buffers waiting for the renderer
+    int ready_index[CAPTURE_MAX_BUFFERS];  // Ring slot -> buffer index
+    pthread_t thread;
+    int thread_started, streaming;
+    int wake_pipe[2];  // capture_stop writes here to end the thread's poll
+    uint64_t frames, lost;  // Capture thread: frames dequeued, sequence numbers the driver skipped
+    uint64_t skipped;  // Renderer: requeued unseen because a newer frame was ready
+    uint32_t next_sequence;
+} Capture;
+
+static int capture_ioctl(int fd, unsigned long request, void* arg) {
+    int result;
+    do {
+        result = ioctl(fd, request, arg);
+    } while (result < 0 && errno == EINTR);
+    return result;
+}
+
+static CaptureMemory capture_memory_requested(void) {
+    const char* env = getenv("CAPTURE_MEMORY");
+    if (!env || !*env || strcmp(env, "mmap") == 0) return CAPTURE_MMAP;
+    if (strcmp(env, "userptr") == 0) return CAPTURE_USERPTR;
+    if (strcmp(env, "dmabuf") == 0) return CAPTURE_DMABUF;
+    fprintf(stderr, "DEBUG: Unknown CAPTURE_MEMORY %s, using mmap\n", env);
+    return CAPTURE_MMAP;
+}
+
+static int capture_buffer_count(void) {
+    const char* env = getenv("CAPTURE_BUFFERS");
+    int count = env ? atoi(env) : CAPTURE_DEFAULT_BUFFERS;
+    if (count < 2) count = 2;
+    if (count > CAPTURE_MAX_BUFFERS) count = CAPTURE_MAX_BUFFERS;
+    return count;
+}
+
+// Hand buffer index back to the driver
+static int capture_queue(Capture* c, int index) {
+    struct v4l2_buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.index = index;
+    if (c->memory == CAPTURE_USERPTR) {
+        buf.memory = V4L2_MEMORY_USERPTR;
+        buf.m.userptr = (unsigned long)c->buffers[index].start;
+        buf.length = c->buffers[index].length;
+    } else {
+        buf.memory = V4L2_MEMORY_MMAP;
+    }
+    return capture_ioctl(c->fd, VIDIOC_QBUF, &buf);
+}
+
+static int capture_request(Capture* c, int count) {
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = count;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = c->memory == CAPTURE_USERPTR ? V4L2_MEMORY_USERPTR : V4L2_MEMORY_MMAP;
+    if (capture_ioctl(c->fd, VIDIOC_REQBUFS, &req) < 0) return -1;
+    return (int)req.count;
+}
+
+static int capture_map_buffers(Capture* c) {
+    for (int i = 0; i < c->count; i++) {
+        CaptureBuffer* b = &c->buffers[i];
+        if (c->memory == CAPTURE_USERPTR) {
+            long page = sysconf(_SC_PAGESIZE);
+            b->length = (c->image_size + page - 1) / page * page;
+            void* memory = NULL;
+            if (posix_memalign(&memory, page, b->length) != 0) return -1;
+            b->start = memory;
+            continue;
+        }
+
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (capture_ioctl(c->fd, VIDIOC_QUERYBUF, &buf) < 0) return -1;
+        void* start = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, buf.m.offset);
+        if (start == MAP_FAILED) return -1;
+        b->start = start;
+        b->length = buf.length;
+
+        if (c->memory == CAPTURE_DMABUF) {
+            struct v4l2_exportbuffer expbuf;
+            memset(&expbuf, 0, sizeof(expbuf));
+            expbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            expbuf.index = i;
+            expbuf.flags = O_RDONLY | O_CLOEXEC;
+            if (capture_ioctl(c->fd, VIDIOC_EXPBUF, &expbuf) < 0) {
+                perror("DEBUG: VIDIOC_EXPBUF failed");
+                return -1;
+            }
+            b->dmabuf_fd = expbuf.fd;
+        }
+    }
+    return 0;
+}
+
+static uint64_t capture_timestamp_ns(const struct v4l2_buffer* buf) {
+    if ((buf->flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+        return (uint64_t)buf->timestamp.tv_sec * 1000000000ull + (uint64_t)buf->timestamp.tv_usec * 1000ull;
+    return stats_now_ns();  // Unknown clock: the dequeue time is the best bound we have
+}
+
+// Dequeue everything the driver has finished and queue it for the renderer;
+// -1 when the device failed or the ring was stopped
+static int capture_drain(Capture* c) {
+    for (;;) {
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = c->memory == CAPTURE_USERPTR ? V4L2_MEMORY_USERPTR : V4L2_MEMORY_MMAP;
+        if (capture_ioctl(c->fd, VIDIOC_DQBUF, &buf) < 0) {
+            if (errno == EAGAIN) return 0;
+            perror("DEBUG: VIDIOC_DQBUF failed");
+            return -1;
+        }
+
+        CaptureBuffer* b = &c->buffers[buf.index];
+        if (c->frames && buf.sequence > c->next_sequence) c->lost += buf.sequence - c->next_sequence;
+        c->next_sequence = buf.sequence + 1;
+        c->frames++;
+        if (buf.flags & V4L2_BUF_FLAG_ERROR) {
+            capture_queue(c, buf.index);
+            continue;
+        }
+        b->bytesused = buf.bytesused;
+        b->sequence = buf.sequence;
+        b->capture_ns = capture_timestamp_ns(&buf);
+
+        // Never blocks: the ring holds every buffer there is
+        int slot = frame_ring_reserve(&c->ready);
+        if (slot < 0) return -1;
+        c->ready_index[slot] = buf.index;
+        frame_ring_push(&c->ready);
+        stats_count(COUNTER_FRAMES_DECODED);
+    }
+}
+
+static void* capture_thread_func(void* arg) {
+    Capture* c = (Capture*)arg;
+    struct pollfd fds[2] = {{c->fd, POLLIN, 0}, {c->wake_pipe[0], POLLIN, 0}};
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("DEBUG: Capture poll failed");
+            break;
+        }
+        if (fds[1].revents) break;  // capture_stop
+        if (fds[0].revents & POLLERR) {
+            fprintf(stderr, "DEBUG: Capture device reported an error\n");
+            break;
+        }
+        if ((fds[0].revents & POLLIN) && capture_drain(c) < 0) break;
+    }
+    frame_ring_close(&c->ready);  // The renderer drains what is queued, then sees the end
+    return NULL;
+}
+
+static void capture_free(Capture* c);
+
+// Allocate and queue the buffers for the format already set on fd
+// (VIDIOC_S_FMT), start streaming and the capture thread
+static int capture_init(Capture* c, int fd, const struct v4l2_format* fmt) {
+    memset(c, 0, sizeof(*c));
+    c->fd = fd;
+    c->wake_pipe[0] = c->wake_pipe[1] = -1;
+    for (int i = 0; i < CAPTURE_MAX_BUFFERS; i++) c->buffers[i].dmabuf_fd = -1;
+    c->width = fmt->fmt.pix.width;
+    c->height = fmt->fmt.pix.height;
+    c->stride = fmt->fmt.pix.bytesperline;
+    c->pixelformat = fmt->fmt.pix.pixelformat;
+    c->image_size = fmt->fmt.pix.sizeimage;
+    c->memory = capture_memory_requested();
+
+    // The thread dequeues until EAGAIN, then goes back to poll
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    int requested = capture_buffer_count();
+    c->count = capture_request(c, requested);
+    if (c->count < 0 && c->memory == CAPTURE_USERPTR) {
+        fprintf(stderr, "DEBUG: Driver has no USERPTR capture, using mmap\n");
+        c->memory = CAPTURE_MMAP;
+        c->count = capture_request(c, requested);
+    }
+    if (c->count < 2) {
+        perror("DEBUG: Failed to request capture buffers");
+        c->count = 0;
+        capture_free(c);
+        return -1;
+    }
+    if (c->count > CAPTURE_MAX_BUFFERS) c->count = CAPTURE_MAX_BUFFERS;
+
+    if (capture_map_buffers(c) < 0 || pipe(c->wake_pipe) < 0) {
+        perror("DEBUG: Failed to set up capture buffers");
+        capture_free(c);
+        return -1;
+    }
+    unsigned int capacity = 1;
+    while (capacity < (unsigned int)c->count) capacity <<= 1;
+    frame_ring_init(&c->ready, capacity);
+
+    for (int i = 0; i < c->count; i++) {
+        if (capture_queue(c, i) < 0) {
+            perror("DEBUG: Failed to queue capture buffer");
+            capture_free(c);
+            return -1;
+        }
+    }
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (capture_ioctl(fd, VIDIOC_STREAMON, &type) < 0) {
+        perror("DEBUG: Failed to start streaming");
+        capture_free(c);
+        return -1;
+    }
+    c->streaming = 1;
+    if (pthread_create(&c->thread, NULL, capture_thread_func, c) != 0) {
+        capture_free(c);
+        return -1;
+    }
+    c->thread_started = 1;
+
+    printf("DEBUG: Capture %dx%d %c%c%c%c, %d %s buffers of %zu bytes%s\n", c->width, c->height,
+           c->pixelformat & 0xff, (c->pixelformat >> 8) & 0xff, (c->pixelformat >> 16) & 0xff,
+           (c->pixelformat >> 24) & 0xff, c->count, capture_memory_names[c->memory], c->buffers[0].length,
+           c->count != requested ? " (count set by the driver)" : "");
+    return 0;
+}
+
+// Wait for the newest captured frame and return its buffer index, or -1
+// once capture has stopped; the buffer is ours until capture_release
+static int capture_acquire(Capture* c) {
+    int slot = frame_ring_peek(&c->ready);
+    if (slot < 0) return -1;
+    int index = c->ready_index[slot];
+    frame_ring_pop(&c->ready);
+    // Anything newer already waiting replaces it: showing old frames only adds latency
+    while ((slot = frame_ring_try_peek(&c->ready)) >= 0) {
+        capture_queue(c, index);
+        c->skipped++;
+        stats_count(COUNTER_FRAMES_DROPPED);
+        index = c->ready_index[slot];
+        frame_ring_pop(&c->ready);
+    }
+    return index;
+}
+
+// Requeue a buffer from capture_acquire once nothing reads it any more
+static void capture_release(Capture* c, int index) {
+    if (index < 0) return;
+    if (capture_queue(c, index) < 0 && c->streaming) perror("DEBUG: Failed to requeue capture buffer");
+}
+
+// After the swap that shows a frame captured at capture_ns
+static void capture_record_latency(uint64_t capture_ns) {
+    uint64_t now = stats_now_ns();
+    if (capture_ns && capture_ns <= now) stats_record(STAT_CAPTURE_LATENCY, now - capture_ns);
+}
+
+static void capture_stop(Capture* c) {
+    if (c->thread_started) {
+        frame_ring_stop(&c->ready);
+        ssize_t written = write(c->wake_pipe[1], "", 1);
+        (void)written;
+        pthread_join(c->thread, NULL);
+        c->thread_started = 0;
+        printf("DEBUG: Capture: %llu frames, %llu lost by the driver, %llu skipped for newer frames\n",
+               (unsigned long long)c->frames, (unsigned long long)c->lost, (unsigned long long)c->skipped);
+    }
+    if (c->streaming) {
+        enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        capture_ioctl(c->fd, VIDIOC_STREAMOFF, &type);
+        c->streaming = 0;
+    }
+}
+
+// Stop and release every buffer; the device fd stays open
+static void capture_free(Capture* c) {
+    capture_stop(c);
+    for (int i = 0; i < CAPTURE_MAX_BUFFERS; i++) {
+        CaptureBuffer* b = &c->buffers[i];
+        if (b->dmabuf_fd >= 0) close(b->dmabuf_fd);
+        if (b->start && c->memory == CAPTURE_USERPTR) free(b->start);
+        else if (b->start) munmap(b->start, b->length);
+        b->start = NULL;
+        b->dmabuf_fd = -1;
+    }
+    if (c->count) capture_request(c, 0);
+    c->count = 0;
+    if (c->wake_pipe[0] >= 0) close(c->wake_pipe[0]);
+    if (c->wake_pipe[1] >= 0) close(c->wake_pipe[1]);
+    c->wake_pipe[0] = c->wake_pipe[1] = -1;
+}
+
+#endif // V4L2_CAPTURE_H
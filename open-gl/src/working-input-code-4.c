@@ -15,6 +15,7 @@
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
+#include "program-cache.h"
 
 #define WINDOW_WIDTH  1920
 #define WINDOW_HEIGHT 1080
@@ -425,6 +426,9 @@ GLuint compile_shader(GLenum type, const char *source) {
 // Shader initialization (only RGBA now)
 GLuint init_shaders() {
     printf("DEBUG: Initializing shaders\n");
+    ProgramCacheEntry cache_entry;
+    program = program_cache_load(&cache_entry, "video", vertex_shader_source, fragment_shader_source_rgba);
+    if (program) return program;
     GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
     GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source_rgba);
     
@@ -450,6 +454,7 @@ GLuint init_shaders() {
     
     glDeleteShader(vertex_shader);
     glDeleteShader(fragment_shader);
+    program_cache_store(&cache_entry, program);
     printf("DEBUG: Shaders initialized successfully\n");
     return program;
 }
@@ -518,31 +523,36 @@ void init_fps_overlay() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
-    GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fps_fragment_shader_source);
-    fps_program = glCreateProgram();
-    glAttachShader(fps_program, vertex_shader);
-    glAttachShader(fps_program, fragment_shader);
-    glLinkProgram(fps_program);
-
-    GLint linked;
-    glGetProgramiv(fps_program, GL_LINK_STATUS, &linked);
-    if (!linked) {
-        GLint info_len = 0;
-        glGetProgramiv(fps_program, GL_INFO_LOG_LENGTH, &info_len);
-        if (info_len > 1) {
-            char *info_log = malloc(sizeof(char) * info_len);
-            glGetProgramInfoLog(fps_program, info_len, NULL, info_log);
-            fprintf(stderr, "DEBUG: Error linking FPS program: %s\n", info_log);
-            free(info_log);
+    ProgramCacheEntry cache_entry;
+    fps_program = program_cache_load(&cache_entry, "fps_overlay", vertex_shader_source, fps_fragment_shader_source);
+    if (!fps_program) {
+        GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
+        GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fps_fragment_shader_source);
+        fps_program = glCreateProgram();
+        glAttachShader(fps_program, vertex_shader);
+        glAttachShader(fps_program, fragment_shader);
+        glLinkProgram(fps_program);
+
+        GLint linked;
+        glGetProgramiv(fps_program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            GLint info_len = 0;
+            glGetProgramiv(fps_program, GL_INFO_LOG_LENGTH, &info_len);
+            if (info_len > 1) {
+                char *info_log = malloc(sizeof(char) * info_len);
+                glGetProgramInfoLog(fps_program, info_len, NULL, info_log);
+                fprintf(stderr, "DEBUG: Error linking FPS program: %s\n", info_log);
+                free(info_log);
+            }
+            glDeleteProgram(fps_program);
+            fps_program = 0;
+            return;
         }
-        glDeleteProgram(fps_program);
-        fps_program = 0;
-        return;
-    }
 
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
+        glDeleteShader(vertex_shader);
+        glDeleteShader(fragment_shader);
+        program_cache_store(&cache_entry, fps_program);
+    }
 
     float fps_vertices[6 * 5 * 6];
     glGenBuffers(1, &fps_vbo);
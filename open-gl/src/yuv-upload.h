@@ -0,0 +1,177 @@
+#ifndef YUV_UPLOAD_H
+#define YUV_UPLOAD_H
+
+// Upload decoder pictures as YUV planes and convert to RGB in the fragment
+// shader, instead of sws_scale to RGBA on the CPU.
+//
+// I420 (yuv420p / yuvj420p) goes up as three GL_LUMINANCE textures, NV12 as
+// a GL_LUMINANCE Y plane and a GL_LUMINANCE_ALPHA UV plane: 1.5 bytes per
+// pixel instead of 4. GLES2 has no GL_UNPACK_ROW_LENGTH, so each texture is
+// as wide as the plane's linesize and the shader scales the horizontal
+// texture coordinate down to the visible width; the decoder's rows go up
+// as they are, without a repacking copy. The coordinate is also clamped to
+// the centre of the last visible texel, so linear filtering in a scaled
+// draw never blends in the padding columns at the right edge.
+//
+// The matrix follows the frame's colorspace and range: BT.709 when tagged
+// so (or untagged HD), BT.601 otherwise, limited or full range. YUV_UPLOAD=0
+// keeps the RGBA path.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GLES2/gl2.h>
+#include <libavutil/frame.h>
+
+typedef enum { YUV_NONE, YUV_I420, YUV_NV12 } YuvFormat;
+
+typedef struct {
+    YuvFormat format;
+    int planes;
+    GLuint textures[3];
+    int widths[3], heights[3];  // Allocated texture size, in texels
+    float luma_scale, chroma_scale;  // Visible fraction of each texture row
+    float luma_max, chroma_max;  // Texture coordinate of the last visible texel's centre
+    float matrix[9];  // Column-major YUV to RGB
+    float offset[3];  // Subtracted from the sampled YUV first
+    GLint matrix_uniform, offset_uniform, luma_scale_uniform, chroma_scale_uniform;
+    GLint luma_max_uniform, chroma_max_uniform;
+} YuvTextures;
+
+// Shares the players' vertex shader (position, texcoord -> v_texcoord)
+static const char* const yuv_fragment_shader_i420 =
+    "precision mediump float;\n"
+    "varying vec2 v_texcoord;\n"
+    "uniform sampler2D y_plane, u_plane, v_plane;\n"
+    "uniform float luma_scale, chroma_scale, luma_max, chroma_max;\n"
+    "uniform mat3 yuv_matrix;\n"
+    "uniform vec3 yuv_offset;\n"
+    "void main() {\n"
+    "  vec2 luma_tc = vec2(min(v_texcoord.x * luma_scale, luma_max), v_texcoord.y);\n"
+    "  vec2 chroma_tc = vec2(min(v_texcoord.x * chroma_scale, chroma_max), v_texcoord.y);\n"
+    "  vec3 yuv = vec3(texture2D(y_plane, luma_tc).r, texture2D(u_plane, chroma_tc).r,\n"
+    "                  texture2D(v_plane, chroma_tc).r);\n"
+    "  gl_FragColor = vec4(yuv_matrix * (yuv - yuv_offset), 1.0);\n"
+    "}\n";
+
+static const char* const yuv_fragment_shader_nv12 =
+    "precision mediump float;\n"
+    "varying vec2 v_texcoord;\n"
+    "uniform sampler2D y_plane, u_plane;\n"
+    "uniform float luma_scale, chroma_scale, luma_max, chroma_max;\n"
+    "uniform mat3 yuv_matrix;\n"
+    "uniform vec3 yuv_offset;\n"
+    "void main() {\n"
+    "  vec2 luma_tc = vec2(min(v_texcoord.x * luma_scale, luma_max), v_texcoord.y);\n"
+    "  vec2 chroma_tc = vec2(min(v_texcoord.x * chroma_scale, chroma_max), v_texcoord.y);\n"
+    "  vec4 uv = texture2D(u_plane, chroma_tc);\n"
+    "  vec3 yuv = vec3(texture2D(y_plane, luma_tc).r, uv.r, uv.a);\n"
+    "  gl_FragColor = vec4(yuv_matrix * (yuv - yuv_offset), 1.0);\n"
+    "}\n";
+
+// Shader path for the decoder's output format, YUV_NONE to stay on RGBA
+static YuvFormat yuv_upload_format(enum AVPixelFormat format) {
+    const char* env = getenv("YUV_UPLOAD");
+    if (env && strcmp(env, "0") == 0) return YUV_NONE;
+    if (format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_YUVJ420P) return YUV_I420;
+    if (format == AV_PIX_FMT_NV12) return YUV_NV12;
+    return YUV_NONE;
+}
+
+static const char* yuv_fragment_shader(YuvFormat format) {
+    return format == YUV_NV12 ? yuv_fragment_shader_nv12 : yuv_fragment_shader_i420;
+}
+
+// rgb = matrix * (yuv - offset) for the frame's colorspace and range
+static void yuv_color_matrix(const AVFrame* frame, float matrix[9], float offset[3]) {
+    int bt709 = frame->colorspace == AVCOL_SPC_BT709 ||
+                (frame->colorspace == AVCOL_SPC_UNSPECIFIED && frame->height >= 720);
+    int full_range = frame->color_range == AVCOL_RANGE_JPEG || frame->format == AV_PIX_FMT_YUVJ420P;
+    float kr = bt709 ? 0.2126f : 0.299f, kb = bt709 ? 0.0722f : 0.114f, kg = 1.0f - kr - kb;
+    float y_scale = full_range ? 1.0f : 255.0f / 219.0f;
+    float c_scale = full_range ? 1.0f : 255.0f / 224.0f;
+
+    // Columns: contribution of Y, U (Cb) and V (Cr) to R, G, B
+    float columns[9] = {
+        y_scale, y_scale, y_scale,
+        0.0f, -2.0f * kb * (1.0f - kb) / kg * c_scale, 2.0f * (1.0f - kb) * c_scale,
+        2.0f * (1.0f - kr) * c_scale, -2.0f * kr * (1.0f - kr) / kg * c_scale, 0.0f,
+    };
+    memcpy(matrix, columns, sizeof(columns));
+    offset[0] = full_range ? 0.0f : 16.0f / 255.0f;
+    offset[1] = offset[2] = 128.0f / 255.0f;
+}
+
+// Create the plane textures; their storage follows the first frame uploaded
+static void yuv_textures_init(YuvTextures* yuv, YuvFormat format, GLuint program) {
+    yuv->format = format;
+    yuv->planes = format == YUV_NV12 ? 2 : 3;
+    glGenTextures(yuv->planes, yuv->textures);
+    for (int p = 0; p < yuv->planes; p++) {
+        glBindTexture(GL_TEXTURE_2D, yuv->textures[p]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        yuv->widths[p] = yuv->heights[p] = 0;
+    }
+
+    static const char* const sampler_names[3] = {"y_plane", "u_plane", "v_plane"};
+    glUseProgram(program);
+    for (int p = 0; p < yuv->planes; p++) glUniform1i(glGetUniformLocation(program, sampler_names[p]), p);
+    yuv->matrix_uniform = glGetUniformLocation(program, "yuv_matrix");
+    yuv->offset_uniform = glGetUniformLocation(program, "yuv_offset");
+    yuv->luma_scale_uniform = glGetUniformLocation(program, "luma_scale");
+    yuv->chroma_scale_uniform = glGetUniformLocation(program, "chroma_scale");
+    yuv->luma_max_uniform = glGetUniformLocation(program, "luma_max");
+    yuv->chroma_max_uniform = glGetUniformLocation(program, "chroma_max");
+    printf("DEBUG: YUV upload enabled (%s)\n", format == YUV_NV12 ? "NV12" : "I420");
+}
+
+// Upload the frame's planes to texture units 0..2 and set the conversion
+// uniforms on the current program; -1 if the frame is not in yuv->format
+static int yuv_textures_upload(YuvTextures* yuv, const AVFrame* frame) {
+    YuvFormat format = frame->format == AV_PIX_FMT_NV12 ? YUV_NV12
+                     : (frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUVJ420P) ? YUV_I420
+                     : YUV_NONE;
+    if (format != yuv->format) return -1;
+
+    int chroma_width = (frame->width + 1) / 2, chroma_height = (frame->height + 1) / 2;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int p = 0; p < yuv->planes; p++) {
+        GLenum gl_format = (p == 1 && format == YUV_NV12) ? GL_LUMINANCE_ALPHA : GL_LUMINANCE;
+        int width = gl_format == GL_LUMINANCE_ALPHA ? frame->linesize[p] / 2 : frame->linesize[p];
+        int height = p == 0 ? frame->height : chroma_height;
+        glActiveTexture(GL_TEXTURE0 + p);
+        glBindTexture(GL_TEXTURE_2D, yuv->textures[p]);
+        if (width != yuv->widths[p] || height != yuv->heights[p]) {
+            glTexImage2D(GL_TEXTURE_2D, 0, gl_format, width, height, 0, gl_format, GL_UNSIGNED_BYTE, frame->data[p]);
+            yuv->widths[p] = width;
+            yuv->heights[p] = height;
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, gl_format, GL_UNSIGNED_BYTE, frame->data[p]);
+        }
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    yuv->luma_scale = (float)frame->width / yuv->widths[0];
+    yuv->chroma_scale = (float)chroma_width / yuv->widths[1];
+    yuv->luma_max = (frame->width - 0.5f) / yuv->widths[0];
+    yuv->chroma_max = (chroma_width - 0.5f) / yuv->widths[1];
+    yuv_color_matrix(frame, yuv->matrix, yuv->offset);
+    glUniform1f(yuv->luma_scale_uniform, yuv->luma_scale);
+    glUniform1f(yuv->chroma_scale_uniform, yuv->chroma_scale);
+    glUniform1f(yuv->luma_max_uniform, yuv->luma_max);
+    glUniform1f(yuv->chroma_max_uniform, yuv->chroma_max);
+    glUniformMatrix3fv(yuv->matrix_uniform, 1, GL_FALSE, yuv->matrix);
+    glUniform3fv(yuv->offset_uniform, 1, yuv->offset);
+    return 0;
+}
+
+static void yuv_textures_free(YuvTextures* yuv) {
+    if (yuv->planes) glDeleteTextures(yuv->planes, yuv->textures);
+    yuv->planes = 0;
+}
+
+#endif // YUV_UPLOAD_H